@@ -0,0 +1,427 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures the extension's own overhead per call against a local mock of
+// the provider APIs, so pooling, batching and parsing changes can be compared
+// without network noise or API costs.
+//
+// The mock server runs in a forked child process, which keeps its
+// allocations and threads out of the numbers. It emulates Anthropic
+// /v1/messages (a streamed answer) and Google :embedContent and
+// :batchEmbedContents, each after a configurable delay. For every
+// concurrency level the benchmark runs the workload from that many threads,
+// as if from as many sessions, and prints calls per second, the p50 and p99
+// call latency and heap allocations per call, counted by replacing the
+// global operator new.
+//
+//   vsql_ai_bench [--workload=prompt|embed|embed_batch|http]
+//                 [--concurrency=1,4,16,64] [--calls=2000] [--latency-ms=0]
+//                 [--response-bytes=2000] [--events=50] [--dimensions=768]
+//                 [--batch=100]
+//
+// VSQL_AI_* settings such as VSQL_AI_HTTP_BACKEND apply as in the server.
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "httplib.h"
+
+#include "ai_providers.h"
+#include "http_client.h"
+#include "metrics.h"
+
+namespace {
+
+// =============================================================================
+// Allocation counting
+// =============================================================================
+
+std::atomic<uint64_t> allocations{0};
+
+// Out of line, so that the compiler does not pair the malloc and free
+// across the replaced operators and warn about a mismatch
+__attribute__((noinline)) void* allocate(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void deallocate(void* p) { std::free(p); }
+
+}  // namespace
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using vsql_ai::HttpClient;
+
+struct Options {
+  std::string workload = "prompt";
+  std::vector<size_t> concurrency = {1, 4, 16, 64};
+  size_t calls = 2000;
+  long latency_ms = 0;
+  size_t response_bytes = 2000;  // text of a prompt answer, body of http
+  size_t events = 50;            // text deltas a prompt answer is split into
+  size_t dimensions = 768;
+  size_t batch = 100;  // texts per embed_batch call
+};
+
+bool parse_options(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      return false;
+    }
+    std::string name = arg.substr(2, equals - 2);
+    std::string value = arg.substr(equals + 1);
+    long number = std::strtol(value.c_str(), nullptr, 10);
+
+    if (name == "workload") {
+      options->workload = value;
+    } else if (name == "concurrency") {
+      options->concurrency.clear();
+      for (const char* p = value.c_str(); *p;) {
+        char* end;
+        long level = std::strtol(p, &end, 10);
+        if (end == p || level < 1) {
+          return false;
+        }
+        options->concurrency.push_back(static_cast<size_t>(level));
+        p = *end == ',' ? end + 1 : end;
+      }
+    } else if (name == "calls" && number > 0) {
+      options->calls = static_cast<size_t>(number);
+    } else if (name == "latency-ms" && number >= 0) {
+      options->latency_ms = number;
+    } else if (name == "response-bytes" && number > 0) {
+      options->response_bytes = static_cast<size_t>(number);
+    } else if (name == "events" && number > 0) {
+      options->events = static_cast<size_t>(number);
+    } else if (name == "dimensions" && number > 0) {
+      options->dimensions = static_cast<size_t>(number);
+    } else if (name == "batch" && number > 0) {
+      options->batch = static_cast<size_t>(number);
+    } else {
+      return false;
+    }
+  }
+  return options->workload == "prompt" || options->workload == "embed" ||
+         options->workload == "embed_batch" || options->workload == "http";
+}
+
+// =============================================================================
+// Mock provider
+// =============================================================================
+
+// Anthropic Messages stream carrying response_bytes of text
+std::string anthropic_stream(const Options& options) {
+  std::string body =
+      "event: message_start\n"
+      "data: {\"type\":\"message_start\",\"message\":{\"id\":\"msg_bench\","
+      "\"type\":\"message\",\"role\":\"assistant\",\"usage\":"
+      "{\"input_tokens\":12,\"output_tokens\":1}}}\n\n"
+      "event: content_block_start\n"
+      "data: {\"type\":\"content_block_start\",\"index\":0,"
+      "\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n";
+  size_t per_event = std::max<size_t>(1, options.response_bytes / options.events);
+  for (size_t sent = 0; sent < options.response_bytes; sent += per_event) {
+    size_t length = std::min(per_event, options.response_bytes - sent);
+    body += "event: content_block_delta\n"
+            "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+            "{\"type\":\"text_delta\",\"text\":\"";
+    body.append(length, 'x');
+    body += "\"}}\n\n";
+  }
+  body +=
+      "event: content_block_stop\n"
+      "data: {\"type\":\"content_block_stop\",\"index\":0}\n\n"
+      "event: message_delta\n"
+      "data: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":"
+      "\"end_turn\"},\"usage\":{\"output_tokens\":" +
+      std::to_string(options.response_bytes / 4) +
+      "}}\n\n"
+      "event: message_stop\n"
+      "data: {\"type\":\"message_stop\"}\n\n";
+  return body;
+}
+
+// {"values":[...]} with printed floats as long as the real API's
+std::string embedding_values(const Options& options) {
+  std::string values = "{\"values\":[";
+  char number[32];
+  for (size_t i = 0; i < options.dimensions; i++) {
+    snprintf(number, sizeof(number), "%s%.9f", i ? "," : "",
+             (static_cast<double>(i % 997) - 498) / 1000.0);
+    values += number;
+  }
+  values += "]}";
+  return values;
+}
+
+// Serve until killed, writing the bound port to ready_fd first
+void run_mock_server(const Options& options, size_t threads, int ready_fd) {
+  std::string stream = anthropic_stream(options);
+  std::string values = embedding_values(options);
+  std::string embedding = "{\"embedding\":" + values + "}";
+  std::string payload(options.response_bytes, 'x');
+  auto delay = std::chrono::milliseconds(options.latency_ms);
+
+  httplib::Server server;
+  // One thread per keep-alive connection the clients may open
+  server.new_task_queue = [threads] { return new httplib::ThreadPool(threads); };
+  server.set_tcp_nodelay(true);
+
+  server.Post("/v1/messages",
+              [&](const httplib::Request&, httplib::Response& response) {
+                std::this_thread::sleep_for(delay);
+                response.set_content(stream, "text/event-stream");
+              });
+  server.Post(R"(/v1beta/models/[\w.-]+:embedContent)",
+              [&](const httplib::Request&, httplib::Response& response) {
+                std::this_thread::sleep_for(delay);
+                response.set_content(embedding, "application/json");
+              });
+  server.Post(R"(/v1beta/models/[\w.-]+:batchEmbedContents)",
+              [&](const httplib::Request& request,
+                  httplib::Response& response) {
+                std::this_thread::sleep_for(delay);
+                // One embedding per entry of "requests", each of which names
+                // the model
+                size_t count = 0;
+                for (size_t at = request.body.find("\"model\"");
+                     at != std::string::npos;
+                     at = request.body.find("\"model\"", at + 1)) {
+                  count++;
+                }
+                std::string body = "{\"embeddings\":[";
+                for (size_t i = 0; i < count; i++) {
+                  body += i ? "," + values : values;
+                }
+                body += "]}";
+                response.set_content(body, "application/json");
+              });
+  server.Post("/echo",
+              [&](const httplib::Request&, httplib::Response& response) {
+                std::this_thread::sleep_for(delay);
+                response.set_content(payload, "application/octet-stream");
+              });
+
+  int port = server.bind_to_any_port("127.0.0.1");
+  if (write(ready_fd, &port, sizeof(port)) != sizeof(port)) {
+    _exit(1);
+  }
+  close(ready_fd);
+  server.listen_after_bind();
+  _exit(0);
+}
+
+// =============================================================================
+// Workloads
+// =============================================================================
+
+struct Run {
+  size_t calls = 0;
+  size_t rows = 0;  // texts embedded, for embed_batch; otherwise calls
+  size_t errors = 0;
+  std::string first_error;
+  double seconds = 0;
+  uint64_t allocations = 0;
+  vsql_ai::LatencyHistogram::Summary latency;
+};
+
+class Workload {
+ public:
+  Workload(const Options& options, const std::string& base_url)
+      : options_(options) {
+    HttpClient::Endpoint::parse(base_url, &endpoint_);
+    for (size_t i = 0; i < options.batch; i++) {
+      texts_.push_back("benchmark text number " + std::to_string(i));
+    }
+  }
+
+  // Make call number i. Returns false and sets *error on failure.
+  bool call(size_t i, std::string* error) {
+    auto& registry = vsql_ai::ProviderRegistry::instance();
+    if (options_.workload == "prompt") {
+      // Distinct prompts across runs, so the response cache never answers
+      vsql_ai::PromptOptions prompt_options;
+      registry.get(vsql_ai::ProviderId::kAnthropic)
+          ->prompt("bench-model", "bench-key",
+                   "benchmark prompt " + std::to_string(prompts_++),
+                   prompt_options, 65535, nullptr, error);
+    } else if (options_.workload == "embed") {
+      registry.get(vsql_ai::ProviderId::kGoogle)
+          ->embed("bench-embedding", "bench-key", texts_[i % texts_.size()],
+                  error);
+    } else if (options_.workload == "embed_batch") {
+      registry.get(vsql_ai::ProviderId::kGoogle)
+          ->embed_batch("bench-embedding", "bench-key", texts_, error);
+    } else {
+      HttpClient client;
+      auto response = client.post(endpoint_, "/echo", "{}", {}, 30);
+      if (!response.error.empty()) {
+        *error = response.error;
+      } else if (!response.is_success()) {
+        *error = "HTTP " + std::to_string(response.status_code);
+      }
+    }
+    return error->empty();
+  }
+
+  size_t rows_per_call() const {
+    return options_.workload == "embed_batch" ? options_.batch : 1;
+  }
+
+  Run run(size_t concurrency, size_t calls) {
+    vsql_ai::LatencyHistogram latency;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> errors{0};
+    std::string first_error;
+    std::mutex error_mutex;
+
+    uint64_t allocations_before = allocations.load();
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < concurrency; t++) {
+      threads.emplace_back([&] {
+        std::string error;
+        for (size_t i = next++; i < calls; i = next++) {
+          error.clear();
+          auto call_start = Clock::now();
+          bool ok = call(i, &error);
+          latency.record(Clock::now() - call_start);
+          if (!ok && errors++ == 0) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            first_error = error;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    Run run;
+    run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    run.allocations = allocations.load() - allocations_before;
+    run.calls = calls;
+    run.rows = calls * rows_per_call();
+    run.errors = errors;
+    run.first_error = first_error;
+    run.latency = latency.summary();
+    return run;
+  }
+
+ private:
+  const Options& options_;
+  HttpClient::Endpoint endpoint_;
+  std::vector<std::string> texts_;
+  std::atomic<uint64_t> prompts_{0};
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    fprintf(stderr,
+            "usage: %s [--workload=prompt|embed|embed_batch|http] "
+            "[--concurrency=1,4,16,64] [--calls=N] [--latency-ms=N] "
+            "[--response-bytes=N] [--events=N] [--dimensions=N] "
+            "[--batch=N]\n",
+            argv[0]);
+    return 2;
+  }
+
+  // Fork before any thread exists
+  size_t max_concurrency = 1;
+  for (size_t level : options.concurrency) {
+    max_concurrency = std::max(max_concurrency, level);
+  }
+  int ready[2];
+  if (pipe(ready) != 0) {
+    perror("pipe");
+    return 1;
+  }
+  pid_t server = fork();
+  if (server == 0) {
+    close(ready[0]);
+    run_mock_server(options, max_concurrency + 8, ready[1]);
+  }
+  close(ready[1]);
+  int port = 0;
+  if (server < 0 || read(ready[0], &port, sizeof(port)) != sizeof(port) ||
+      port <= 0) {
+    fprintf(stderr, "mock server failed to start\n");
+    return 1;
+  }
+  close(ready[0]);
+
+  // Point both providers at the mock before the registry reads its settings
+  std::string base_url = "http://127.0.0.1:" + std::to_string(port);
+  setenv("VSQL_AI_ANTHROPIC_BASE_URL", base_url.c_str(), 1);
+  setenv("VSQL_AI_GOOGLE_BASE_URL", base_url.c_str(), 1);
+
+  Workload workload(options, base_url);
+  printf("%-12s %5s %8s %10s %10s %9s %9s %12s %7s\n", "workload", "conc",
+         "calls", "calls/s", "rows/s", "p50_ms", "p99_ms", "allocs/call",
+         "errors");
+  int status = 0;
+  for (size_t concurrency : options.concurrency) {
+    // Open the connections this level needs before timing it
+    workload.run(concurrency, concurrency * 2);
+    Run run = workload.run(concurrency, options.calls);
+
+    printf("%-12s %5zu %8zu %10.1f %10.1f %9.3f %9.3f %12.1f %7zu\n",
+           options.workload.c_str(), concurrency, run.calls,
+           run.calls / run.seconds, run.rows / run.seconds, run.latency.p50_ms,
+           run.latency.p99_ms,
+           static_cast<double>(run.allocations) / run.calls, run.errors);
+    if (run.errors > 0) {
+      fprintf(stderr, "first error: %s\n", run.first_error.c_str());
+      status = 1;
+    }
+  }
+
+  kill(server, SIGTERM);
+  waitpid(server, nullptr, 0);
+  return status;
+}
@@ -16,13 +16,33 @@
 
 #include <villagesql/extension.h>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "ai_providers.h"
+#include "call_context.h"
+#include "config.h"
+#include "dns_cache.h"
+#include "embedding_store.h"
+#include "hedging.h"
 #include "http_client.h"
+#include "metrics.h"
 #include "nlohmann/json.hpp"
+#include "prompt_batch.h"
+#include "response_cache.h"
+#include "text_chunker.h"
+#include "vector_format.h"
+#include "vector_index.h"
+#include "vector_ops.h"
+#include "worker_pool.h"
 
 using namespace villagesql::extension_builder;
 using namespace villagesql::func_builder;
@@ -32,177 +52,1612 @@ using json = nlohmann::json;
 
 namespace vsql_ai {
 
+namespace {
+
+// Report an error, truncated to fit the fixed-size error buffer
+void set_error(vef_vdf_result_t* result, const std::string& error) {
+  result->type = VEF_RESULT_ERROR;
+  size_t copy_len = std::min(error.length(), sizeof(result->error_msg) - 1);
+  memcpy(result->error_msg, error.c_str(), copy_len);
+  result->error_msg[copy_len] = '\0';
+}
+
+// Return a string value. A value cut off at the end of the result buffer
+// would pass for a complete one, so a value that does not fit is an error.
+void set_string_result(vef_vdf_result_t* result, std::string_view value) {
+  if (value.length() > result->max_str_len - 1) {
+    set_error(result, "Result of " + std::to_string(value.length()) +
+                          " bytes exceeds the " +
+                          std::to_string(result->max_str_len - 1) +
+                          "-byte result buffer");
+    return;
+  }
+  result->type = VEF_RESULT_VALUE;
+  memcpy(result->str_buf, value.data(), value.length());
+  result->str_buf[value.length()] = '\0';
+  result->actual_len = value.length();
+}
+
+// View of a string argument; valid for the duration of the call
+std::string_view arg_string(const vef_invalue_t* arg) {
+  return std::string_view(arg->str_value, arg->str_len);
+}
+
+// Parse an integer argument. Integers reach string parameters in decimal.
+bool parse_integer(const vef_invalue_t* arg, int64_t* value) {
+  std::string_view text = arg_string(arg);
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text[0]))) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.back()))) {
+    text.remove_suffix(1);
+  }
+  auto parsed = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return parsed.ec == std::errc() && parsed.ptr == text.data() + text.size() &&
+         !text.empty();
+}
+
+// Longest timeout option accepted, in seconds
+constexpr long kMaxCallTimeout = 86400;
+
+// Parse the timeout option of provider-backed functions: whole seconds the
+// call may take. Sets the error result and returns false if out of range.
+bool parse_timeout_option(const json& value, long* timeout,
+                          vef_vdf_result_t* result) {
+  if (!value.is_number_integer() || value.get<long>() < 1 ||
+      value.get<long>() > kMaxCallTimeout) {
+    set_error(result, "timeout must be a whole number of seconds from 1 to " +
+                          std::to_string(kMaxCallTimeout));
+    return false;
+  }
+  *timeout = value.get<long>();
+  return true;
+}
+
+// How long a provider-backed call may keep its server thread: the timeout
+// option if one was given, else VSQL_AI_CALL_TIMEOUT. Zero means only each
+// request's retry deadline applies.
+CallContext::Clock::duration call_timeout(long timeout_option) {
+  static const long default_timeout =
+      std::max(0L, config_int("CALL_TIMEOUT", 0));
+  return std::chrono::seconds(timeout_option > 0 ? timeout_option
+                                                 : default_timeout);
+}
+
+// Whether calls to provider_name need an API key; unknown names do, so that
+// a missing key is reported before the unknown provider
+bool api_key_required(std::string_view provider_name) {
+  AIProvider* provider = ProviderRegistry::instance().find(provider_name);
+  return !provider || provider->needs_api_key();
+}
+
+// Validate the provider/model/api_key arguments shared by provider-backed
+// functions and look up the provider. Sets the error result and returns
+// nullptr if any of them is invalid.
+AIProvider* resolve_provider(std::string_view provider_name,
+                             std::string_view model, std::string_view api_key,
+                             vef_vdf_result_t* result) {
+  if (provider_name.empty()) {
+    set_error(result, "Provider name cannot be empty");
+    return nullptr;
+  }
+
+  if (model.empty()) {
+    set_error(result, "Model name cannot be empty");
+    return nullptr;
+  }
+
+  if (api_key.empty() && api_key_required(provider_name)) {
+    set_error(result, "API key cannot be empty");
+    return nullptr;
+  }
+
+  AIProvider* provider = ProviderRegistry::instance().find(provider_name);
+  if (!provider) {
+    set_error(result, "Unknown provider: " + std::string(provider_name));
+  }
+  return provider;
+}
+
+// Parse a JSON array of non-empty strings (typically built with
+// JSON_ARRAYAGG). `what` names the argument in error messages. Sets the error
+// result and returns false if the argument is malformed.
+bool parse_string_array(vef_invalue_t* arg, const char* what,
+                        std::vector<std::string>* values,
+                        vef_vdf_result_t* result) {
+  try {
+    auto array = json::parse(arg->str_value, arg->str_value + arg->str_len);
+    if (!array.is_array()) {
+      set_error(result, std::string(what) + " must be a JSON array of strings");
+      return false;
+    }
+    values->reserve(array.size());
+    for (auto& value : array) {
+      if (!value.is_string() || value.get_ref<const std::string&>().empty()) {
+        set_error(result, std::string(what) +
+                              " must be a JSON array of non-empty strings");
+        return false;
+      }
+      values->push_back(std::move(value.get_ref<std::string&>()));
+    }
+  } catch (const json::exception& e) {
+    set_error(result, std::string(what) + " must be a JSON array of strings");
+    return false;
+  }
+  return true;
+}
+
+// Embed one text, serving it from the persistent embedding cache when it is
+// enabled. Returns false and sets *error on failure.
+bool embed_text(AIProvider* provider, std::string_view provider_name,
+                std::string_view model, std::string_view api_key,
+                std::string_view text, std::vector<float>* values,
+                std::string* error) {
+  EmbeddingStore& store = EmbeddingStore::instance();
+  uint64_t store_key = 0;
+  if (store.enabled()) {
+    store_key = EmbeddingStore::make_key(provider_name, model, text);
+    if (store.get(store_key, values)) {
+      return true;
+    }
+  }
+
+  // Call provider's embed method
+  *values = provider->embed(model, api_key, text, error);
+  if (!error->empty()) {
+    return false;
+  }
+
+  if (store.enabled()) {
+    store.put(store_key, *values);
+  }
+  return true;
+}
+
+// Embed many texts, serving what we can from the persistent embedding cache
+// and sending only the remaining texts to the provider's batch endpoint.
+// Returns false and sets *error on failure.
+bool embed_texts(AIProvider* provider, std::string_view provider_name,
+                 std::string_view model, std::string_view api_key,
+                 std::vector<std::string> texts,
+                 std::vector<std::vector<float>>* embeddings,
+                 std::string* error) {
+  EmbeddingStore& store = EmbeddingStore::instance();
+  embeddings->assign(texts.size(), {});
+  std::vector<uint64_t> store_keys;
+  std::vector<size_t> missing;
+  if (store.enabled()) {
+    store_keys.reserve(texts.size());
+    for (size_t i = 0; i < texts.size(); i++) {
+      store_keys.push_back(
+          EmbeddingStore::make_key(provider_name, model, texts[i]));
+      if (!store.get(store_keys[i], &(*embeddings)[i])) {
+        missing.push_back(i);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < texts.size(); i++) {
+      missing.push_back(i);
+    }
+  }
+
+  if (missing.empty()) {
+    return true;
+  }
+
+  std::vector<std::string> missing_texts;
+  missing_texts.reserve(missing.size());
+  for (size_t i : missing) {
+    missing_texts.push_back(std::move(texts[i]));
+  }
+
+  // Call provider's batch embed method
+  std::vector<std::vector<float>> fetched =
+      provider->embed_batch(model, api_key, missing_texts, error);
+  if (!error->empty()) {
+    return false;
+  }
+
+  for (size_t j = 0; j < missing.size(); j++) {
+    if (store.enabled()) {
+      store.put(store_keys[missing[j]], fetched[j]);
+    }
+    (*embeddings)[missing[j]] = std::move(fetched[j]);
+  }
+  return true;
+}
+
+// Format JSON arrays of floats as one JSON array, in order
+std::string format_json_vectors(
+    const std::vector<std::vector<float>>& embeddings) {
+  std::string json_array = "[";
+  for (size_t i = 0; i < embeddings.size(); i++) {
+    if (i > 0) {
+      json_array += ',';
+    }
+    json_array +=
+        format_json_vector(embeddings[i].data(), embeddings[i].size());
+  }
+  json_array += ']';
+  return json_array;
+}
+
+}  // namespace
+
+// =============================================================================
+// AI_PROMPT Implementation
+// =============================================================================
+
+namespace {
+
+// Parse the JSON options object of ai_prompt_with_options(). The timeout
+// option, which bounds the SQL call rather than shaping the prompt, goes to
+// *timeout. Sets the error result and returns false if it is malformed.
+bool parse_prompt_options(vef_invalue_t* arg, PromptOptions* options,
+                          long* timeout, vef_vdf_result_t* result) {
+  json object;
+  try {
+    object = json::parse(arg->str_value, arg->str_value + arg->str_len);
+  } catch (const json::exception& e) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+  if (!object.is_object()) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+
+  for (auto& [name, value] : object.items()) {
+    if (name == "max_tokens") {
+      if (!value.is_number_integer() || value.get<long>() <= 0) {
+        set_error(result, "max_tokens must be a positive integer");
+        return false;
+      }
+      options->max_tokens = value.get<long>();
+    } else if (name == "temperature") {
+      if (!value.is_number() || value.get<double>() < 0) {
+        set_error(result, "temperature must be a non-negative number");
+        return false;
+      }
+      options->temperature = value.get<double>();
+    } else if (name == "stop") {
+      // A single string or an array of strings
+      if (value.is_string()) {
+        options->stop_sequences.push_back(value.get<std::string>());
+        continue;
+      }
+      if (!value.is_array()) {
+        set_error(result, "stop must be a string or an array of strings");
+        return false;
+      }
+      for (auto& sequence : value) {
+        if (!sequence.is_string()) {
+          set_error(result, "stop must be a string or an array of strings");
+          return false;
+        }
+        options->stop_sequences.push_back(sequence.get<std::string>());
+      }
+    } else if (name == "system") {
+      if (!value.is_string()) {
+        set_error(result, "system must be a string");
+        return false;
+      }
+      options->system = value.get<std::string>();
+    } else if (name == "cache_system") {
+      if (!value.is_boolean()) {
+        set_error(result, "cache_system must be true or false");
+        return false;
+      }
+      options->cache_system = value.get<bool>();
+    } else if (name == "timeout") {
+      if (!parse_timeout_option(value, timeout, result)) {
+        return false;
+      }
+    } else {
+      set_error(result, "Unknown option '" + name + "'");
+      return false;
+    }
+  }
+  return true;
+}
+
+// Shared body of ai_prompt() and ai_prompt_with_options()
+void run_prompt(vef_invalue_t* provider_arg, vef_invalue_t* model_arg,
+                vef_invalue_t* api_key_arg, vef_invalue_t* prompt_arg,
+                const PromptOptions& options, long timeout,
+                vef_vdf_result_t* result) {
+  // Extract arguments
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+  std::string_view prompt_text = arg_string(prompt_arg);
+
+  AIProvider* provider =
+      resolve_provider(arg_string(provider_arg), model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  if (prompt_text.empty()) {
+    set_error(result, "Prompt text cannot be empty");
+    return;
+  }
+
+  // Call provider; unless overridden, max_tokens is derived from the result
+  // buffer so we never pay for text that cannot be returned
+  CallContext call(call_timeout(timeout));
+  CallContext::Scope scope(&call);
+  std::string error;
+  bool truncated = false;
+  std::string response =
+      provider->prompt(model, api_key, prompt_text, options,
+                       result->max_str_len - 1, &truncated, &error);
+
+  // Handle errors
+  if (!error.empty()) {
+    set_error(result, error);
+    return;
+  }
+
+  // The provider abandons the stream once the answer overflows the buffer,
+  // which only an explicit max_tokens allows; fail rather than return a
+  // cut-off answer
+  if (truncated) {
+    set_error(result, "Response exceeds the " +
+                          std::to_string(result->max_str_len - 1) +
+                          "-byte result buffer; use ai_prompt_long() for "
+                          "longer answers");
+    return;
+  }
+
+  set_string_result(result, response);
+}
+
+}  // namespace
+
+void ai_prompt_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                    vef_invalue_t* model_arg, vef_invalue_t* api_key_arg,
+                    vef_invalue_t* prompt_arg, vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      prompt_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  run_prompt(provider_arg, model_arg, api_key_arg, prompt_arg, PromptOptions(),
+             0, result);
+}
+
+void ai_prompt_with_options_impl(vef_context_t* ctx,
+                                 vef_invalue_t* provider_arg,
+                                 vef_invalue_t* model_arg,
+                                 vef_invalue_t* api_key_arg,
+                                 vef_invalue_t* prompt_arg,
+                                 vef_invalue_t* options_arg,
+                                 vef_vdf_result_t* result) {
+  // Validate NULL inputs; NULL options means defaults
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      prompt_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  PromptOptions options;
+  long timeout = 0;
+  if (!options_arg->is_null &&
+      !parse_prompt_options(options_arg, &options, &timeout, result)) {
+    return;
+  }
+
+  run_prompt(provider_arg, model_arg, api_key_arg, prompt_arg, options,
+             timeout, result);
+}
+
+// =============================================================================
+// AI_PROMPT_LONG Implementation
+// =============================================================================
+
+void ai_prompt_long_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                         vef_invalue_t* model_arg, vef_invalue_t* api_key_arg,
+                         vef_invalue_t* prompt_arg, vef_invalue_t* options_arg,
+                         vef_vdf_result_t* result) {
+  // Same as ai_prompt_with_options(); only the result buffer differs, so
+  // long answers need not inflate the buffer of every short-answer call
+  ai_prompt_with_options_impl(ctx, provider_arg, model_arg, api_key_arg,
+                              prompt_arg, options_arg, result);
+}
+
+// =============================================================================
+// AI_PROMPT_WITH_SYSTEM Implementation
+// =============================================================================
+
+void ai_prompt_with_system_impl(vef_context_t* ctx,
+                                vef_invalue_t* provider_arg,
+                                vef_invalue_t* model_arg,
+                                vef_invalue_t* api_key_arg,
+                                vef_invalue_t* system_arg,
+                                vef_invalue_t* prompt_arg,
+                                vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      system_arg->is_null || prompt_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  // The instructions shared by every row go to the provider's prompt cache,
+  // so only the row's own prompt is processed in full
+  PromptOptions options;
+  options.system = std::string(arg_string(system_arg));
+  options.cache_system = true;
+
+  run_prompt(provider_arg, model_arg, api_key_arg, prompt_arg, options, 0,
+             result);
+}
+
+// =============================================================================
+// AI_PROMPT_PARALLEL Implementation
+// =============================================================================
+
+void ai_prompt_parallel_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                             vef_invalue_t* model_arg,
+                             vef_invalue_t* api_key_arg,
+                             vef_invalue_t* prompts_arg,
+                             vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      prompts_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  // Extract arguments
+  std::string_view provider_name = arg_string(provider_arg);
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+
+  AIProvider* provider =
+      resolve_provider(provider_name, model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  std::vector<std::string> prompts;
+  if (!parse_string_array(prompts_arg, "Prompts", &prompts, result)) {
+    return;
+  }
+
+  // Keep up to the provider's concurrency limit of prompts in flight; each
+  // task writes only its own slot, so results stay in input order
+  std::vector<std::string> responses(prompts.size());
+  std::vector<std::string> errors(prompts.size());
+  size_t concurrency =
+      ProviderRegistry::instance().settings(provider->id()).max_concurrency;
+  // No single response can use more than the whole result buffer
+  size_t max_length = result->max_str_len - 1;
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  WorkerPool::instance().parallel_for(
+      prompts.size(), concurrency, [&](size_t i) {
+        responses[i] = provider->prompt(model, api_key, prompts[i],
+                                        PromptOptions(), max_length,
+                                        nullptr, &errors[i]);
+      });
+
+  for (const auto& error : errors) {
+    if (!error.empty()) {
+      set_error(result, error);
+      return;
+    }
+  }
+
+  // Return a JSON array with one response per prompt, in order
+  json responses_json = json::array();
+  for (auto& response : responses) {
+    responses_json.push_back(std::move(response));
+  }
+  std::string responses_str =
+      responses_json.dump(-1, ' ', false, json::error_handler_t::replace);
+
+  // A truncated array is unusable, so fail instead
+  if (responses_str.length() > result->max_str_len - 1) {
+    set_error(result,
+              "Responses exceed the result buffer; pass fewer prompts per call");
+    return;
+  }
+
+  set_string_result(result, responses_str);
+}
+
+// =============================================================================
+// AI_PROMPT_BATCH Implementation
+// =============================================================================
+
+namespace {
+
+// Custom ids name prompts in a batch's results; the API accepts 1 to 64
+// letters, digits, '_' and '-'
+bool valid_custom_id(std::string_view id) {
+  if (id.empty() || id.size() > 64) {
+    return false;
+  }
+  return std::all_of(id.begin(), id.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-';
+  });
+}
+
+// Parse the prompts of ai_prompt_batch_submit(): a JSON array, whose
+// prompts are named by their index, or an object from custom id to prompt
+// (typically built with JSON_OBJECTAGG over a primary key). Sets the error
+// result and returns false if it is malformed.
+bool parse_batch_prompts(vef_invalue_t* arg,
+                         std::vector<std::string>* custom_ids,
+                         std::vector<std::string>* prompts,
+                         vef_vdf_result_t* result) {
+  const char* malformed =
+      "Prompts must be a JSON array or object of non-empty strings";
+  json value;
+  try {
+    value = json::parse(arg->str_value, arg->str_value + arg->str_len);
+  } catch (const json::exception& e) {
+    set_error(result, malformed);
+    return false;
+  }
+  if (!value.is_array() && !value.is_object()) {
+    set_error(result, malformed);
+    return false;
+  }
+
+  custom_ids->reserve(value.size());
+  prompts->reserve(value.size());
+  size_t index = 0;
+  for (auto& [name, prompt] : value.items()) {
+    if (!prompt.is_string() || prompt.get_ref<const std::string&>().empty()) {
+      set_error(result, malformed);
+      return false;
+    }
+    if (value.is_array()) {
+      custom_ids->push_back(std::to_string(index++));
+    } else if (valid_custom_id(name)) {
+      custom_ids->push_back(name);
+    } else {
+      set_error(result, "Invalid custom id '" + name +
+                            "': use 1 to 64 letters, digits, '_' or '-'");
+      return false;
+    }
+    prompts->push_back(std::move(prompt.get_ref<std::string&>()));
+  }
+  return true;
+}
+
+// Look up the provider of a batch function taking provider, api_key and
+// batch_id. Sets the error result and returns nullptr if any is invalid.
+AIProvider* resolve_batch_provider(std::string_view provider_name,
+                                   std::string_view api_key,
+                                   std::string_view batch_id,
+                                   vef_vdf_result_t* result) {
+  if (api_key.empty() && api_key_required(provider_name)) {
+    set_error(result, "API key cannot be empty");
+    return nullptr;
+  }
+  if (batch_id.empty()) {
+    set_error(result, "Batch id cannot be empty");
+    return nullptr;
+  }
+  AIProvider* provider = ProviderRegistry::instance().find(provider_name);
+  if (!provider) {
+    set_error(result, "Unknown provider: " + std::string(provider_name));
+  }
+  return provider;
+}
+
+}  // namespace
+
+void ai_prompt_batch_submit_impl(vef_context_t* ctx,
+                                 vef_invalue_t* provider_arg,
+                                 vef_invalue_t* model_arg,
+                                 vef_invalue_t* api_key_arg,
+                                 vef_invalue_t* prompts_arg,
+                                 vef_invalue_t* options_arg,
+                                 vef_vdf_result_t* result) {
+  // Validate NULL inputs; NULL options means defaults
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      prompts_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+  AIProvider* provider =
+      resolve_provider(arg_string(provider_arg), model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  PromptOptions options;
+  long timeout = 0;
+  if (!options_arg->is_null &&
+      !parse_prompt_options(options_arg, &options, &timeout, result)) {
+    return;
+  }
+
+  std::vector<std::string> custom_ids;
+  std::vector<std::string> prompts;
+  if (!parse_batch_prompts(prompts_arg, &custom_ids, &prompts, result)) {
+    return;
+  }
+
+  // Only the upload waits, and the timeout is for it alone; the batch is
+  // polled in the background
+  CallContext call(call_timeout(timeout));
+  CallContext::Scope scope(&call);
+  std::string batch_id;
+  std::string error;
+  if (!PromptBatches::instance().submit(provider, model, api_key, custom_ids,
+                                        prompts, options, &batch_id,
+                                        &error)) {
+    set_error(result, error);
+    return;
+  }
+  set_string_result(result, batch_id);
+}
+
+void ai_prompt_batch_status_impl(vef_context_t* ctx,
+                                 vef_invalue_t* provider_arg,
+                                 vef_invalue_t* api_key_arg,
+                                 vef_invalue_t* batch_id_arg,
+                                 vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || api_key_arg->is_null || batch_id_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  std::string_view api_key = arg_string(api_key_arg);
+  std::string_view batch_id = arg_string(batch_id_arg);
+  AIProvider* provider = resolve_batch_provider(arg_string(provider_arg),
+                                                api_key, batch_id, result);
+  if (!provider) {
+    return;
+  }
+
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  PromptBatches::Status status;
+  std::string error;
+  if (!PromptBatches::instance().status(provider, api_key, batch_id, &status,
+                                        &error)) {
+    set_error(result, error);
+    return;
+  }
+
+  const MessageBatch& batch = status.batch;
+  json failures = json::object();
+  for (const auto& failure : status.failures) {
+    failures[failure.first] = failure.second;
+  }
+  json status_json = {{"id", batch.id},
+                      {"status", batch.processing_status},
+                      {"results_ready", status.results_ready},
+                      {"requests",
+                       {{"processing", batch.processing},
+                        {"succeeded", batch.succeeded},
+                        {"errored", batch.errored},
+                        {"canceled", batch.canceled},
+                        {"expired", batch.expired}}},
+                      {"failures", failures}};
+  if (!status.poll_error.empty()) {
+    status_json["error"] = status.poll_error;
+  }
+  set_string_result(result, status_json.dump(-1, ' ', false,
+                                             json::error_handler_t::replace));
+}
+
+void ai_prompt_batch_result_impl(vef_context_t* ctx,
+                                 vef_invalue_t* provider_arg,
+                                 vef_invalue_t* api_key_arg,
+                                 vef_invalue_t* batch_id_arg,
+                                 vef_invalue_t* custom_id_arg,
+                                 vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || api_key_arg->is_null || batch_id_arg->is_null ||
+      custom_id_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  std::string_view api_key = arg_string(api_key_arg);
+  std::string_view batch_id = arg_string(batch_id_arg);
+  AIProvider* provider = resolve_batch_provider(arg_string(provider_arg),
+                                                api_key, batch_id, result);
+  if (!provider) {
+    return;
+  }
+
+  // A prompt that failed, or a custom id not in the batch, gives NULL, so
+  // one bad row does not abort a whole UPDATE; ai_prompt_batch_status()
+  // lists the failures
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  std::string text;
+  bool found = false;
+  std::string error;
+  if (!PromptBatches::instance().result(provider, api_key, batch_id,
+                                        arg_string(custom_id_arg), &text,
+                                        &found, &error)) {
+    set_error(result, error);
+    return;
+  }
+  if (!found) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+  set_string_result(result, text);
+}
+
+// =============================================================================
+// CREATE_EMBED Implementation
+// =============================================================================
+
+void create_embed_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                       vef_invalue_t* model_arg, vef_invalue_t* api_key_arg,
+                       vef_invalue_t* text_arg, vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      text_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  // Extract arguments
+  std::string_view provider_name = arg_string(provider_arg);
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+  std::string_view text = arg_string(text_arg);
+
+  AIProvider* provider =
+      resolve_provider(provider_name, model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  if (text.empty()) {
+    set_error(result, "Text cannot be empty");
+    return;
+  }
+
+  // Get the embedding, from the persistent cache if possible
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  std::string error;
+  std::vector<float> values;
+  if (!embed_text(provider, provider_name, model, api_key, text, &values,
+                  &error)) {
+    set_error(result, error);
+    return;
+  }
+
+  // Format the JSON array of floats straight into the result buffer
+  size_t length = format_json_vector(values.data(), values.size(),
+                                     result->str_buf, result->max_str_len - 1);
+  if (length == 0) {
+    set_error(result,
+              "Embedding exceeds the result buffer; use create_embed_binary()");
+    return;
+  }
+  result->type = VEF_RESULT_VALUE;
+  result->str_buf[length] = '\0';
+  result->actual_len = length;
+}
+
+// =============================================================================
+// CREATE_EMBED_BINARY Implementation
+// =============================================================================
+
+void create_embed_binary_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                              vef_invalue_t* model_arg,
+                              vef_invalue_t* api_key_arg,
+                              vef_invalue_t* text_arg,
+                              vef_invalue_t* format_arg,
+                              vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      text_arg->is_null || format_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  // Extract arguments
+  std::string_view provider_name = arg_string(provider_arg);
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+  std::string_view text = arg_string(text_arg);
+
+  AIProvider* provider =
+      resolve_provider(provider_name, model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  if (text.empty()) {
+    set_error(result, "Text cannot be empty");
+    return;
+  }
+
+  BinaryFormat format;
+  if (!parse_binary_format(
+          std::string_view(format_arg->str_value, format_arg->str_len),
+          &format)) {
+    set_error(result, "Format must be float32, float16 or int8");
+    return;
+  }
+
+  // Get the embedding, from the persistent cache if possible
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  std::string error;
+  std::vector<float> values;
+  if (!embed_text(provider, provider_name, model, api_key, text, &values,
+                  &error)) {
+    set_error(result, error);
+    return;
+  }
+
+  // Truncated bytes would decode to a wrong vector, so fail instead
+  size_t length = binary_vector_size(values.size(), format);
+  if (length > result->max_str_len) {
+    set_error(result, "Embedding exceeds the result buffer");
+    return;
+  }
+
+  // Binary result: may contain NUL bytes, so rely on actual_len
+  result->type = VEF_RESULT_VALUE;
+  encode_binary_vector(values.data(), values.size(), format, result->str_buf);
+  result->actual_len = length;
+}
+
+// =============================================================================
+// CREATE_EMBED_BATCH Implementation
+// =============================================================================
+
+void create_embed_batch_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                             vef_invalue_t* model_arg,
+                             vef_invalue_t* api_key_arg,
+                             vef_invalue_t* texts_arg,
+                             vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      texts_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  // Extract arguments
+  std::string_view provider_name = arg_string(provider_arg);
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+
+  AIProvider* provider =
+      resolve_provider(provider_name, model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  // Texts arrive as a JSON array, typically built with JSON_ARRAYAGG()
+  std::vector<std::string> texts;
+  if (!parse_string_array(texts_arg, "Texts", &texts, result)) {
+    return;
+  }
+
+  CallContext call(call_timeout(0));
+  CallContext::Scope scope(&call);
+  std::vector<std::vector<float>> embeddings;
+  std::string error;
+  if (!embed_texts(provider, provider_name, model, api_key, std::move(texts),
+                   &embeddings, &error)) {
+    set_error(result, error);
+    return;
+  }
+
+  // Return a JSON array with one embedding per input text, in order
+  std::string embeddings_json = format_json_vectors(embeddings);
+
+  // A truncated array is unusable, so fail instead
+  if (embeddings_json.length() > result->max_str_len - 1) {
+    set_error(result,
+              "Embeddings exceed the result buffer; pass fewer texts per call");
+    return;
+  }
+
+  set_string_result(result, embeddings_json);
+}
+
+// =============================================================================
+// AI_CHUNK Implementation
+// =============================================================================
+
+namespace {
+
+// Largest chunk size accepted, in estimated tokens
+constexpr int64_t kMaxChunkTokens = 1000000;
+
+// Default chunk size of create_embed_chunks(); within every supported
+// model's input limit
+constexpr size_t kDefaultChunkTokens = 512;
+
+bool valid_chunk_size(int64_t max_tokens, int64_t overlap,
+                      vef_vdf_result_t* result) {
+  if (max_tokens < 1 || max_tokens > kMaxChunkTokens) {
+    set_error(result, "max_tokens must be an integer from 1 to " +
+                          std::to_string(kMaxChunkTokens));
+    return false;
+  }
+  if (overlap < 0 || overlap >= max_tokens) {
+    set_error(result,
+              "overlap must be a non-negative integer less than max_tokens");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void ai_chunk_impl(vef_context_t* ctx, vef_invalue_t* text_arg,
+                   vef_invalue_t* max_tokens_arg, vef_invalue_t* overlap_arg,
+                   vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (text_arg->is_null || max_tokens_arg->is_null || overlap_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  int64_t max_tokens;
+  int64_t overlap;
+  if (!parse_integer(max_tokens_arg, &max_tokens)) {
+    max_tokens = 0;
+  }
+  if (!parse_integer(overlap_arg, &overlap)) {
+    overlap = -1;
+  }
+  if (!valid_chunk_size(max_tokens, overlap, result)) {
+    return;
+  }
+
+  json chunks = json::array();
+  for (const TextChunk& chunk :
+       chunk_text(arg_string(text_arg), static_cast<size_t>(max_tokens),
+                  static_cast<size_t>(overlap))) {
+    chunks.push_back(chunk.text);
+  }
+  set_string_result(result, chunks.dump(-1, ' ', false,
+                                        json::error_handler_t::replace));
+}
+
+// =============================================================================
+// CREATE_EMBED_CHUNKS Implementation
+// =============================================================================
+
+namespace {
+
+struct ChunkOptions {
+  int64_t max_tokens = kDefaultChunkTokens;
+  int64_t overlap = 0;
+  bool mean = false;  // pool the chunks' embeddings into one
+  long timeout = 0;   // seconds; 0 for VSQL_AI_CALL_TIMEOUT
+};
+
+// Parse the JSON options object of create_embed_chunks(). Sets the error
+// result and returns false if it is malformed.
+bool parse_chunk_options(vef_invalue_t* arg, ChunkOptions* options,
+                         vef_vdf_result_t* result) {
+  json object;
+  try {
+    object = json::parse(arg->str_value, arg->str_value + arg->str_len);
+  } catch (const json::exception& e) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+  if (!object.is_object()) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+
+  for (auto& [name, value] : object.items()) {
+    if (name == "max_tokens") {
+      options->max_tokens =
+          value.is_number_integer() ? value.get<int64_t>() : 0;
+    } else if (name == "overlap") {
+      options->overlap = value.is_number_integer() ? value.get<int64_t>() : -1;
+    } else if (name == "pool") {
+      std::string pool = value.is_string() ? value.get<std::string>() : "";
+      if (pool != "none" && pool != "mean") {
+        set_error(result, "pool must be \"none\" or \"mean\"");
+        return false;
+      }
+      options->mean = pool == "mean";
+    } else if (name == "timeout") {
+      if (!parse_timeout_option(value, &options->timeout, result)) {
+        return false;
+      }
+    } else {
+      set_error(result, "Unknown option '" + name + "'");
+      return false;
+    }
+  }
+  return valid_chunk_size(options->max_tokens, options->overlap, result);
+}
+
+// Average of the chunks' embeddings weighted by their token counts, scaled
+// to unit length. Returns false if the dimensions differ.
+bool mean_pool(const std::vector<std::vector<float>>& embeddings,
+               const std::vector<TextChunk>& chunks,
+               std::vector<float>* pooled) {
+  std::vector<double> sum(embeddings[0].size(), 0.0);
+  for (size_t i = 0; i < embeddings.size(); i++) {
+    if (embeddings[i].size() != sum.size()) {
+      return false;
+    }
+    double weight = static_cast<double>(chunks[i].tokens);
+    for (size_t d = 0; d < sum.size(); d++) {
+      sum[d] += weight * embeddings[i][d];
+    }
+  }
+
+  double norm = 0.0;
+  for (double value : sum) {
+    norm += value * value;
+  }
+  double scale = norm > 0.0 ? 1.0 / std::sqrt(norm) : 0.0;
+  pooled->resize(sum.size());
+  for (size_t d = 0; d < sum.size(); d++) {
+    (*pooled)[d] = static_cast<float>(sum[d] * scale);
+  }
+  return true;
+}
+
+}  // namespace
+
+void create_embed_chunks_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
+                              vef_invalue_t* model_arg,
+                              vef_invalue_t* api_key_arg,
+                              vef_invalue_t* text_arg,
+                              vef_invalue_t* options_arg,
+                              vef_vdf_result_t* result) {
+  // Validate NULL inputs; NULL options means defaults
+  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
+      text_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
+    return;
+  }
+
+  std::string_view provider_name = arg_string(provider_arg);
+  std::string_view model = arg_string(model_arg);
+  std::string_view api_key = arg_string(api_key_arg);
+  AIProvider* provider =
+      resolve_provider(provider_name, model, api_key, result);
+  if (!provider) {
+    return;
+  }
+
+  ChunkOptions options;
+  if (!options_arg->is_null &&
+      !parse_chunk_options(options_arg, &options, result)) {
+    return;
+  }
+
+  std::vector<TextChunk> chunks =
+      chunk_text(arg_string(text_arg), static_cast<size_t>(options.max_tokens),
+                 static_cast<size_t>(options.overlap));
+  if (chunks.empty()) {
+    set_error(result, "Text cannot be empty");
+    return;
+  }
+
+  // All chunks go to the provider's batch endpoint together
+  std::vector<std::string> texts;
+  texts.reserve(chunks.size());
+  for (const TextChunk& chunk : chunks) {
+    texts.emplace_back(chunk.text);
+  }
+  CallContext call(call_timeout(options.timeout));
+  CallContext::Scope scope(&call);
+  std::vector<std::vector<float>> embeddings;
+  std::string error;
+  if (!embed_texts(provider, provider_name, model, api_key, std::move(texts),
+                   &embeddings, &error)) {
+    set_error(result, error);
+    return;
+  }
+
+  std::string embeddings_json;
+  if (options.mean) {
+    std::vector<float> pooled;
+    if (!mean_pool(embeddings, chunks, &pooled)) {
+      set_error(result, "Chunk embeddings have different dimensions");
+      return;
+    }
+    embeddings_json = format_json_vector(pooled.data(), pooled.size());
+  } else {
+    // One embedding per chunk, in the order ai_chunk() returns them
+    embeddings_json = format_json_vectors(embeddings);
+  }
+
+  if (embeddings_json.length() > result->max_str_len - 1) {
+    set_error(result, "Embeddings exceed the result buffer; use larger "
+                      "chunks or {\"pool\": \"mean\"}");
+    return;
+  }
+  set_string_result(result, embeddings_json);
+}
+
 // =============================================================================
-// AI_PROMPT Implementation
+// VEC_COSINE / VEC_DOT / VEC_L2 Implementation
 // =============================================================================
 
-void ai_prompt_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
-                    vef_invalue_t* model_arg, vef_invalue_t* api_key_arg,
-                    vef_invalue_t* prompt_arg, vef_vdf_result_t* result) {
-  // Validate NULL inputs
-  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
-      prompt_arg->is_null) {
+// Parse both vector arguments into per-thread buffers, so scanning a table row
+// by row does not allocate. Returns false and sets the result (NULL or error)
+// if either argument is unusable.
+bool parse_vector_args(vef_invalue_t* a_arg, vef_invalue_t* b_arg,
+                       const std::vector<float>** a,
+                       const std::vector<float>** b,
+                       vef_vdf_result_t* result) {
+  if (a_arg->is_null || b_arg->is_null) {
     result->type = VEF_RESULT_NULL;
+    return false;
+  }
+
+  thread_local std::vector<float> a_values;
+  thread_local std::vector<float> b_values;
+  if (!parse_vector(std::string_view(a_arg->str_value, a_arg->str_len),
+                    &a_values) ||
+      !parse_vector(std::string_view(b_arg->str_value, b_arg->str_len),
+                    &b_values)) {
+    set_error(result,
+              "Vectors must be JSON arrays of numbers or packed float32");
+    return false;
+  }
+
+  if (a_values.empty() || a_values.size() != b_values.size()) {
+    set_error(result, "Vectors must have the same, non-zero dimensions");
+    return false;
+  }
+
+  *a = &a_values;
+  *b = &b_values;
+  return true;
+}
+
+void set_real_result(vef_vdf_result_t* result, double value) {
+  result->type = VEF_RESULT_VALUE;
+  result->real_value = value;
+}
+
+void vec_cosine_impl(vef_context_t* ctx, vef_invalue_t* a_arg,
+                     vef_invalue_t* b_arg, vef_vdf_result_t* result) {
+  const std::vector<float>* a;
+  const std::vector<float>* b;
+  if (!parse_vector_args(a_arg, b_arg, &a, &b, result)) {
     return;
   }
 
-  // Extract arguments
-  std::string provider_name(provider_arg->str_value, provider_arg->str_len);
-  std::string model(model_arg->str_value, model_arg->str_len);
-  std::string api_key(api_key_arg->str_value, api_key_arg->str_len);
-  std::string prompt_text(prompt_arg->str_value, prompt_arg->str_len);
+  float dot, norm_a, norm_b;
+  vector_kernels().dot_norms(a->data(), b->data(), a->size(), &dot, &norm_a,
+                             &norm_b);
 
-  // Validate empty strings
-  if (provider_name.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Provider name cannot be empty");
+  // Cosine similarity is undefined for a zero vector
+  double denominator = std::sqrt(static_cast<double>(norm_a) * norm_b);
+  if (denominator == 0.0) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
+  set_real_result(result, dot / denominator);
+}
 
-  if (model.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Model name cannot be empty");
+void vec_dot_impl(vef_context_t* ctx, vef_invalue_t* a_arg,
+                  vef_invalue_t* b_arg, vef_vdf_result_t* result) {
+  const std::vector<float>* a;
+  const std::vector<float>* b;
+  if (!parse_vector_args(a_arg, b_arg, &a, &b, result)) {
     return;
   }
+  set_real_result(result,
+                  vector_kernels().dot(a->data(), b->data(), a->size()));
+}
 
-  if (api_key.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "API key cannot be empty");
+void vec_l2_impl(vef_context_t* ctx, vef_invalue_t* a_arg,
+                 vef_invalue_t* b_arg, vef_vdf_result_t* result) {
+  const std::vector<float>* a;
+  const std::vector<float>* b;
+  if (!parse_vector_args(a_arg, b_arg, &a, &b, result)) {
     return;
   }
+  set_real_result(result, std::sqrt(vector_kernels().l2_squared(
+                              a->data(), b->data(), a->size())));
+}
 
-  if (prompt_text.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Prompt text cannot be empty");
+// =============================================================================
+// VEC_INDEX_* / VEC_KNN Implementation
+// =============================================================================
+
+namespace {
+
+// Parse the JSON options object of vec_index_create(). Sets the error result
+// and returns false if it is malformed.
+bool parse_index_options(vef_invalue_t* arg, VectorIndex::Options* options,
+                         vef_vdf_result_t* result) {
+  json object;
+  try {
+    object = json::parse(arg->str_value, arg->str_value + arg->str_len);
+  } catch (const json::exception& e) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+  if (!object.is_object()) {
+    set_error(result, "Options must be a JSON object");
+    return false;
+  }
+
+  // Bounds for the integer options
+  auto integer = [&](const std::string& name, const json& value, long min,
+                     long max, uint32_t* field) {
+    if (!value.is_number_integer() || value.get<long>() < min ||
+        value.get<long>() > max) {
+      set_error(result, name + " must be an integer from " +
+                            std::to_string(min) + " to " +
+                            std::to_string(max));
+      return false;
+    }
+    *field = static_cast<uint32_t>(value.get<long>());
+    return true;
+  };
+
+  for (auto& [name, value] : object.items()) {
+    if (name == "metric") {
+      std::string metric = value.is_string() ? value.get<std::string>() : "";
+      if (metric == "cosine") {
+        options->metric = VectorIndex::Metric::kCosine;
+      } else if (metric == "l2") {
+        options->metric = VectorIndex::Metric::kL2;
+      } else if (metric == "dot") {
+        options->metric = VectorIndex::Metric::kDot;
+      } else {
+        set_error(result, "metric must be \"cosine\", \"l2\" or \"dot\"");
+        return false;
+      }
+    } else if (name == "dimensions") {
+      if (!integer(name, value, 1, 65536, &options->dimensions)) {
+        return false;
+      }
+    } else if (name == "m") {
+      if (!integer(name, value, 2, 128, &options->m)) {
+        return false;
+      }
+    } else if (name == "ef_construction") {
+      if (!integer(name, value, 1, 10000, &options->ef_construction)) {
+        return false;
+      }
+    } else if (name == "ef_search") {
+      if (!integer(name, value, 1, 10000, &options->ef_search)) {
+        return false;
+      }
+    } else {
+      set_error(result, "Unknown option '" + name + "'");
+      return false;
+    }
+  }
+  return true;
+}
+
+const char* metric_name(VectorIndex::Metric metric) {
+  switch (metric) {
+    case VectorIndex::Metric::kCosine:
+      return "cosine";
+    case VectorIndex::Metric::kL2:
+      return "l2";
+    case VectorIndex::Metric::kDot:
+      return "dot";
+  }
+  return "";
+}
+
+// Look up the index named by arg. Sets the error result and returns nullptr
+// if there is none.
+std::shared_ptr<VectorIndex> find_index(const vef_invalue_t* arg,
+                                        vef_vdf_result_t* result) {
+  std::string error;
+  auto index = VectorIndexes::instance().find(arg_string(arg), &error);
+  if (!index) {
+    set_error(result, error);
+  }
+  return index;
+}
+
+// Parse a vector argument into a per-thread buffer
+bool parse_index_vector(const vef_invalue_t* arg,
+                        const std::vector<float>** values,
+                        vef_vdf_result_t* result) {
+  thread_local std::vector<float> buffer;
+  if (!parse_vector(arg_string(arg), &buffer)) {
+    set_error(result,
+              "Vector must be a JSON array of numbers or packed float32");
+    return false;
+  }
+  *values = &buffer;
+  return true;
+}
+
+}  // namespace
+
+void vec_index_create_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                           vef_invalue_t* options_arg,
+                           vef_vdf_result_t* result) {
+  // Validate NULL inputs; NULL options means defaults
+  if (name_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Create provider
-  auto provider = create_provider(provider_name);
-  if (!provider) {
-    result->type = VEF_RESULT_ERROR;
-    std::string error_msg = "Unknown provider: " + provider_name;
-    strncpy(result->error_msg, error_msg.c_str(),
-            sizeof(result->error_msg) - 1);
-    result->error_msg[sizeof(result->error_msg) - 1] = '\0';
+  VectorIndex::Options options;
+  if (!options_arg->is_null &&
+      !parse_index_options(options_arg, &options, result)) {
     return;
   }
 
-  // Call provider
   std::string error;
-  std::string response = provider->prompt(model, api_key, prompt_text, &error);
+  if (!VectorIndexes::instance().create(arg_string(name_arg), options,
+                                        &error)) {
+    set_error(result, error);
+    return;
+  }
+  set_string_result(result, arg_string(name_arg));
+}
 
-  // Handle errors
-  if (!error.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    // Limit error message length to avoid buffer overflow
-    if (error.length() > 255) {
-      error = error.substr(0, 255);
-    }
-    strcpy(result->error_msg, error.c_str());
+void vec_index_add_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                        vef_invalue_t* id_arg, vef_invalue_t* vector_arg,
+                        vef_vdf_result_t* result) {
+  // Validate NULL inputs; rows with a NULL id or embedding are skipped
+  if (name_arg->is_null || id_arg->is_null || vector_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Return result
-  result->type = VEF_RESULT_VALUE;
-  result->actual_len = response.length();
+  int64_t id;
+  if (!parse_integer(id_arg, &id)) {
+    set_error(result, "Id must be an integer");
+    return;
+  }
 
-  // Copy response to buffer (truncate if necessary)
-  size_t copy_len = std::min(response.length(), result->max_str_len - 1);
-  memcpy(result->str_buf, response.c_str(), copy_len);
-  result->str_buf[copy_len] = '\0';
+  const std::vector<float>* values;
+  if (!parse_index_vector(vector_arg, &values, result)) {
+    return;
+  }
 
-  // If response was truncated, note it in error but still return value
-  if (response.length() > result->max_str_len - 1) {
-    result->actual_len = copy_len;
+  auto index = find_index(name_arg, result);
+  if (!index) {
+    return;
   }
-}
 
-// =============================================================================
-// CREATE_EMBED Implementation
-// =============================================================================
+  // Only queued here; the graph is built by worker threads in the meantime
+  std::string error;
+  if (!index->add(id, values->data(), values->size(), &error)) {
+    set_error(result, error);
+    return;
+  }
+  set_real_result(result, static_cast<double>(index->stats().vectors));
+}
 
-void create_embed_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
-                       vef_invalue_t* model_arg, vef_invalue_t* api_key_arg,
-                       vef_invalue_t* text_arg, vef_vdf_result_t* result) {
+void vec_knn_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                  vef_invalue_t* query_arg, vef_invalue_t* k_arg,
+                  vef_vdf_result_t* result) {
   // Validate NULL inputs
-  if (provider_arg->is_null || model_arg->is_null || api_key_arg->is_null ||
-      text_arg->is_null) {
+  if (name_arg->is_null || query_arg->is_null || k_arg->is_null) {
     result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Extract arguments
-  std::string provider_name(provider_arg->str_value, provider_arg->str_len);
-  std::string model(model_arg->str_value, model_arg->str_len);
-  std::string api_key(api_key_arg->str_value, api_key_arg->str_len);
-  std::string text(text_arg->str_value, text_arg->str_len);
+  int64_t k;
+  if (!parse_integer(k_arg, &k) || k <= 0 || k > 1000) {
+    set_error(result, "k must be an integer from 1 to 1000");
+    return;
+  }
 
-  // Validate empty strings
-  if (provider_name.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Provider name cannot be empty");
+  const std::vector<float>* query;
+  if (!parse_index_vector(query_arg, &query, result)) {
     return;
   }
 
-  if (model.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Model name cannot be empty");
+  auto index = find_index(name_arg, result);
+  if (!index) {
     return;
   }
 
-  if (api_key.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "API key cannot be empty");
+  thread_local std::vector<VectorIndex::Neighbor> neighbors;
+  std::string error;
+  if (!index->search(query->data(), query->size(), static_cast<size_t>(k),
+                     &neighbors, &error)) {
+    set_error(result, error);
     return;
   }
 
-  if (text.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    strcpy(result->error_msg, "Text cannot be empty");
+  json array = json::array();
+  for (const auto& neighbor : neighbors) {
+    array.push_back({{"id", neighbor.id}, {"distance", neighbor.distance}});
+  }
+  set_string_result(result, array.dump());
+}
+
+void vec_index_save_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                         vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (name_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Create provider
-  auto provider = create_provider(provider_name);
-  if (!provider) {
-    result->type = VEF_RESULT_ERROR;
-    std::string error_msg = "Unknown provider: " + provider_name;
-    strncpy(result->error_msg, error_msg.c_str(),
-            sizeof(result->error_msg) - 1);
-    result->error_msg[sizeof(result->error_msg) - 1] = '\0';
+  size_t vectors = 0;
+  std::string error;
+  if (!VectorIndexes::instance().save(arg_string(name_arg), &vectors,
+                                      &error)) {
+    set_error(result, error);
+    return;
+  }
+  set_real_result(result, static_cast<double>(vectors));
+}
+
+void vec_index_drop_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                         vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (name_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Call provider's embed method
   std::string error;
-  std::string embedding_json = provider->embed(model, api_key, text, &error);
+  if (!VectorIndexes::instance().drop(arg_string(name_arg), &error)) {
+    set_error(result, error);
+    return;
+  }
+  set_string_result(result, arg_string(name_arg));
+}
 
-  // Handle errors
-  if (!error.empty()) {
-    result->type = VEF_RESULT_ERROR;
-    // Limit error message length to avoid buffer overflow
-    if (error.length() > 255) {
-      error = error.substr(0, 255);
-    }
-    strcpy(result->error_msg, error.c_str());
+void vec_index_stats_impl(vef_context_t* ctx, vef_invalue_t* name_arg,
+                          vef_vdf_result_t* result) {
+  // Validate NULL inputs
+  if (name_arg->is_null) {
+    result->type = VEF_RESULT_NULL;
     return;
   }
 
-  // Return result (JSON array of floats)
-  result->type = VEF_RESULT_VALUE;
-  result->actual_len = embedding_json.length();
+  auto index = find_index(name_arg, result);
+  if (!index) {
+    return;
+  }
+
+  VectorIndex::Stats stats = index->stats();
+  json stats_json = {{"metric", metric_name(stats.options.metric)},
+                     {"dimensions", stats.options.dimensions},
+                     {"m", stats.options.m},
+                     {"ef_construction", stats.options.ef_construction},
+                     {"ef_search", stats.options.ef_search},
+                     {"vectors", stats.vectors},
+                     {"pending", stats.pending},
+                     {"max_level", stats.max_level},
+                     {"bytes", stats.bytes}};
+  set_string_result(result, stats_json.dump());
+}
+
+// =============================================================================
+// AI_CACHE_STATS Implementation
+// =============================================================================
+
+void ai_cache_stats_impl(vef_context_t* ctx, vef_vdf_result_t* result) {
+  ResponseCache::Stats stats = ResponseCache::instance().stats();
+  EmbeddingStore::Stats store_stats = EmbeddingStore::instance().stats();
+
+  json stats_json = {
+      {"enabled", ResponseCache::instance().enabled()},
+      {"hits", stats.hits},
+      {"misses", stats.misses},
+      {"evictions", stats.evictions},
+      {"entries", stats.entries},
+      {"bytes", stats.bytes},
+      {"embedding_store",
+       {{"enabled", EmbeddingStore::instance().enabled()},
+        {"hits", store_stats.hits},
+        {"misses", store_stats.misses},
+        {"records", store_stats.records},
+        {"bytes", store_stats.bytes}}}};
+
+  set_string_result(result, stats_json.dump());
+}
+
+// =============================================================================
+// AI_STATS Implementation
+// =============================================================================
+
+namespace {
+
+json histogram_json(const LatencyHistogram::Summary& summary) {
+  return {{"count", summary.count}, {"mean_ms", summary.mean_ms},
+          {"p50_ms", summary.p50_ms}, {"p90_ms", summary.p90_ms},
+          {"p99_ms", summary.p99_ms}, {"max_ms", summary.max_ms}};
+}
+
+json model_json(const ModelMetrics::Snapshot& snapshot) {
+  return {{"calls", snapshot.calls},
+          {"errors", snapshot.errors},
+          {"cache_hits", snapshot.cache_hits},
+          {"deduplicated", snapshot.deduplicated},
+          {"input_tokens", snapshot.input_tokens},
+          {"output_tokens", snapshot.output_tokens},
+          {"cached_input_tokens", snapshot.cached_input_tokens},
+          {"latency",
+           {{"call", histogram_json(snapshot.call)},
+            {"request", histogram_json(snapshot.request)},
+            {"first_byte", histogram_json(snapshot.first_byte)},
+            {"parse", histogram_json(snapshot.parse)}}}};
+}
+
+std::string stats_json() {
+  ProviderRegistry& registry = ProviderRegistry::instance();
+
+  json providers = json::object();
+  for (size_t i = 0; i < kProviderCount; i++) {
+    auto id = static_cast<ProviderId>(i);
+    RetryStats retries = registry.retry_counters(id).stats();
+    Hedger::Stats hedges = Hedger::instance().stats(id);
+    TransferStats transfer = registry.transfer_counters(id).stats();
+
+    json models = json::object();
+    registry.model_metrics(id).for_each(
+        [&](const std::string& model, const ModelMetrics& metrics) {
+          models[model] = model_json(metrics.snapshot());
+        });
+
+    providers[provider_name(id)] = {
+        {"requests", retries.requests},
+        {"retries", retries.retries},
+        {"retries_exhausted", retries.exhausted},
+        {"retry_time_ms", retries.retry_time_ms},
+        {"hedges", hedges.hedges},
+        {"hedge_wins", hedges.hedge_wins},
+        {"bytes_received", transfer.bytes_received},
+        {"bytes_decoded", transfer.bytes_decoded},
+        {"models", models}};
+  }
+
+  json dns = histogram_json(DnsCache::instance().lookups().summary());
+  return json({{"providers", providers}, {"dns", dns}}).dump();
+}
 
-  // Copy embedding JSON to buffer (truncate if necessary)
-  size_t copy_len =
-      std::min(embedding_json.length(), result->max_str_len - 1);
-  memcpy(result->str_buf, embedding_json.c_str(), copy_len);
-  result->str_buf[copy_len] = '\0';
+}  // namespace
 
-  // If response was truncated, note it
-  if (embedding_json.length() > result->max_str_len - 1) {
-    result->actual_len = copy_len;
+void ai_stats_impl(vef_context_t* ctx, vef_vdf_result_t* result) {
+  set_string_result(result, stats_json());
+}
+
+// =============================================================================
+// AI_STATS_RESET Implementation
+// =============================================================================
+
+void ai_stats_reset_impl(vef_context_t* ctx, vef_vdf_result_t* result) {
+  // Report the counters as they were, so no interval is lost between a
+  // dashboard's read and its reset
+  std::string stats = stats_json();
+
+  ProviderRegistry& registry = ProviderRegistry::instance();
+  for (size_t i = 0; i < kProviderCount; i++) {
+    auto id = static_cast<ProviderId>(i);
+    registry.retry_counters(id).reset();
+    registry.transfer_counters(id).reset();
+    registry.model_metrics(id).reset();
+    Hedger::instance().reset_stats(id);
   }
+  DnsCache::instance().lookups().reset();
+
+  set_string_result(result, stats);
 }
 
 }  // namespace vsql_ai
@@ -211,6 +1666,11 @@ void create_embed_impl(vef_context_t* ctx, vef_invalue_t* provider_arg,
 // Extension Registration
 // =============================================================================
 
+// Build the shared provider instances when the extension library is loaded
+// rather than on the first row of the first query.
+static vsql_ai::ProviderRegistry& provider_registry =
+    vsql_ai::ProviderRegistry::instance();
+
 VEF_GENERATE_ENTRY_POINTS(
     make_extension("vsql_ai", "0.0.1")
         .func(make_func<&vsql_ai::ai_prompt_impl>("ai_prompt")
@@ -222,6 +1682,78 @@ VEF_GENERATE_ENTRY_POINTS(
                   .buffer_size(65535)  // Large buffer for AI responses
                   .build())
 
+        .func(make_func<&vsql_ai::ai_prompt_with_options_impl>(
+                  "ai_prompt_with_options")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // prompt
+                  .param(STRING)  // options (JSON object)
+                  .buffer_size(65535)
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_long_impl>("ai_prompt_long")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // prompt
+                  .param(STRING)  // options (JSON object)
+                  .buffer_size(16777215)  // LONGTEXT-sized answers
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_with_system_impl>(
+                  "ai_prompt_with_system")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // system prompt, cached
+                  .param(STRING)  // prompt
+                  .buffer_size(65535)
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_parallel_impl>(
+                  "ai_prompt_parallel")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // prompts (JSON array)
+                  .buffer_size(16777215)  // Many responses per call
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_batch_submit_impl>(
+                  "ai_prompt_batch_submit")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // prompts (JSON array or object)
+                  .param(STRING)  // options (JSON object)
+                  .buffer_size(256)  // Batch id
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_batch_status_impl>(
+                  "ai_prompt_batch_status")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // api_key
+                  .param(STRING)  // batch_id
+                  .buffer_size(65535)
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_prompt_batch_result_impl>(
+                  "ai_prompt_batch_result")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // api_key
+                  .param(STRING)  // batch_id
+                  .param(STRING)  // custom_id
+                  .buffer_size(65535)
+                  .build())
+
         .func(make_func<&vsql_ai::create_embed_impl>("create_embed")
                   .returns(STRING)
                   .param(STRING)  // provider
@@ -229,4 +1761,114 @@ VEF_GENERATE_ENTRY_POINTS(
                   .param(STRING)  // api_key
                   .param(STRING)  // text
                   .buffer_size(65535)
+                  .build())
+
+        .func(make_func<&vsql_ai::create_embed_binary_impl>(
+                  "create_embed_binary")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // text
+                  .param(STRING)  // format: float32, float16 or int8
+                  .buffer_size(65535)
+                  .build())
+
+        .func(make_func<&vsql_ai::create_embed_batch_impl>(
+                  "create_embed_batch")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // texts (JSON array)
+                  .buffer_size(16777215)  // Many embeddings per call
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_chunk_impl>("ai_chunk")
+                  .returns(STRING)
+                  .param(STRING)  // text
+                  .param(STRING)  // max_tokens (integer)
+                  .param(STRING)  // overlap (integer)
+                  .buffer_size(16777215)  // As large as the text and more
+                  .build())
+
+        .func(make_func<&vsql_ai::create_embed_chunks_impl>(
+                  "create_embed_chunks")
+                  .returns(STRING)
+                  .param(STRING)  // provider
+                  .param(STRING)  // model
+                  .param(STRING)  // api_key
+                  .param(STRING)  // text
+                  .param(STRING)  // options (JSON object)
+                  .buffer_size(16777215)  // Many embeddings per call
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_cosine_impl>("vec_cosine")
+                  .returns(REAL)
+                  .param(STRING)  // vector a (JSON or packed float32)
+                  .param(STRING)  // vector b
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_dot_impl>("vec_dot")
+                  .returns(REAL)
+                  .param(STRING)  // vector a (JSON or packed float32)
+                  .param(STRING)  // vector b
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_l2_impl>("vec_l2")
+                  .returns(REAL)
+                  .param(STRING)  // vector a (JSON or packed float32)
+                  .param(STRING)  // vector b
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_index_create_impl>("vec_index_create")
+                  .returns(STRING)
+                  .param(STRING)  // name
+                  .param(STRING)  // options (JSON object)
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_index_add_impl>("vec_index_add")
+                  .returns(REAL)
+                  .param(STRING)  // name
+                  .param(STRING)  // id (integer)
+                  .param(STRING)  // vector (JSON or packed float32)
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_knn_impl>("vec_knn")
+                  .returns(STRING)
+                  .param(STRING)  // name
+                  .param(STRING)  // query vector (JSON or packed float32)
+                  .param(STRING)  // k (integer)
+                  .buffer_size(65535)  // Up to 1000 neighbors
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_index_save_impl>("vec_index_save")
+                  .returns(REAL)
+                  .param(STRING)  // name
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_index_drop_impl>("vec_index_drop")
+                  .returns(STRING)
+                  .param(STRING)  // name
+                  .build())
+
+        .func(make_func<&vsql_ai::vec_index_stats_impl>("vec_index_stats")
+                  .returns(STRING)
+                  .param(STRING)  // name
+                  .buffer_size(1024)
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_cache_stats_impl>("ai_cache_stats")
+                  .returns(STRING)
+                  .buffer_size(1024)
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_stats_impl>("ai_stats")
+                  .returns(STRING)
+                  .buffer_size(65535)  // Grows with the models seen
+                  .build())
+
+        .func(make_func<&vsql_ai::ai_stats_reset_impl>("ai_stats_reset")
+                  .returns(STRING)
+                  .buffer_size(65535)
                   .build()))
@@ -16,87 +16,635 @@
 
 #include "ai_providers.h"
 
-#include "http_client.h"
-#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <thread>
 
-using json = nlohmann::json;
+#include "ascii_util.h"
+#include "call_context.h"
+#include "config.h"
+#include "embedding_store.h"
+#include "hash_util.h"
+#include "hedging.h"
+#include "http_client.h"
+#include "json_extract.h"
+#include "json_writer.h"
+#include "rate_limiter.h"
+#include "response_cache.h"
+#include "single_flight.h"
+#include "sse_parser.h"
+#include "static_embedding.h"
+#include "worker_pool.h"
 
 namespace vsql_ai {
 
+namespace {
+
+const char* base_url(ProviderId id) {
+  switch (id) {
+    case ProviderId::kAnthropic:
+      return "https://api.anthropic.com";
+    case ProviderId::kGoogle:
+      return "https://generativelanguage.googleapis.com";
+    case ProviderId::kLocal:
+      return "";
+  }
+  return "";
+}
+
+// Requests one SQL call keeps in flight to a provider unless overridden
+constexpr long kDefaultMaxConcurrency = 8;
+
+// Output limit supported by every current Anthropic and Gemini text model
+constexpr long kDefaultMaxTokens = 8192;
+
+// Generated text averages about four bytes per token, so asking for more than
+// max_length / 4 tokens mostly buys text that would be truncated anyway
+constexpr size_t kBytesPerToken = 4;
+
+long resolve_max_tokens(ProviderId id, const PromptOptions& options,
+                        size_t max_length) {
+  if (options.max_tokens) {
+    return *options.max_tokens;
+  }
+  long fit =
+      static_cast<long>(std::max<size_t>(1, max_length / kBytesPerToken));
+  return std::min(fit, ProviderRegistry::instance().settings(id).max_tokens);
+}
+
+// Build an error message for a non-2xx response, preferring the API's own
+// error.message when the body carries one.
+std::string http_error_message(const HttpClient::Response& response) {
+  ApiError api_error;
+  std::string parse_error;
+  if (extract_api_error(response.body, &api_error, &parse_error) &&
+      !api_error.message.empty()) {
+    return api_error.message;
+  }
+  return "HTTP " + std::to_string(response.status_code) + " - " +
+         response.body.substr(0, 100);
+}
+
+// Ceiling for the adaptive number of requests in flight per API key, across
+// all sessions
+constexpr long kDefaultMaxInFlight = 64;
+
+// Retry defaults: up to 4 attempts for 5xx and network errors, backing off
+// from 0.5s up to 20s, all within one minute
+constexpr long kDefaultRetryMaxAttempts = 4;
+constexpr long kDefaultRetryBaseDelayMs = 500;
+constexpr long kDefaultRetryMaxDelayMs = 20000;
+constexpr long kDefaultRetryDeadline = 60;
+
+// Seconds one attempt may wait to connect, or between bytes once connected
+constexpr long kDefaultRequestTimeout = 30;
+
+// Read what a response says about the caller's quota
+RateLimiter::Feedback rate_limit_feedback(
+    const HttpClient::Response& response) {
+  RateLimiter::Feedback feedback;
+  feedback.throttled = response.status_code == 429;
+
+  // retry-after in (possibly fractional) seconds; HTTP dates are not used by
+  // either provider
+  std::string retry_after = response.header("retry-after");
+  if (!retry_after.empty()) {
+    double seconds = std::strtod(retry_after.c_str(), nullptr);
+    if (seconds > 0) {
+      feedback.retry_after =
+          std::chrono::milliseconds(static_cast<long>(seconds * 1000));
+    }
+  }
+
+  // Anthropic advertises its per-minute request limit on every response
+  std::string limit = response.header("anthropic-ratelimit-requests-limit");
+  if (!limit.empty()) {
+    feedback.requests_per_minute = std::strtod(limit.c_str(), nullptr);
+  }
+  return feedback;
+}
+
+// Count one HTTP exchange in the provider's and the model's statistics
+void record_exchange(ProviderId id, ModelMetrics* metrics,
+                     const HttpClient::Response& response,
+                     std::chrono::steady_clock::duration elapsed) {
+  ProviderRegistry::instance().transfer_counters(id).record(response);
+  metrics->request().record(elapsed);
+  if (response.status_code != 0) {
+    metrics->first_byte().record(response.first_byte);
+  }
+}
+
+// Records a provider call in its model's metrics when it goes out of scope.
+// The call counts as failed if *error is set by then.
+class CallRecorder {
+ public:
+  CallRecorder(ModelMetrics* metrics, const std::string* error)
+      : metrics_(metrics),
+        error_(error),
+        start_(std::chrono::steady_clock::now()) {}
+
+  ~CallRecorder() {
+    metrics_->record_call(std::chrono::steady_clock::now() - start_,
+                          !error_->empty());
+  }
+
+ private:
+  ModelMetrics* metrics_;
+  const std::string* error_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// What identical prompts in flight share
+struct PromptAnswer {
+  std::string text;
+  bool truncated = false;
+};
+
+// A prompt with an explicit positive temperature asks for a new sample on
+// every call, so its answer is neither cached nor shared
+bool reusable_answer(const PromptOptions& options) {
+  return !options.temperature || *options.temperature <= 0;
+}
+
+// Identical calls in flight at the same time share one request, unless
+// VSQL_AI_SINGLE_FLIGHT is 0 or the answer is not reusable
+SingleFlight<PromptAnswer>& prompt_flights(const PromptOptions& options) {
+  static SingleFlight<PromptAnswer> flights(config_int("SINGLE_FLIGHT", 1) !=
+                                            0);
+  static SingleFlight<PromptAnswer> unshared(false);
+  return reusable_answer(options) ? flights : unshared;
+}
+
+SingleFlight<std::vector<float>>& embedding_flights() {
+  static SingleFlight<std::vector<float>> flights(
+      config_int("SINGLE_FLIGHT", 1) != 0);
+  return flights;
+}
+
+// A request that got no response because its SQL call was cancelled or ran
+// out of time reports that, rather than the aborted socket's error
+void report_call_end(CallContext* call, HttpClient::Response* response) {
+  if (call && response->status_code == 0 && call->cancelled()) {
+    response->error = call->cancel_reason();
+    response->transient = false;
+  }
+}
+
+int request_timeout(ProviderId id) {
+  return ProviderRegistry::instance().settings(id).request_timeout;
+}
+
+// Send a request, retrying transient failures. Every attempt goes through
+// the rate limiter shared by all sessions using this provider and API key.
+// A 429 waits as long as the server asks, paced by the limiter; other
+// retryable failures back off with full jitter, up to max_attempts. Either
+// way the whole exchange stays within the policy's deadline, and within the
+// SQL call's if that is sooner. Once control or the call is cancelled no
+// further attempt is made.
+HttpClient::Response send_with_retries(
+    ProviderId id, std::string_view api_key,
+    const std::function<HttpClient::Response()>& send, ModelMetrics* metrics,
+    HttpClient::RequestControl* control = nullptr) {
+  ProviderRegistry& registry = ProviderRegistry::instance();
+  const ProviderSettings& settings = registry.settings(id);
+  const RetryPolicy& policy = settings.retry;
+  RateLimiter& limiter = RateLimiter::instance();
+  uint64_t key = RateLimiter::make_key(provider_name(id), api_key);
+
+  auto start = RateLimiter::Clock::now();
+  auto deadline = start + policy.deadline;
+  auto last_attempt = start;
+
+  // Cancelling the call wakes a backoff wait at once
+  CallContext* call = CallContext::current();
+  HttpClient::RequestControl call_control;
+  if (call) {
+    deadline = std::min(deadline, call->deadline());
+    if (!control) {
+      control = &call_control;
+    }
+  }
+  CallContext::Link link(call, control);
+  int attempts = 0;
+  int failures = 0;  // retryable failures other than 429
+
+  HttpClient::Response response;
+  response.status_code = 0;
+  while (true) {
+    if (call && call->cancelled()) {
+      break;
+    }
+    if (!limiter.acquire(key, settings.rate_limits, deadline)) {
+      // Report the last failure if there was one, so the API's message
+      // comes through
+      if (attempts == 0) {
+        response.error = std::string("Timed out waiting for the ") +
+                         provider_name(id) + " rate limit";
+      }
+      break;
+    }
+
+    last_attempt = RateLimiter::Clock::now();
+    attempts++;
+    response = send();
+    record_exchange(id, metrics, response,
+                    RateLimiter::Clock::now() - last_attempt);
+    RateLimiter::Feedback feedback = rate_limit_feedback(response);
+    limiter.release(key, feedback);
+
+    bool retryable = response.transient ||
+                     RetryPolicy::retryable_status(response.status_code);
+    if (!retryable) {
+      registry.retry_counters(id).record(attempts, false, last_attempt - start);
+      report_call_end(call, &response);
+      return response;
+    }
+    if (control && control->cancelled()) {
+      break;
+    }
+    if (feedback.throttled) {
+      continue;  // the limiter holds the next attempt back
+    }
+
+    failures++;
+    if (failures >= policy.max_attempts) {
+      break;
+    }
+    auto delay = std::max<std::chrono::milliseconds>(policy.backoff(failures),
+                                                     feedback.retry_after);
+    if (RateLimiter::Clock::now() + delay >= deadline) {
+      break;
+    }
+    if (control) {
+      if (!control->wait_for(delay)) {
+        break;
+      }
+    } else {
+      std::this_thread::sleep_for(delay);
+    }
+  }
+
+  registry.retry_counters(id).record(attempts, true, last_attempt - start);
+  report_call_end(call, &response);
+  return response;
+}
+
+// Parses one streamed event: appends its text and takes its token counts, or
+// sets the error and returns false
+using StreamEventParser =
+    std::function<bool(std::string_view data, std::string* text,
+                       TokenUsage* usage, std::string* error)>;
+
+// What post_streaming_prompt() read from the stream
+struct StreamResult {
+  std::string text;
+  bool truncated = false;  // abandoned with more than max_length bytes
+  std::string stream_error;
+  TokenUsage usage;
+  std::chrono::steady_clock::duration parse_time{};
+};
+
+// Send a hedged duplicate: a single attempt, and only if the rate limiter
+// has room right now. A duplicate never waits or retries.
+HttpClient::Response send_hedge(
+    ProviderId id, std::string_view api_key,
+    const std::function<HttpClient::Response()>& send, ModelMetrics* metrics) {
+  ProviderRegistry& registry = ProviderRegistry::instance();
+  const ProviderSettings& settings = registry.settings(id);
+  RateLimiter& limiter = RateLimiter::instance();
+  uint64_t key = RateLimiter::make_key(provider_name(id), api_key);
+
+  if (!limiter.acquire(key, settings.rate_limits, RateLimiter::Clock::now())) {
+    HttpClient::Response response;
+    response.status_code = 0;
+    response.error = "Rate limit reached";
+    return response;
+  }
+  auto sent_at = RateLimiter::Clock::now();
+  HttpClient::Response response = send();
+  record_exchange(id, metrics, response, RateLimiter::Clock::now() - sent_at);
+  limiter.release(key, rate_limit_feedback(response));
+  return response;
+}
+
+// Post a streaming prompt request and accumulate the text of its events into
+// result->text. The request is abandoned, and result->truncated set, once
+// more than max_length bytes have arrived, so a long answer never has to be
+// held in full. Errors reported inside the
+// stream go to result->stream_error. With hedging enabled, a stalled request
+// may be raced against a duplicate; each writes to its own output.
+HttpClient::Response post_streaming_prompt(
+    ProviderId id, std::string_view api_key,
+    const HttpClient::Endpoint& endpoint, const std::string& path,
+    const std::string& body, const std::map<std::string, std::string>& headers,
+    size_t max_length, const StreamEventParser& parse_event,
+    ModelMetrics* metrics, StreamResult* result) {
+  StreamResult outputs[2];
+
+  auto attempt = [&](HttpClient::RequestControl* control, int slot) {
+    StreamResult& output = outputs[slot];
+    HttpClient client;
+    auto send = [&] {
+      // Start over on every attempt; a retried stream may have delivered
+      // part of its text before failing
+      output.text.clear();
+      output.truncated = false;
+      output.stream_error.clear();
+      output.usage = TokenUsage();
+      output.parse_time = {};
+      SseParser parser([&](std::string_view event, std::string_view data) {
+        auto parse_start = std::chrono::steady_clock::now();
+        bool more = parse_event(data, &output.text, &output.usage,
+                                &output.stream_error);
+        output.parse_time += std::chrono::steady_clock::now() - parse_start;
+        // An answer of exactly max_length bytes is still returned whole
+        if (more && output.text.size() > max_length) {
+          output.truncated = true;
+          return false;
+        }
+        return more;
+      });
+      return client.post_stream(
+          endpoint, path, body, headers, request_timeout(id),
+          [&](const char* data, size_t length) {
+            return parser.feed(data, length);
+          },
+          control);
+    };
+    return slot == 0 ? send_with_retries(id, api_key, send, metrics, control)
+                     : send_hedge(id, api_key, send, metrics);
+  };
+
+  int slot = 0;
+  HttpClient::Response response = Hedger::instance().send(id, attempt, &slot);
+  *result = std::move(outputs[slot]);
+  metrics->parse().record(result->parse_time);
+  metrics->record_usage(result->usage);
+  return response;
+}
+
+// Message for an "error" object in a response or streamed event
+std::string api_error_message(const ApiError& api_error) {
+  return api_error.message.empty() ? "Unknown API error"
+                                   : api_error.message;
+}
+
+}  // namespace
+
+// =============================================================================
+// AIProvider Implementation
+// =============================================================================
+
+std::vector<std::vector<float>> AIProvider::embed_batch(
+    std::string_view model, std::string_view api_key,
+    const std::vector<std::string>& texts, std::string* error) {
+  std::vector<std::vector<float>> embeddings;
+  embeddings.reserve(texts.size());
+  for (const auto& text : texts) {
+    embeddings.push_back(embed(model, api_key, text, error));
+    if (!error->empty()) {
+      return {};
+    }
+  }
+  return embeddings;
+}
+
+bool AIProvider::create_batch(std::string_view model, std::string_view api_key,
+                              const std::vector<std::string>& custom_ids,
+                              const std::vector<std::string>& prompts,
+                              const PromptOptions& options,
+                              MessageBatch* batch, std::string* error) {
+  *error = std::string("Message batches not supported for ") +
+           provider_name(id()) + " provider";
+  return false;
+}
+
+bool AIProvider::get_batch(std::string_view model, std::string_view api_key,
+                           std::string_view batch_id, MessageBatch* batch,
+                           std::string* error) {
+  *error = std::string("Message batches not supported for ") +
+           provider_name(id()) + " provider";
+  return false;
+}
+
+bool AIProvider::get_batch_results(std::string_view model,
+                                   std::string_view api_key,
+                                   std::string_view batch_id,
+                                   const BatchResultHandler& on_result,
+                                   std::string* error) {
+  *error = std::string("Message batches not supported for ") +
+           provider_name(id()) + " provider";
+  return false;
+}
+
 // =============================================================================
 // AnthropicProvider Implementation
 // =============================================================================
 
+namespace {
+
+// Batch ids go into request paths, so only the characters the API uses
+// ("msgbatch_...") are accepted
+bool valid_batch_id(std::string_view batch_id) {
+  if (batch_id.empty() || batch_id.size() > 128) {
+    return false;
+  }
+  for (char c : batch_id) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read a batch object from a create or poll response
+bool read_message_batch(const HttpClient::Response& response,
+                        MessageBatch* batch, std::string* error) {
+  if (!response.error.empty()) {
+    *error = response.error;
+    return false;
+  }
+  if (!response.is_success()) {
+    *error = http_error_message(response);
+    return false;
+  }
+  ApiError api_error;
+  if (!extract_message_batch(response.body, batch, &api_error, error)) {
+    return false;
+  }
+  if (api_error.present) {
+    *error = api_error_message(api_error);
+    return false;
+  }
+  if (batch->id.empty() || batch->processing_status.empty()) {
+    *error = "Unexpected message batch response";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
 AnthropicProvider::AnthropicProvider() {}
 
 AnthropicProvider::~AnthropicProvider() {}
 
-std::string AnthropicProvider::get_endpoint() const {
-  return "https://api.anthropic.com";
+const HttpClient::Endpoint& AnthropicProvider::get_endpoint() const {
+  return ProviderRegistry::instance().settings(id()).endpoint;
 }
 
 std::map<std::string, std::string> AnthropicProvider::get_headers(
-    const std::string& api_key) const {
-  return {{"x-api-key", api_key},
+    std::string_view api_key) const {
+  return {{"x-api-key", std::string(api_key)},
           {"anthropic-version", "2023-06-01"},
           {"content-type", "application/json"}};
 }
 
-std::string AnthropicProvider::build_request_body(
-    const std::string& model, const std::string& prompt) const {
-  json request = {{"model", model},
-                  {"max_tokens", 1024},
-                  {"messages", json::array({json::object({{"role", "user"},
-                                                          {"content", prompt}})})}};
-
-  return request.dump();
+void AnthropicProvider::build_request_body(std::string_view model,
+                                           std::string_view prompt,
+                                           const PromptOptions& options,
+                                           long max_tokens,
+                                           std::string* body) const {
+  JsonWriter writer(body);
+  write_message_params(&writer, model, prompt, options, max_tokens, true);
 }
 
-std::string AnthropicProvider::parse_response(const std::string& response_json,
-                                               std::string* error) const {
-  try {
-    auto response = json::parse(response_json);
+void AnthropicProvider::write_message_params(JsonWriter* writer,
+                                             std::string_view model,
+                                             std::string_view prompt,
+                                             const PromptOptions& options,
+                                             long max_tokens,
+                                             bool stream) const {
+  writer->begin_object()
+      .key("model").string(model)
+      .key("max_tokens").integer(max_tokens);
+  if (stream) {
+    writer->key("stream").boolean(true);
+  }
 
-    // Check for API error
-    if (response.contains("error")) {
-      if (response["error"].contains("message")) {
-        *error = response["error"]["message"].get<std::string>();
-      } else {
-        *error = response["error"].dump();
-      }
-      return "";
+  if (!options.system.empty()) {
+    writer->key("system");
+    if (options.cache_system) {
+      // A block marked with cache_control ends a cached prefix: requests
+      // repeating it within five minutes read it from the cache. Prefixes
+      // under the model's minimum (1024 or 2048 tokens) are not cached.
+      writer->begin_array()
+          .begin_object()
+          .key("type").string("text")
+          .key("text").string(options.system)
+          .key("cache_control").begin_object()
+          .key("type").string("ephemeral")
+          .end_object()
+          .end_object()
+          .end_array();
+    } else {
+      writer->string(options.system);
     }
-
-    // Extract response text
-    if (response.contains("content") && response["content"].is_array() &&
-        !response["content"].empty()) {
-      const auto& first_content = response["content"][0];
-      if (first_content.contains("text")) {
-        return first_content["text"].get<std::string>();
-      }
+  }
+  if (options.temperature) {
+    writer->key("temperature").number(*options.temperature);
+  }
+  if (!options.stop_sequences.empty()) {
+    writer->key("stop_sequences").begin_array();
+    for (const auto& sequence : options.stop_sequences) {
+      writer->string(sequence);
     }
+    writer->end_array();
+  }
 
-    *error = "Invalid response format: missing content";
-    return "";
+  writer->key("messages").begin_array()
+      .begin_object()
+      .key("role").string("user")
+      .key("content").string(prompt)
+      .end_object()
+      .end_array();
+  writer->end_object();
+}
 
-  } catch (const json::exception& e) {
-    *error = std::string("JSON parse error: ") + e.what();
-    return "";
+bool AnthropicProvider::parse_stream_event(std::string_view data,
+                                           std::string* text,
+                                           TokenUsage* usage,
+                                           std::string* error) const {
+  AnthropicStreamEvent event;
+  if (!extract_anthropic_event(data, &event, usage, error)) {
+    return false;
   }
+
+  if (event.type == "content_block_delta") {
+    if (event.delta_type == "text_delta") {
+      *text += event.delta_text;
+    }
+  } else if (event.type == "error") {
+    *error = api_error_message(event.error);
+    return false;
+  }
+  // message_start, content_block_start/stop, message_delta, message_stop
+  // and ping carry no text
+  return true;
 }
 
-std::string AnthropicProvider::prompt(const std::string& model,
-                                      const std::string& api_key,
-                                      const std::string& prompt_text,
+std::string AnthropicProvider::prompt(std::string_view model,
+                                      std::string_view api_key,
+                                      std::string_view prompt_text,
+                                      const PromptOptions& options,
+                                      size_t max_length, bool* truncated,
                                       std::string* error) {
-  // Build request
-  std::string request_body = build_request_body(model, prompt_text);
+  // Build request into a per-thread buffer, reused row after row
+  thread_local std::string request_body;
+  request_body.clear();
+  build_request_body(model, prompt_text, options,
+                     resolve_max_tokens(id(), options, max_length),
+                     &request_body);
+
+  // Serve repeated prompts from the response cache
+  ResponseCache& cache = ResponseCache::instance();
+  uint64_t cache_key = ResponseCache::make_key(provider_name(id()), model,
+                                               api_key, request_body);
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  bool reusable = reusable_answer(options);
+  std::string cached;
+  if (reusable && cache.get(cache_key, &cached)) {
+    metrics.record_cache_hit();
+    // The answer is complete, but a caller with a smaller limit and the
+    // same explicit max_tokens cannot take all of it
+    if (truncated) {
+      *truncated = cached.size() > max_length;
+    }
+    return cached;
+  }
+
+  // The same prompt may already be in flight, e.g. from another session
+  // running the same query; if so, share its answer. The length limit is
+  // part of the key since the answer is cut to it.
+  auto flight = prompt_flights(options).join(
+      hash_combine(cache_key, max_length), error);
+  if (!flight.leader()) {
+    metrics.record_deduplicated();
+    PromptAnswer answer = flight.wait(error);
+    if (truncated) {
+      *truncated = answer.truncated;
+    }
+    return std::move(answer.text);
+  }
+  CallRecorder recorder(&metrics, error);
+
   auto headers = get_headers(api_key);
 
-  // Make HTTP request
-  HttpClient client;
-  auto response = client.post(get_endpoint(), "/v1/messages", request_body,
-                              headers, 30);
+  // Make HTTP request, reading the text as it streams in
+  StreamResult result;
+  auto response = post_streaming_prompt(
+      id(), api_key, get_endpoint(), "/v1/messages", request_body, headers,
+      max_length,
+      [this](std::string_view data, std::string* text, TokenUsage* usage,
+             std::string* error) {
+        return parse_stream_event(data, text, usage, error);
+      },
+      &metrics, &result);
 
   // Check for network errors
   if (!response.error.empty()) {
@@ -106,115 +654,501 @@ std::string AnthropicProvider::prompt(const std::string& model,
 
   // Check HTTP status
   if (!response.is_success()) {
-    // Try to extract error message from response body
-    std::string api_error;
-    std::string parsed_response =
-        parse_response(response.body, &api_error);
+    *error = http_error_message(response);
+    return "";
+  }
 
-    if (!api_error.empty()) {
-      *error = api_error;
-    } else {
-      *error = "HTTP " + std::to_string(response.status_code) +
-               " - " + response.body.substr(0, 100);
-    }
+  // Check for an error reported mid-stream (e.g. overloaded_error)
+  if (!result.stream_error.empty()) {
+    *error = result.stream_error;
     return "";
   }
 
-  // Parse successful response
-  return parse_response(response.body, error);
+  // A response cut short at max_length is not cached
+  if (reusable && !result.truncated) {
+    cache.put(cache_key, result.text);
+  }
+  if (truncated) {
+    *truncated = result.truncated;
+  }
+  PromptAnswer answer{std::move(result.text), result.truncated};
+  flight.publish(answer);
+  return std::move(answer.text);
 }
 
-std::string AnthropicProvider::embed(const std::string& model,
-                                     const std::string& api_key,
-                                     const std::string& text,
-                                     std::string* error) {
+std::vector<float> AnthropicProvider::embed(std::string_view model,
+                                            std::string_view api_key,
+                                            std::string_view text,
+                                            std::string* error) {
   // Anthropic doesn't have a native embeddings API yet
   *error = "Embeddings not supported for Anthropic provider";
-  return "";
+  return {};
+}
+
+bool AnthropicProvider::create_batch(std::string_view model,
+                                     std::string_view api_key,
+                                     const std::vector<std::string>& custom_ids,
+                                     const std::vector<std::string>& prompts,
+                                     const PromptOptions& options,
+                                     MessageBatch* batch, std::string* error) {
+  if (prompts.empty() || prompts.size() > kMaxBatchSize ||
+      custom_ids.size() != prompts.size()) {
+    *error = "A message batch takes 1 to " + std::to_string(kMaxBatchSize) +
+             " prompts";
+    return false;
+  }
+
+  // Nobody waits on a batched answer with a result buffer to fill, so the
+  // default is the configured cap
+  long max_tokens =
+      options.max_tokens
+          ? *options.max_tokens
+          : ProviderRegistry::instance().settings(id()).max_tokens;
+
+  std::string body;
+  JsonWriter writer(&body);
+  writer.begin_object().key("requests").begin_array();
+  for (size_t i = 0; i < prompts.size(); i++) {
+    writer.begin_object().key("custom_id").string(custom_ids[i]).key("params");
+    write_message_params(&writer, model, prompts[i], options, max_tokens,
+                         false);
+    writer.end_object();
+  }
+  writer.end_array().end_object();
+
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  CallRecorder recorder(&metrics, error);
+
+  HttpClient client;
+  auto headers = get_headers(api_key);
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        return client.post(get_endpoint(), "/v1/messages/batches", body,
+                           headers, request_timeout(id()));
+      },
+      &metrics);
+  return read_message_batch(response, batch, error);
+}
+
+bool AnthropicProvider::get_batch(std::string_view model,
+                                  std::string_view api_key,
+                                  std::string_view batch_id,
+                                  MessageBatch* batch, std::string* error) {
+  if (!valid_batch_id(batch_id)) {
+    *error = "Invalid batch id";
+    return false;
+  }
+
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  HttpClient client;
+  auto headers = get_headers(api_key);
+  std::string path = "/v1/messages/batches/" + std::string(batch_id);
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        return client.get(get_endpoint(), path, headers, request_timeout(id()));
+      },
+      &metrics);
+  return read_message_batch(response, batch, error);
+}
+
+bool AnthropicProvider::get_batch_results(std::string_view model,
+                                          std::string_view api_key,
+                                          std::string_view batch_id,
+                                          const BatchResultHandler& on_result,
+                                          std::string* error) {
+  if (!valid_batch_id(batch_id)) {
+    *error = "Invalid batch id";
+    return false;
+  }
+
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  HttpClient client;
+  auto headers = get_headers(api_key);
+  // The batch's results_url points here too; building it from the
+  // endpoint keeps VSQL_AI_ANTHROPIC_BASE_URL in effect
+  std::string path =
+      "/v1/messages/batches/" + std::string(batch_id) + "/results";
+
+  // Results are JSON Lines, one per prompt, and can run to many megabytes;
+  // each line is handed on as soon as it is complete. A retried download
+  // starts over, so the caller must tolerate seeing a result twice.
+  std::string line;
+  std::string parse_error;
+  TokenUsage usage;
+  std::chrono::steady_clock::duration parse_time{};
+  auto take_line = [&] {
+    if (line.find_first_not_of(" \r\t") == std::string::npos) {
+      return true;
+    }
+    auto parse_start = std::chrono::steady_clock::now();
+    MessageBatchResult result;
+    bool parsed = extract_message_batch_result(line, &result, &parse_error);
+    parse_time += std::chrono::steady_clock::now() - parse_start;
+    if (!parsed) {
+      return false;
+    }
+    usage.input_tokens += result.usage.input_tokens;
+    usage.output_tokens += result.usage.output_tokens;
+    usage.cached_input_tokens += result.usage.cached_input_tokens;
+    on_result(result);
+    return true;
+  };
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        line.clear();
+        usage = TokenUsage();
+        parse_time = {};
+        return client.get_stream(
+            get_endpoint(), path, headers, request_timeout(id()),
+            [&](const char* data, size_t length) {
+              std::string_view chunk(data, length);
+              while (!chunk.empty()) {
+                size_t newline = chunk.find('\n');
+                line.append(chunk.substr(0, newline));
+                if (newline == std::string_view::npos) {
+                  break;
+                }
+                chunk.remove_prefix(newline + 1);
+                if (!take_line()) {
+                  return false;
+                }
+                line.clear();
+              }
+              return true;
+            });
+      },
+      &metrics);
+
+  if (!response.error.empty()) {
+    *error = response.error;
+    return false;
+  }
+  if (!response.is_success()) {
+    *error = http_error_message(response);
+    return false;
+  }
+  // The last line need not end in a newline
+  if (parse_error.empty()) {
+    take_line();
+  }
+  if (!parse_error.empty()) {
+    *error = parse_error;
+    return false;
+  }
+  metrics.parse().record(parse_time);
+  metrics.record_usage(usage);
+  return true;
 }
 
 // =============================================================================
 // GoogleProvider Implementation
 // =============================================================================
 
-GoogleProvider::GoogleProvider() {}
+namespace {
+
+// Path of a per-model endpoint, e.g. /v1beta/models/<model>:embedContent
+std::string model_path(std::string_view model, std::string_view method) {
+  std::string path = "/v1beta/models/";
+  path.append(model).append(method);
+  return path;
+}
+
+// Write {"parts":[{"text":text}]}, the Content object of the Gemini API
+void write_content(JsonWriter* writer, std::string_view text) {
+  writer->begin_object()
+      .key("parts").begin_array()
+      .begin_object().key("text").string(text).end_object()
+      .end_array()
+      .end_object();
+}
+
+// Cached content is billed per hour of storage, so it is kept only as long
+// as a batch of rows is likely to keep using it
+constexpr long kDefaultContextCacheTtl = 300;
+
+// Distinct system prompts with cached content at once, per process
+constexpr size_t kMaxCachedContents = 256;
+
+// Cached content belongs to the API key's project and holds one model's
+// processed prefix
+uint64_t cached_content_key(std::string_view model, std::string_view api_key,
+                            std::string_view system) {
+  std::hash<std::string_view> hasher;
+  uint64_t key = hasher(system);
+  key = hash_combine(key, hasher(model));
+  key = hash_combine(key, hasher(api_key));
+  return key;
+}
+
+// Whether a failed prompt was refused because the cached content it named
+// is gone: deleted, expired early, or not visible to the API key. Gemini
+// then answers 404 NOT_FOUND or 403 PERMISSION_DENIED about the
+// cachedContents resource; any other failure is the prompt's own.
+bool cached_content_rejected(const HttpClient::Response& response,
+                             std::string_view content_name) {
+  if (response.status_code != 404 && response.status_code != 403) {
+    return false;
+  }
+  return response.body.find(content_name) != std::string::npos ||
+         find_ignore_case(response.body, "cachedcontent") !=
+             std::string_view::npos;
+}
+
+}  // namespace
+
+GoogleProvider::GoogleProvider()
+    : context_cache_ttl_(std::max(60L, config_int("GOOGLE_CONTEXT_CACHE_TTL",
+                                                  kDefaultContextCacheTtl))) {}
 
 GoogleProvider::~GoogleProvider() {}
 
-std::string GoogleProvider::get_endpoint(const std::string& model) const {
-  return "https://generativelanguage.googleapis.com";
+const HttpClient::Endpoint& GoogleProvider::get_endpoint(
+    std::string_view model) const {
+  return ProviderRegistry::instance().settings(id()).endpoint;
 }
 
 std::map<std::string, std::string> GoogleProvider::get_headers(
-    const std::string& api_key) const {
-  return {{"x-goog-api-key", api_key}, {"content-type", "application/json"}};
+    std::string_view api_key) const {
+  return {{"x-goog-api-key", std::string(api_key)},
+          {"content-type", "application/json"}};
 }
 
-std::string GoogleProvider::build_request_body(
-    const std::string& prompt) const {
-  json request = {
-      {"contents",
-       json::array({json::object({{"parts", json::array({json::object(
-                                                {{"text", prompt}})})}})})}};
+void GoogleProvider::build_request_body(std::string_view prompt,
+                                        const PromptOptions& options,
+                                        long max_tokens,
+                                        std::string_view cached_content,
+                                        std::string* body) const {
+  JsonWriter writer(body);
+  writer.begin_object();
+  writer.key("contents").begin_array();
+  write_content(&writer, prompt);
+  writer.end_array();
 
-  return request.dump();
+  writer.key("generationConfig").begin_object()
+      .key("maxOutputTokens").integer(max_tokens);
+  if (options.temperature) {
+    writer.key("temperature").number(*options.temperature);
+  }
+  if (!options.stop_sequences.empty()) {
+    writer.key("stopSequences").begin_array();
+    for (const auto& sequence : options.stop_sequences) {
+      writer.string(sequence);
+    }
+    writer.end_array();
+  }
+  writer.end_object();
+
+  if (!cached_content.empty()) {
+    writer.key("cachedContent").string(cached_content);
+  } else if (!options.system.empty()) {
+    writer.key("systemInstruction");
+    write_content(&writer, options.system);
+  }
+  writer.end_object();
 }
 
-std::string GoogleProvider::parse_response(const std::string& response_json,
-                                            std::string* error) const {
-  try {
-    auto response = json::parse(response_json);
+std::string GoogleProvider::cached_content(std::string_view model,
+                                           std::string_view api_key,
+                                           std::string_view system,
+                                           uint64_t key,
+                                           ModelMetrics* metrics) {
+  auto valid = [&](std::string* name) {
+    std::lock_guard<std::mutex> lock(cached_contents_mutex_);
+    auto found = cached_contents_.find(key);
+    if (found == cached_contents_.end() ||
+        std::chrono::steady_clock::now() >= found->second.expires) {
+      return false;
+    }
+    *name = found->second.name;
+    return true;
+  };
 
-    // Check for API error
-    if (response.contains("error")) {
-      if (response["error"].contains("message")) {
-        *error = response["error"]["message"].get<std::string>();
-      } else {
-        *error = response["error"].dump();
-      }
-      return "";
+  std::string name;
+  if (valid(&name)) {
+    return name;
+  }
+  std::string ignored;
+  auto flight = cached_content_flights_.join(key, &ignored);
+  if (!flight.leader()) {
+    return flight.wait(&ignored);
+  }
+  // Another leader may have created it since the first look
+  if (valid(&name)) {
+    flight.publish(name);
+    return name;
+  }
+
+  std::string body;
+  JsonWriter writer(&body);
+  writer.begin_object()
+      .key("model").string("models/" + std::string(model))
+      .key("systemInstruction");
+  write_content(&writer, system);
+  writer.key("ttl").string(std::to_string(context_cache_ttl_.count()) + "s");
+  writer.end_object();
+
+  HttpClient client;
+  auto headers = get_headers(api_key);
+  auto created_at = std::chrono::steady_clock::now();
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        return client.post(get_endpoint(model), "/v1beta/cachedContents",
+                           body, headers, request_timeout(id()));
+      },
+      metrics);
+  if (response.error.empty() && response.is_success()) {
+    ApiError api_error;
+    if (!extract_cached_content(response.body, &name, &api_error, &ignored) ||
+        api_error.present) {
+      name.clear();
     }
+  }
 
-    // Extract response text from candidates[0].content.parts[0].text
-    if (response.contains("candidates") && response["candidates"].is_array() &&
-        !response["candidates"].empty()) {
-      const auto& first_candidate = response["candidates"][0];
-      if (first_candidate.contains("content")) {
-        const auto& content = first_candidate["content"];
-        if (content.contains("parts") && content["parts"].is_array() &&
-            !content["parts"].empty()) {
-          const auto& first_part = content["parts"][0];
-          if (first_part.contains("text")) {
-            return first_part["text"].get<std::string>();
-          }
-        }
+  // Replaced a fifth of the TTL early, so that requests in flight do not
+  // reference content that has just expired
+  CachedContent entry;
+  entry.name = name;
+  entry.expires = created_at + context_cache_ttl_;
+  if (!name.empty()) {
+    entry.expires -= context_cache_ttl_ / 5;
+  }
+  {
+    std::lock_guard<std::mutex> lock(cached_contents_mutex_);
+    if (cached_contents_.size() >= kMaxCachedContents) {
+      auto now = std::chrono::steady_clock::now();
+      for (auto it = cached_contents_.begin(); it != cached_contents_.end();) {
+        it = now >= it->second.expires ? cached_contents_.erase(it)
+                                       : std::next(it);
       }
     }
+    if (cached_contents_.size() < kMaxCachedContents) {
+      cached_contents_[key] = std::move(entry);
+    }
+  }
+  flight.publish(name);
+  return name;
+}
 
-    *error = "Invalid response format: missing candidates or content";
-    return "";
+void GoogleProvider::forget_cached_content(uint64_t key) {
+  std::lock_guard<std::mutex> lock(cached_contents_mutex_);
+  cached_contents_.erase(key);
+}
 
-  } catch (const json::exception& e) {
-    *error = std::string("JSON parse error: ") + e.what();
-    return "";
+bool GoogleProvider::parse_stream_event(std::string_view data,
+                                        std::string* text, TokenUsage* usage,
+                                        std::string* error) const {
+  // Each event is a partial GenerateContentResponse
+  ApiError api_error;
+  if (!extract_google_chunk(data, text, usage, &api_error, error)) {
+    return false;
   }
+
+  if (api_error.present) {
+    *error = api_error_message(api_error);
+    return false;
+  }
+  return true;
 }
 
-std::string GoogleProvider::prompt(const std::string& model,
-                                    const std::string& api_key,
-                                    const std::string& prompt_text,
+std::string GoogleProvider::prompt(std::string_view model,
+                                    std::string_view api_key,
+                                    std::string_view prompt_text,
+                                    const PromptOptions& options,
+                                    size_t max_length, bool* truncated,
                                     std::string* error) {
-  // Build request
-  std::string request_body = build_request_body(prompt_text);
+  // Build request into a per-thread buffer, reused row after row. The
+  // response cache key is taken over the system prompt itself, not over
+  // the name of the cached content holding it.
+  thread_local std::string request_body;
+  request_body.clear();
+  long max_tokens = resolve_max_tokens(id(), options, max_length);
+  build_request_body(prompt_text, options, max_tokens, {}, &request_body);
+
+  // Serve repeated prompts from the response cache
+  ResponseCache& cache = ResponseCache::instance();
+  uint64_t cache_key = ResponseCache::make_key(provider_name(id()), model,
+                                               api_key, request_body);
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  bool reusable = reusable_answer(options);
+  std::string cached;
+  if (reusable && cache.get(cache_key, &cached)) {
+    metrics.record_cache_hit();
+    // The answer is complete, but a caller with a smaller limit and the
+    // same explicit max_tokens cannot take all of it
+    if (truncated) {
+      *truncated = cached.size() > max_length;
+    }
+    return cached;
+  }
+
+  // The same prompt may already be in flight, e.g. from another session
+  // running the same query; if so, share its answer. The length limit is
+  // part of the key since the answer is cut to it.
+  auto flight = prompt_flights(options).join(
+      hash_combine(cache_key, max_length), error);
+  if (!flight.leader()) {
+    metrics.record_deduplicated();
+    PromptAnswer answer = flight.wait(error);
+    if (truncated) {
+      *truncated = answer.truncated;
+    }
+    return std::move(answer.text);
+  }
+  CallRecorder recorder(&metrics, error);
+
   auto headers = get_headers(api_key);
 
-  // Build the full path with model name
-  std::string path = "/v1beta/models/" + model + ":generateContent";
+  // Build the full path with model name; alt=sse selects server-sent events
+  // over a streamed JSON array
+  std::string path = model_path(model, ":streamGenerateContent?alt=sse");
 
-  // Make HTTP request
-  HttpClient client;
-  auto response =
-      client.post(get_endpoint(model), path, request_body, headers, 30);
+  // Send a cached system prompt by reference (explicit context caching)
+  uint64_t content_key = 0;
+  std::string content_name;
+  if (options.cache_system && !options.system.empty()) {
+    content_key = cached_content_key(model, api_key, options.system);
+    content_name = cached_content(model, api_key, options.system,
+                                  content_key, &metrics);
+    if (!content_name.empty()) {
+      request_body.clear();
+      build_request_body(prompt_text, options, max_tokens, content_name,
+                         &request_body);
+    }
+  }
+
+  // Make HTTP request, reading the text as it streams in
+  StreamResult result;
+  auto send_prompt = [&] {
+    return post_streaming_prompt(
+        id(), api_key, get_endpoint(model), path, request_body, headers,
+        max_length,
+        [this](std::string_view data, std::string* text, TokenUsage* usage,
+               std::string* error) {
+          return parse_stream_event(data, text, usage, error);
+        },
+        &metrics, &result);
+  };
+  auto response = send_prompt();
+
+  // Content deleted or expired early fails the request; send the system
+  // prompt inline instead, and create new content for the next rows. Other
+  // failures go back as they are; sending again would double the requests
+  // of a bad key or an exhausted rate limit.
+  if (!content_name.empty() && response.error.empty() &&
+      cached_content_rejected(response, content_name)) {
+    forget_cached_content(content_key);
+    request_body.clear();
+    build_request_body(prompt_text, options, max_tokens, {}, &request_body);
+    response = send_prompt();
+  }
 
   // Check for network errors
   if (!response.error.empty()) {
@@ -224,113 +1158,470 @@ std::string GoogleProvider::prompt(const std::string& model,
 
   // Check HTTP status
   if (!response.is_success()) {
-    // Try to extract error message from response body
-    std::string api_error;
-    std::string parsed_response = parse_response(response.body, &api_error);
+    *error = http_error_message(response);
+    return "";
+  }
 
-    if (!api_error.empty()) {
-      *error = api_error;
-    } else {
-      *error = "HTTP " + std::to_string(response.status_code) + " - " +
-               response.body.substr(0, 100);
-    }
+  // Check for an error reported mid-stream
+  if (!result.stream_error.empty()) {
+    *error = result.stream_error;
     return "";
   }
 
-  // Parse successful response
-  return parse_response(response.body, error);
+  // A response cut short at max_length is not cached
+  if (reusable && !result.truncated) {
+    cache.put(cache_key, result.text);
+  }
+  if (truncated) {
+    *truncated = result.truncated;
+  }
+  PromptAnswer answer{std::move(result.text), result.truncated};
+  flight.publish(answer);
+  return std::move(answer.text);
 }
 
-std::string GoogleProvider::embed(const std::string& model,
-                                   const std::string& api_key,
-                                   const std::string& text,
-                                   std::string* error) {
+std::vector<float> GoogleProvider::embed(std::string_view model,
+                                          std::string_view api_key,
+                                          std::string_view text,
+                                          std::string* error) {
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+
+  // Share the result of an identical request already in flight
+  uint64_t flight_key =
+      hash_combine(EmbeddingStore::make_key(provider_name(id()), model, text),
+                   std::hash<std::string_view>()(api_key));
+  auto flight = embedding_flights().join(flight_key, error);
+  if (!flight.leader()) {
+    metrics.record_deduplicated();
+    return flight.wait(error);
+  }
+  CallRecorder recorder(&metrics, error);
+
   // Build request body for embedContent API
-  json request = {{"content", json::object({{"parts", json::array({json::object({{"text", text}})})}})}};
+  thread_local std::string request_body;
+  request_body.clear();
+  JsonWriter writer(&request_body);
+  writer.begin_object().key("content");
+  write_content(&writer, text);
+  writer.end_object();
 
-  std::string request_body = request.dump();
   auto headers = get_headers(api_key);
 
   // Build the full path with model name for embedContent
-  std::string path = "/v1beta/models/" + model + ":embedContent";
+  std::string path = model_path(model, ":embedContent");
 
   // Make HTTP request
   HttpClient client;
-  auto response = client.post(get_endpoint(model), path, request_body, headers, 30);
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        return client.post(get_endpoint(model), path, request_body, headers,
+                           request_timeout(id()));
+      },
+      &metrics);
 
   // Check for network errors
   if (!response.error.empty()) {
     *error = response.error;
-    return "";
+    return {};
   }
 
   // Check HTTP status
   if (!response.is_success()) {
-    // Try to extract error message from response body
-    try {
-      auto error_response = json::parse(response.body);
-      if (error_response.contains("error")) {
-        if (error_response["error"].contains("message")) {
-          *error = error_response["error"]["message"].get<std::string>();
-        } else {
-          *error = error_response["error"].dump();
-        }
-      } else {
-        *error = "HTTP " + std::to_string(response.status_code) + " - " +
-                 response.body.substr(0, 100);
-      }
-    } catch (const json::exception& e) {
-      *error = "HTTP " + std::to_string(response.status_code) + " - " +
-               response.body.substr(0, 100);
+    *error = http_error_message(response);
+    return {};
+  }
+
+  // Parse the embedding.values floats straight out of the response
+  std::vector<std::vector<float>> embeddings;
+  ApiError api_error;
+  auto parse_start = std::chrono::steady_clock::now();
+  bool parsed =
+      extract_embeddings(response.body, &embeddings, &api_error, error);
+  metrics.parse().record(std::chrono::steady_clock::now() - parse_start);
+  if (!parsed) {
+    return {};
+  }
+
+  if (api_error.present) {
+    *error = api_error_message(api_error);
+    return {};
+  }
+
+  if (embeddings.size() != 1) {
+    *error = "Invalid response format: missing embedding.values";
+    return {};
+  }
+  flight.publish(embeddings[0]);
+  return std::move(embeddings[0]);
+}
+
+std::vector<std::vector<float>> GoogleProvider::embed_batch(
+    std::string_view model, std::string_view api_key,
+    const std::vector<std::string>& texts, std::string* error) {
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  CallRecorder recorder(&metrics, error);
+
+  std::vector<std::vector<float>> embeddings(texts.size());
+  size_t chunks = (texts.size() + kMaxEmbedBatchSize - 1) / kMaxEmbedBatchSize;
+  std::vector<std::string> chunk_errors(chunks);
+
+  // Keep several chunks in flight; each fills its own slice of embeddings
+  size_t concurrency =
+      ProviderRegistry::instance().settings(id()).max_concurrency;
+  WorkerPool::instance().parallel_for(chunks, concurrency, [&](size_t chunk) {
+    size_t begin = chunk * kMaxEmbedBatchSize;
+    size_t end = std::min(begin + kMaxEmbedBatchSize, texts.size());
+    embed_chunk(model, api_key, texts, begin, end, &metrics, &embeddings,
+                &chunk_errors[chunk]);
+  });
+
+  for (const auto& chunk_error : chunk_errors) {
+    if (!chunk_error.empty()) {
+      *error = chunk_error;
+      return {};
     }
-    return "";
   }
+  return embeddings;
+}
 
-  // Parse successful response to extract embedding values
-  try {
-    auto response_json = json::parse(response.body);
+void GoogleProvider::embed_chunk(std::string_view model,
+                                 std::string_view api_key,
+                                 const std::vector<std::string>& texts,
+                                 size_t begin, size_t end,
+                                 ModelMetrics* metrics,
+                                 std::vector<std::vector<float>>* embeddings,
+                                 std::string* error) const {
+  // Each entry names the model again, as the batch API requires
+  std::string model_ref = "models/";
+  model_ref.append(model);
 
-    // Check for API error
-    if (response_json.contains("error")) {
-      if (response_json["error"].contains("message")) {
-        *error = response_json["error"]["message"].get<std::string>();
-      } else {
-        *error = response_json["error"].dump();
-      }
-      return "";
+  thread_local std::string request_body;
+  request_body.clear();
+  JsonWriter writer(&request_body);
+  writer.begin_object().key("requests").begin_array();
+  for (size_t i = begin; i < end; i++) {
+    writer.begin_object().key("model").string(model_ref).key("content");
+    write_content(&writer, texts[i]);
+    writer.end_object();
+  }
+  writer.end_array().end_object();
+
+  auto headers = get_headers(api_key);
+
+  // Build the full path with model name for batchEmbedContents
+  std::string path = model_path(model, ":batchEmbedContents");
+
+  // Make HTTP request
+  HttpClient client;
+  auto response = send_with_retries(
+      id(), api_key,
+      [&] {
+        return client.post(get_endpoint(model), path, request_body, headers,
+                           request_timeout(id()));
+      },
+      metrics);
+
+  // Check for network errors
+  if (!response.error.empty()) {
+    *error = response.error;
+    return;
+  }
+
+  // Check HTTP status
+  if (!response.is_success()) {
+    *error = http_error_message(response);
+    return;
+  }
+
+  // Parse the embeddings[i].values floats straight out of the response,
+  // in request order
+  std::vector<std::vector<float>> chunk_embeddings;
+  ApiError api_error;
+  auto parse_start = std::chrono::steady_clock::now();
+  bool parsed =
+      extract_embeddings(response.body, &chunk_embeddings, &api_error, error);
+  metrics->parse().record(std::chrono::steady_clock::now() - parse_start);
+  if (!parsed) {
+    return;
+  }
+
+  if (api_error.present) {
+    *error = api_error_message(api_error);
+    return;
+  }
+
+  if (chunk_embeddings.size() != end - begin) {
+    *error = "Invalid response format: missing embeddings";
+    return;
+  }
+  std::move(chunk_embeddings.begin(), chunk_embeddings.end(),
+            embeddings->begin() + begin);
+}
+
+// =============================================================================
+// LocalProvider Implementation
+// =============================================================================
+
+namespace {
+
+// Model names are directory names under VSQL_AI_LOCAL_MODEL_DIR; anything
+// that could leave it is rejected
+bool valid_model_name(std::string_view name) {
+  if (name.empty() || name.size() > 128 || name[0] == '.') {
+    return false;
+  }
+  for (char c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' &&
+        c != '-' && c != '.') {
+      return false;
     }
+  }
+  return true;
+}
+
+// How long a failed model load is reported without trying again
+constexpr auto kFailedLoadRetry = std::chrono::seconds(5);
+
+}  // namespace
+
+LocalProvider::LocalProvider()
+    : model_dir_(config_string("LOCAL_MODEL_DIR", "")), loads_(true) {}
 
-    // Extract embedding values from response.embedding.values
-    if (response_json.contains("embedding") &&
-        response_json["embedding"].contains("values")) {
-      // Return the values array as a JSON string
-      return response_json["embedding"]["values"].dump();
+LocalProvider::~LocalProvider() {}
+
+std::string LocalProvider::prompt(std::string_view model,
+                                  std::string_view api_key,
+                                  std::string_view prompt_text,
+                                  const PromptOptions& options,
+                                  size_t max_length, bool* truncated,
+                                  std::string* error) {
+  *error = "Prompts not supported for local provider";
+  return "";
+}
+
+std::shared_ptr<const StaticEmbeddingModel> LocalProvider::model(
+    std::string_view name, std::string* error) {
+  if (model_dir_.empty()) {
+    *error = "Local models are disabled; set VSQL_AI_LOCAL_MODEL_DIR";
+    return nullptr;
+  }
+  if (!valid_model_name(name)) {
+    *error = "Invalid local model name: " + std::string(name);
+    return nullptr;
+  }
+
+  // Loading maps the weights and parses the vocabulary once per process.
+  // Concurrent first calls for a model wait for one load rather than load
+  // twice. Failures are kept for kFailedLoadRetry, so fixing the files takes
+  // effect without a restart.
+  {
+    std::lock_guard<std::mutex> lock(models_mutex_);
+    auto found = models_.find(name);
+    if (found != models_.end()) {
+      return found->second;
+    }
+    auto failed = failed_loads_.find(name);
+    if (failed != failed_loads_.end() &&
+        std::chrono::steady_clock::now() < failed->second.retry_at) {
+      *error = failed->second.error;
+      return nullptr;
     }
+  }
 
-    *error = "Invalid response format: missing embedding.values";
-    return "";
+  std::string load_error;
+  auto flight = loads_.join(std::hash<std::string_view>()(name), &load_error);
+  if (!flight.leader()) {
+    std::shared_ptr<const StaticEmbeddingModel> loaded =
+        flight.wait(&load_error);
+    if (!loaded) {
+      *error = load_error;
+    }
+    return loaded;
+  }
 
-  } catch (const json::exception& e) {
-    *error = std::string("JSON parse error: ") + e.what();
-    return "";
+  // A load may have finished between the lookup and join()
+  std::shared_ptr<const StaticEmbeddingModel> loaded;
+  {
+    std::lock_guard<std::mutex> lock(models_mutex_);
+    auto found = models_.find(name);
+    if (found != models_.end()) {
+      loaded = found->second;
+    }
+  }
+  if (!loaded) {
+    loaded = StaticEmbeddingModel::load(model_dir_ + "/" + std::string(name),
+                                        &load_error);
+    std::lock_guard<std::mutex> lock(models_mutex_);
+    if (loaded) {
+      models_.emplace(std::string(name), loaded);
+      failed_loads_.erase(std::string(name));
+    } else {
+      load_error = "Failed to load local model '" + std::string(name) +
+                   "': " + load_error;
+      failed_loads_[std::string(name)] = {
+          load_error, std::chrono::steady_clock::now() + kFailedLoadRetry};
+    }
+  }
+  flight.publish(loaded);
+  if (!loaded) {
+    *error = load_error;
+  }
+  return loaded;
+}
+
+std::vector<float> LocalProvider::embed(std::string_view model,
+                                        std::string_view api_key,
+                                        std::string_view text,
+                                        std::string* error) {
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  CallRecorder recorder(&metrics, error);
+
+  auto embedding_model = this->model(model, error);
+  if (!embedding_model) {
+    return {};
+  }
+
+  std::vector<float> values;
+  TokenUsage usage;
+  usage.input_tokens = embedding_model->embed(text, &values);
+  metrics.record_usage(usage);
+  return values;
+}
+
+std::vector<std::vector<float>> LocalProvider::embed_batch(
+    std::string_view model, std::string_view api_key,
+    const std::vector<std::string>& texts, std::string* error) {
+  ModelMetrics& metrics =
+      ProviderRegistry::instance().model_metrics(id()).get(model);
+  CallRecorder recorder(&metrics, error);
+
+  auto embedding_model = this->model(model, error);
+  if (!embedding_model) {
+    return {};
+  }
+
+  std::vector<std::vector<float>> embeddings(texts.size());
+  size_t chunks = (texts.size() + kEmbedChunkSize - 1) / kEmbedChunkSize;
+  std::vector<uint64_t> chunk_tokens(chunks);
+
+  size_t concurrency =
+      ProviderRegistry::instance().settings(id()).max_concurrency;
+  WorkerPool::instance().parallel_for(chunks, concurrency, [&](size_t chunk) {
+    size_t begin = chunk * kEmbedChunkSize;
+    size_t end = std::min(begin + kEmbedChunkSize, texts.size());
+    for (size_t i = begin; i < end; i++) {
+      chunk_tokens[chunk] += embedding_model->embed(texts[i], &embeddings[i]);
+    }
+  });
+
+  TokenUsage usage;
+  for (uint64_t tokens : chunk_tokens) {
+    usage.input_tokens += tokens;
   }
+  metrics.record_usage(usage);
+  return embeddings;
 }
 
 // =============================================================================
 // Factory Function
 // =============================================================================
 
-std::unique_ptr<AIProvider> create_provider(const std::string& provider_name) {
-  if (provider_name == "anthropic") {
-    return std::make_unique<AnthropicProvider>();
+const char* provider_name(ProviderId id) {
+  switch (id) {
+    case ProviderId::kAnthropic:
+      return "anthropic";
+    case ProviderId::kGoogle:
+      return "google";
+    case ProviderId::kLocal:
+      return "local";
   }
+  return "unknown";
+}
 
-  if (provider_name == "google") {
-    return std::make_unique<GoogleProvider>();
+std::unique_ptr<AIProvider> create_provider(ProviderId id) {
+  switch (id) {
+    case ProviderId::kAnthropic:
+      return std::make_unique<AnthropicProvider>();
+    case ProviderId::kGoogle:
+      return std::make_unique<GoogleProvider>();
+    case ProviderId::kLocal:
+      return std::make_unique<LocalProvider>();
   }
 
   // Unknown provider
   return nullptr;
 }
 
+// =============================================================================
+// ProviderRegistry
+// =============================================================================
+
+ProviderRegistry& ProviderRegistry::instance() {
+  static ProviderRegistry registry;
+  return registry;
+}
+
+ProviderRegistry::ProviderRegistry() {
+  for (size_t i = 0; i < kProviderCount; i++) {
+    auto id = static_cast<ProviderId>(i);
+    providers_[i] = create_provider(id);
+
+    // e.g. VSQL_AI_ANTHROPIC_MAX_CONCURRENCY
+    std::string prefix = provider_name(id);
+    std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::toupper);
+
+    // A proxy or mock server may stand in for the provider's API
+    std::string url = config_string(prefix + "_BASE_URL", base_url(id));
+    if (!HttpClient::Endpoint::parse(url, &settings_[i].endpoint)) {
+      HttpClient::Endpoint::parse(base_url(id), &settings_[i].endpoint);
+    }
+
+    settings_[i].max_concurrency = static_cast<size_t>(std::max(
+        1L, config_int(prefix + "_MAX_CONCURRENCY", kDefaultMaxConcurrency)));
+    settings_[i].max_tokens =
+        std::max(1L, config_int(prefix + "_MAX_TOKENS", kDefaultMaxTokens));
+    settings_[i].rate_limits.max_in_flight = static_cast<size_t>(std::max(
+        1L, config_int(prefix + "_MAX_IN_FLIGHT", kDefaultMaxInFlight)));
+    settings_[i].rate_limits.requests_per_minute = static_cast<double>(
+        std::max(0L, config_int(prefix + "_REQUESTS_PER_MINUTE", 0)));
+
+    RetryPolicy& retry = settings_[i].retry;
+    retry.max_attempts = static_cast<int>(std::max(
+        1L, config_int(prefix + "_RETRY_MAX_ATTEMPTS",
+                       kDefaultRetryMaxAttempts)));
+    retry.base_delay = std::chrono::milliseconds(std::max(
+        0L, config_int(prefix + "_RETRY_BASE_DELAY_MS",
+                       kDefaultRetryBaseDelayMs)));
+    retry.max_delay = std::chrono::milliseconds(std::max(
+        0L, config_int(prefix + "_RETRY_MAX_DELAY_MS",
+                       kDefaultRetryMaxDelayMs)));
+    retry.deadline = std::chrono::seconds(std::max(
+        0L, config_int(prefix + "_RETRY_DEADLINE", kDefaultRetryDeadline)));
+    settings_[i].request_timeout = static_cast<int>(std::min(
+        86400L, std::max(1L, config_int(prefix + "_REQUEST_TIMEOUT",
+                                        kDefaultRequestTimeout))));
+
+    // Connect now rather than on the first query after a restart
+    long warm_up = config_int(prefix + "_WARMUP_CONNECTIONS", 0);
+    if (warm_up > 0) {
+      HttpClient::warm_up(settings_[i].endpoint,
+                          static_cast<size_t>(warm_up));
+    }
+  }
+}
+
+AIProvider* ProviderRegistry::find(std::string_view name) const {
+  // Only a handful of providers, so a scan over the names beats hashing
+  for (size_t i = 0; i < kProviderCount; i++) {
+    if (name == provider_name(static_cast<ProviderId>(i))) {
+      return providers_[i].get();
+    }
+  }
+  return nullptr;
+}
+
 }  // namespace vsql_ai
@@ -17,28 +17,113 @@
 #ifndef VSQL_AI_PROVIDERS_H
 #define VSQL_AI_PROVIDERS_H
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "content_encoding.h"
+#include "http_client.h"
+#include "json_extract.h"
+#include "metrics.h"
+#include "rate_limiter.h"
+#include "retry_policy.h"
+#include "single_flight.h"
 
 namespace vsql_ai {
 
+class JsonWriter;
+class StaticEmbeddingModel;
+
+// Known providers. The registry keeps one shared instance of each.
+enum class ProviderId { kAnthropic, kGoogle, kLocal };
+
+constexpr size_t kProviderCount = 3;
+
+// SQL-facing provider name, e.g. "anthropic"
+const char* provider_name(ProviderId id);
+
+// Generation options for prompt(). Unset fields use the provider's default.
+struct PromptOptions {
+  // Defaults to what fits in the caller's result buffer, capped by
+  // VSQL_AI_<PROVIDER>_MAX_TOKENS
+  std::optional<long> max_tokens;
+  std::optional<double> temperature;
+  std::vector<std::string> stop_sequences;
+  std::string system;
+
+  // Have the provider cache the system prompt, so that a long instruction
+  // prefix shared by many prompts is only processed once
+  bool cache_system = false;
+};
+
 // Abstract base class for AI providers
+//
+// A single instance of each provider is shared by every session, so
+// implementations must be safe to call from multiple threads at once.
 class AIProvider {
  public:
   virtual ~AIProvider() = default;
 
-  // Send a prompt and get a response
-  virtual std::string prompt(const std::string& model,
-                             const std::string& api_key,
-                             const std::string& prompt_text,
-                             std::string* error) = 0;
-
-  // Create embeddings for text (returns JSON array of floats)
-  virtual std::string embed(const std::string& model,
-                            const std::string& api_key,
-                            const std::string& text,
-                            std::string* error) = 0;
+  virtual ProviderId id() const = 0;
+
+  // Providers that run in-process take an empty API key
+  virtual bool needs_api_key() const { return true; }
+
+  // Send a prompt and get a response. The response is streamed and the
+  // request abandoned once more than max_length bytes of text have arrived;
+  // *truncated (unless null) then tells the answer was cut short, and it
+  // may be longer than max_length by at most one streamed chunk. A complete
+  // answer is never longer than max_length.
+  virtual std::string prompt(std::string_view model, std::string_view api_key,
+                             std::string_view prompt_text,
+                             const PromptOptions& options, size_t max_length,
+                             bool* truncated, std::string* error) = 0;
+
+  // Create an embedding for text
+  virtual std::vector<float> embed(std::string_view model,
+                                   std::string_view api_key,
+                                   std::string_view text,
+                                   std::string* error) = 0;
+
+  // Create embeddings for many texts (one vector per text, in input order).
+  // The default makes one embed() call per text; providers with a native
+  // batch endpoint override it.
+  virtual std::vector<std::vector<float>> embed_batch(
+      std::string_view model, std::string_view api_key,
+      const std::vector<std::string>& texts, std::string* error);
+
+  // Message batches: prompts the provider answers asynchronously, at a
+  // discount, for bulk jobs that can wait. custom_ids[i] names prompts[i]
+  // in the results. model only attributes the calls in the metrics once the
+  // batch exists. The defaults report batches as unsupported.
+  virtual bool create_batch(std::string_view model, std::string_view api_key,
+                            const std::vector<std::string>& custom_ids,
+                            const std::vector<std::string>& prompts,
+                            const PromptOptions& options, MessageBatch* batch,
+                            std::string* error);
+
+  virtual bool get_batch(std::string_view model, std::string_view api_key,
+                         std::string_view batch_id, MessageBatch* batch,
+                         std::string* error);
+
+  // Download the results of an ended batch, passing each to on_result as
+  // it is parsed
+  using BatchResultHandler = std::function<void(MessageBatchResult& result)>;
+  virtual bool get_batch_results(std::string_view model,
+                                 std::string_view api_key,
+                                 std::string_view batch_id,
+                                 const BatchResultHandler& on_result,
+                                 std::string* error);
 };
 
 // Anthropic Claude provider implementation
@@ -47,21 +132,56 @@ class AnthropicProvider : public AIProvider {
   AnthropicProvider();
   ~AnthropicProvider() override;
 
-  std::string prompt(const std::string& model, const std::string& api_key,
-                     const std::string& prompt_text,
-                     std::string* error) override;
+  ProviderId id() const override { return ProviderId::kAnthropic; }
 
-  std::string embed(const std::string& model, const std::string& api_key,
-                    const std::string& text, std::string* error) override;
+  std::string prompt(std::string_view model, std::string_view api_key,
+                     std::string_view prompt_text,
+                     const PromptOptions& options, size_t max_length,
+                     bool* truncated, std::string* error) override;
+
+  std::vector<float> embed(std::string_view model, std::string_view api_key,
+                           std::string_view text, std::string* error) override;
+
+  // Message Batches API: answered within 24 hours, usually within one, at
+  // half the price of prompt()
+  bool create_batch(std::string_view model, std::string_view api_key,
+                    const std::vector<std::string>& custom_ids,
+                    const std::vector<std::string>& prompts,
+                    const PromptOptions& options, MessageBatch* batch,
+                    std::string* error) override;
+
+  bool get_batch(std::string_view model, std::string_view api_key,
+                 std::string_view batch_id, MessageBatch* batch,
+                 std::string* error) override;
+
+  bool get_batch_results(std::string_view model, std::string_view api_key,
+                         std::string_view batch_id,
+                         const BatchResultHandler& on_result,
+                         std::string* error) override;
+
+  // Largest number of prompts the API accepts in one batch
+  static constexpr size_t kMaxBatchSize = 100000;
 
  private:
-  std::string get_endpoint() const;
+  const HttpClient::Endpoint& get_endpoint() const;
   std::map<std::string, std::string> get_headers(
-      const std::string& api_key) const;
-  std::string build_request_body(const std::string& model,
-                                  const std::string& prompt) const;
-  std::string parse_response(const std::string& response_json,
-                             std::string* error) const;
+      std::string_view api_key) const;
+  // Append the JSON request body to *body
+  void build_request_body(std::string_view model, std::string_view prompt,
+                          const PromptOptions& options, long max_tokens,
+                          std::string* body) const;
+  // Write the Messages API parameters of one prompt as an object; shared by
+  // streamed prompts and batch requests, which are not streamed
+  void write_message_params(JsonWriter* writer, std::string_view model,
+                            std::string_view prompt,
+                            const PromptOptions& options, long max_tokens,
+                            bool stream) const;
+
+  // Append the text of one streamed event to *text and take its token
+  // counts into *usage. Returns false and sets *error if the event reports
+  // an error.
+  bool parse_stream_event(std::string_view data, std::string* text,
+                          TokenUsage* usage, std::string* error) const;
 };
 
 // Google provider implementation (Gemini models)
@@ -70,24 +190,191 @@ class GoogleProvider : public AIProvider {
   GoogleProvider();
   ~GoogleProvider() override;
 
-  std::string prompt(const std::string& model, const std::string& api_key,
-                     const std::string& prompt_text,
-                     std::string* error) override;
+  ProviderId id() const override { return ProviderId::kGoogle; }
+
+  std::string prompt(std::string_view model, std::string_view api_key,
+                     std::string_view prompt_text,
+                     const PromptOptions& options, size_t max_length,
+                     bool* truncated, std::string* error) override;
+
+  std::vector<float> embed(std::string_view model, std::string_view api_key,
+                           std::string_view text, std::string* error) override;
 
-  std::string embed(const std::string& model, const std::string& api_key,
-                    const std::string& text, std::string* error) override;
+  // Uses :batchEmbedContents, kMaxEmbedBatchSize texts per request, with up
+  // to max_concurrency requests in flight
+  std::vector<std::vector<float>> embed_batch(
+      std::string_view model, std::string_view api_key,
+      const std::vector<std::string>& texts, std::string* error) override;
+
+  // Largest number of requests accepted by one :batchEmbedContents call
+  static constexpr size_t kMaxEmbedBatchSize = 100;
 
  private:
-  std::string get_endpoint(const std::string& model) const;
+  // A cachedContents resource holding a system prompt, or an empty name if
+  // the API declined to create one
+  struct CachedContent {
+    std::string name;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  const HttpClient::Endpoint& get_endpoint(std::string_view model) const;
   std::map<std::string, std::string> get_headers(
-      const std::string& api_key) const;
-  std::string build_request_body(const std::string& prompt) const;
-  std::string parse_response(const std::string& response_json,
-                             std::string* error) const;
+      std::string_view api_key) const;
+  // With cached_content set, the system prompt is referenced by that name
+  // instead of sent
+  void build_request_body(std::string_view prompt,
+                          const PromptOptions& options, long max_tokens,
+                          std::string_view cached_content,
+                          std::string* body) const;
+  bool parse_stream_event(std::string_view data, std::string* text,
+                          TokenUsage* usage, std::string* error) const;
+
+  // Embed texts[begin, end) with one :batchEmbedContents request, writing
+  // the results to the same positions in *embeddings
+  void embed_chunk(std::string_view model, std::string_view api_key,
+                   const std::vector<std::string>& texts, size_t begin,
+                   size_t end, ModelMetrics* metrics,
+                   std::vector<std::vector<float>>* embeddings,
+                   std::string* error) const;
+
+  // Name of the cached content holding system for model under key (see
+  // prompt()), created if there is none or it is about to expire. Returns
+  // "" if the API will not cache it, e.g. when it is shorter than the
+  // model's minimum; that answer is kept for the TTL as well.
+  std::string cached_content(std::string_view model, std::string_view api_key,
+                             std::string_view system, uint64_t key,
+                             ModelMetrics* metrics);
+  void forget_cached_content(uint64_t key);
+
+  // VSQL_AI_GOOGLE_CONTEXT_CACHE_TTL
+  std::chrono::seconds context_cache_ttl_;
+  std::mutex cached_contents_mutex_;
+  std::unordered_map<uint64_t, CachedContent> cached_contents_;
+  // Rows arriving together with a new system prompt create one resource
+  SingleFlight<std::string> cached_content_flights_{true};
 };
 
-// Factory function to create provider by name
-std::unique_ptr<AIProvider> create_provider(const std::string& provider_name);
+// In-process embeddings from static embedding models (see
+// static_embedding.h) in subdirectories of VSQL_AI_LOCAL_MODEL_DIR; the
+// model argument names the subdirectory. No API key and no network round
+// trip, so an embedding takes microseconds. Prompts are not supported.
+class LocalProvider : public AIProvider {
+ public:
+  LocalProvider();
+  ~LocalProvider() override;
+
+  ProviderId id() const override { return ProviderId::kLocal; }
+  bool needs_api_key() const override { return false; }
+
+  std::string prompt(std::string_view model, std::string_view api_key,
+                     std::string_view prompt_text,
+                     const PromptOptions& options, size_t max_length,
+                     bool* truncated, std::string* error) override;
+
+  std::vector<float> embed(std::string_view model, std::string_view api_key,
+                           std::string_view text, std::string* error) override;
+
+  // Spreads the texts over up to max_concurrency threads of the worker
+  // pool, kEmbedChunkSize texts per task
+  std::vector<std::vector<float>> embed_batch(
+      std::string_view model, std::string_view api_key,
+      const std::vector<std::string>& texts, std::string* error) override;
+
+  // Texts embedded per worker pool task; a text takes microseconds, so
+  // smaller tasks would mostly measure the pool
+  static constexpr size_t kEmbedChunkSize = 64;
+
+ private:
+  // The model in subdirectory name, loaded on first use and shared by all
+  // sessions for the life of the process
+  std::shared_ptr<const StaticEmbeddingModel> model(std::string_view name,
+                                                    std::string* error);
+
+  // A load that failed, remembered briefly so that a scan over a missing
+  // model does not reload it for every row
+  struct FailedLoad {
+    std::string error;
+    std::chrono::steady_clock::time_point retry_at;
+  };
+
+  // VSQL_AI_LOCAL_MODEL_DIR; empty disables the provider
+  std::string model_dir_;
+  std::mutex models_mutex_;  // guards models_ and failed_loads_
+  std::map<std::string, std::shared_ptr<const StaticEmbeddingModel>,
+           std::less<>>
+      models_;
+  std::map<std::string, FailedLoad, std::less<>> failed_loads_;
+  // Loads in progress, keyed on the model name. They run outside
+  // models_mutex_, so models already loaded keep serving meanwhile.
+  SingleFlight<std::shared_ptr<const StaticEmbeddingModel>> loads_;
+};
+
+// Factory function to create provider by id. Used by ProviderRegistry to
+// build the shared instances; callers should go through the registry.
+std::unique_ptr<AIProvider> create_provider(ProviderId id);
+
+// Per-provider tuning, read from VSQL_AI_<PROVIDER>_* settings at load
+struct ProviderSettings {
+  // API base URL (VSQL_AI_<PROVIDER>_BASE_URL), parsed once so requests skip
+  // URL parsing
+  HttpClient::Endpoint endpoint;
+
+  // Most requests one SQL call keeps in flight to the provider at once
+  size_t max_concurrency;
+
+  // Upper bound for the default max_tokens; explicit options may exceed it
+  long max_tokens;
+
+  // Shared per-API-key admission control (VSQL_AI_<PROVIDER>_MAX_IN_FLIGHT,
+  // VSQL_AI_<PROVIDER>_REQUESTS_PER_MINUTE)
+  RateLimiter::Limits rate_limits;
+
+  // VSQL_AI_<PROVIDER>_RETRY_{MAX_ATTEMPTS,BASE_DELAY_MS,MAX_DELAY_MS,DEADLINE}
+  RetryPolicy retry;
+
+  // Seconds each attempt may wait to connect or for the next bytes
+  // (VSQL_AI_<PROVIDER>_REQUEST_TIMEOUT); a SQL call's deadline lowers it
+  int request_timeout;
+};
+
+// Process-wide registry of shared provider instances, built once when the
+// extension is loaded. Lookups do not allocate.
+class ProviderRegistry {
+ public:
+  static ProviderRegistry& instance();
+
+  // Returns nullptr for unknown provider names
+  AIProvider* find(std::string_view name) const;
+
+  AIProvider* get(ProviderId id) const {
+    return providers_[static_cast<size_t>(id)].get();
+  }
+
+  const ProviderSettings& settings(ProviderId id) const {
+    return settings_[static_cast<size_t>(id)];
+  }
+
+  RetryCounters& retry_counters(ProviderId id) {
+    return retry_counters_[static_cast<size_t>(id)];
+  }
+
+  TransferCounters& transfer_counters(ProviderId id) {
+    return transfer_counters_[static_cast<size_t>(id)];
+  }
+
+  ModelMetricsTable& model_metrics(ProviderId id) {
+    return model_metrics_[static_cast<size_t>(id)];
+  }
+
+ private:
+  ProviderRegistry();
+
+  std::array<std::unique_ptr<AIProvider>, kProviderCount> providers_;
+  std::array<ProviderSettings, kProviderCount> settings_;
+  std::array<RetryCounters, kProviderCount> retry_counters_;
+  std::array<TransferCounters, kProviderCount> transfer_counters_;
+  std::array<ModelMetricsTable, kProviderCount> model_metrics_;
+};
 
 }  // namespace vsql_ai
 
@@ -0,0 +1,61 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_ASCII_UTIL_H
+#define VSQL_AI_ASCII_UTIL_H
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+
+namespace vsql_ai {
+
+// Case folding for protocol text such as HTTP header names. Bytes go
+// through unsigned char: passing a negative char (UTF-8 or other bytes
+// >= 0x80) to std::tolower is undefined behaviour.
+
+inline char to_lower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+inline void to_lower(std::string* s) {
+  for (char& c : *s) {
+    c = to_lower(c);
+  }
+}
+
+inline bool equals_ignore_case(std::string_view a, std::string_view b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [](char x, char y) { return to_lower(x) == to_lower(y); });
+}
+
+// Position of the first case-insensitive match of needle in haystack, or
+// std::string_view::npos
+inline size_t find_ignore_case(std::string_view haystack,
+                               std::string_view needle) {
+  auto match = std::search(
+      haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+      [](char x, char y) { return to_lower(x) == to_lower(y); });
+  return match == haystack.end() && !needle.empty()
+             ? std::string_view::npos
+             : static_cast<size_t>(match - haystack.begin());
+}
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_ASCII_UTIL_H
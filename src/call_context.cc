@@ -0,0 +1,220 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "call_context.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace vsql_ai {
+
+namespace {
+
+thread_local CallContext* current_context = nullptr;
+
+}  // namespace
+
+// =============================================================================
+// DeadlineTimer
+// =============================================================================
+
+// One background thread that expires calls at their deadlines, so a request
+// blocked on a socket is aborted on time rather than at its own timeout.
+// Started by the first call that has a deadline.
+class DeadlineTimer {
+ public:
+  static DeadlineTimer& instance() {
+    static DeadlineTimer timer;
+    return timer;
+  }
+
+  void add(CallContext* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&DeadlineTimer::loop, this);
+    }
+    bool earliest =
+        timers_.empty() || context->deadline_ < timers_.begin()->first;
+    context->timer_entry_ = timers_.emplace(context->deadline_, context);
+    context->timer_armed_ = true;
+    if (earliest) {
+      changed_.notify_one();
+    }
+  }
+
+  // Contexts expire with the timer's lock held, so once this returns the
+  // timer is done with the context
+  void remove(CallContext* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (context->timer_armed_) {
+      timers_.erase(context->timer_entry_);
+      context->timer_armed_ = false;
+    }
+  }
+
+ private:
+  DeadlineTimer() = default;
+
+  ~DeadlineTimer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      if (timers_.empty()) {
+        changed_.wait(lock);
+        continue;
+      }
+
+      auto first = timers_.begin();
+      if (CallContext::Clock::now() < first->first) {
+        changed_.wait_until(lock, first->first);
+        continue;
+      }
+
+      CallContext* context = first->second;
+      timers_.erase(first);
+      context->timer_armed_ = false;
+      context->expire();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::multimap<CallContext::Clock::time_point, CallContext*> timers_;
+  std::thread thread_;
+  bool stopping_ = false;
+};
+
+// =============================================================================
+// CallContext
+// =============================================================================
+
+CallContext::CallContext(Clock::duration timeout)
+    : timeout_(timeout),
+      deadline_(timeout > Clock::duration::zero() ? Clock::now() + timeout
+                                                  : Clock::time_point::max()) {
+  if (deadline_ != Clock::time_point::max()) {
+    DeadlineTimer::instance().add(this);
+  }
+}
+
+CallContext::~CallContext() {
+  if (deadline_ != Clock::time_point::max()) {
+    DeadlineTimer::instance().remove(this);
+  }
+}
+
+CallContext* CallContext::current() { return current_context; }
+
+void CallContext::cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cancelled_ = true;
+  for (HttpClient::RequestControl* control : controls_) {
+    control->cancel();
+  }
+  cancelled_cv_.notify_all();
+}
+
+void CallContext::expire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timed_out_ = true;
+  }
+  cancel();
+}
+
+bool CallContext::cancelled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cancelled_ || Clock::now() >= deadline_;
+}
+
+std::string CallContext::cancel_reason() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The timer may not have caught up with the deadline yet
+  if (timed_out_ || (!cancelled_ && Clock::now() >= deadline_)) {
+    auto seconds =
+        std::chrono::duration_cast<std::chrono::seconds>(timeout_).count();
+    return "Call timed out after " + std::to_string(seconds) +
+           (seconds == 1 ? " second" : " seconds");
+  }
+  return "Call cancelled";
+}
+
+int CallContext::cap_timeout(int timeout_seconds) const {
+  if (deadline_ == Clock::time_point::max()) {
+    return timeout_seconds;
+  }
+  auto left = std::chrono::duration_cast<std::chrono::seconds>(
+                  deadline_ - Clock::now() + std::chrono::milliseconds(999))
+                  .count();
+  return static_cast<int>(
+      std::max<long long>(1, std::min<long long>(timeout_seconds, left)));
+}
+
+bool CallContext::wait_for(Clock::duration duration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !cancelled_cv_.wait_for(lock, duration, [this] { return cancelled_; });
+}
+
+// =============================================================================
+// CallContext::Scope
+// =============================================================================
+
+CallContext::Scope::Scope(CallContext* context) : previous_(current_context) {
+  current_context = context;
+}
+
+CallContext::Scope::~Scope() { current_context = previous_; }
+
+// =============================================================================
+// CallContext::Link
+// =============================================================================
+
+CallContext::Link::Link(CallContext* context,
+                        HttpClient::RequestControl* control)
+    : context_(control ? context : nullptr), control_(control) {
+  if (!context_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(context_->mutex_);
+  if (context_->cancelled_) {
+    control_->cancel();
+  }
+  context_->controls_.push_back(control_);
+}
+
+CallContext::Link::~Link() {
+  if (!context_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(context_->mutex_);
+  auto& controls = context_->controls_;
+  auto found = std::find(controls.begin(), controls.end(), control_);
+  if (found != controls.end()) {
+    controls.erase(found);
+  }
+}
+
+}  // namespace vsql_ai
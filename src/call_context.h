@@ -0,0 +1,124 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_CALL_CONTEXT_H
+#define VSQL_AI_CALL_CONTEXT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "http_client.h"
+
+namespace vsql_ai {
+
+// Deadline and cancellation for one SQL function call. The call's thread
+// installs its context with a Scope; provider requests made on its behalf,
+// on that thread or in WorkerPool::parallel_for() tasks, pick it up through
+// current(). Every attempt's timeout is capped at the time left, retries and
+// rate limit waits give up at the deadline, and cancel() aborts requests in
+// flight, so a call never holds a server thread past its deadline.
+class CallContext {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // A zero timeout means no deadline
+  explicit CallContext(Clock::duration timeout);
+  ~CallContext();
+
+  CallContext(const CallContext&) = delete;
+  CallContext& operator=(const CallContext&) = delete;
+
+  // The context installed on this thread, or nullptr outside any call
+  static CallContext* current();
+
+  // Installs a context on the current thread until destroyed. The context
+  // may be null, e.g. to carry "no call" into a worker task.
+  class Scope {
+   public:
+    explicit Scope(CallContext* context);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    CallContext* previous_;
+  };
+
+  // Ties a request's control to the call while the link lives: cancelling
+  // the call cancels the control, at once if the call is already over.
+  // Either pointer may be null, which makes the link a no-op.
+  class Link {
+   public:
+    Link(CallContext* context, HttpClient::RequestControl* control);
+    ~Link();
+
+    Link(const Link&) = delete;
+    Link& operator=(const Link&) = delete;
+
+   private:
+    CallContext* context_;
+    HttpClient::RequestControl* control_;
+  };
+
+  // Clock::time_point::max() without a deadline
+  Clock::time_point deadline() const { return deadline_; }
+
+  // Abort the call's requests in flight; later ones fail at once. Safe to
+  // call from any thread. This is the hook for a server-side kill.
+  void cancel();
+
+  // Cancelled, or past the deadline
+  bool cancelled() const;
+
+  // Why requests fail once the call is cancelled, e.g. "Call timed out
+  // after 5 seconds"
+  std::string cancel_reason() const;
+
+  // timeout_seconds, lowered to the whole seconds left before the deadline
+  // (at least 1, as socket timeouts cannot be shorter)
+  int cap_timeout(int timeout_seconds) const;
+
+  // Sleep for up to duration; returns false early if cancelled
+  bool wait_for(Clock::duration duration);
+
+ private:
+  friend class DeadlineTimer;
+
+  // Called by the timer once the deadline passes
+  void expire();
+
+  Clock::duration timeout_;
+  Clock::time_point deadline_;
+
+  // Guarded by the timer's lock
+  std::multimap<Clock::time_point, CallContext*>::iterator timer_entry_;
+  bool timer_armed_ = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cancelled_cv_;
+  bool cancelled_ = false;
+  bool timed_out_ = false;
+  std::vector<HttpClient::RequestControl*> controls_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_CALL_CONTEXT_H
@@ -0,0 +1,55 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cstdlib>
+
+namespace vsql_ai {
+
+namespace {
+
+const char* lookup(const std::string& name) {
+  std::string variable = "VSQL_AI_" + name;
+  return std::getenv(variable.c_str());
+}
+
+}  // namespace
+
+long config_int(const std::string& name, long default_value) {
+  const char* value = lookup(name);
+  if (value == nullptr || *value == '\0') {
+    return default_value;
+  }
+
+  char* end = nullptr;
+  long parsed = std::strtol(value, &end, 10);
+  if (*end != '\0') {
+    return default_value;
+  }
+  return parsed;
+}
+
+std::string config_string(const std::string& name,
+                          const std::string& default_value) {
+  const char* value = lookup(name);
+  if (value == nullptr) {
+    return default_value;
+  }
+  return value;
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,38 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_CONFIG_H
+#define VSQL_AI_CONFIG_H
+
+#include <string>
+
+namespace vsql_ai {
+
+// Extension settings come from VSQL_AI_* environment variables of the server
+// process, so they apply to every session. `name` excludes the prefix, e.g.
+// config_int("MAX_CONNECTIONS_PER_HOST", 16) reads
+// VSQL_AI_MAX_CONNECTIONS_PER_HOST.
+
+// Returns default_value if the variable is unset or not an integer
+long config_int(const std::string& name, long default_value);
+
+// Returns default_value if the variable is unset
+std::string config_string(const std::string& name,
+                          const std::string& default_value);
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_CONFIG_H
@@ -0,0 +1,233 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "httplib.h"
+
+#include "connection_pool.h"
+
+#include <utility>
+
+#include "config.h"
+#include "dns_cache.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Provider APIs are served from a single host each, so this bounds the number
+// of sockets a busy server keeps open to any one of them.
+constexpr size_t kDefaultMaxConnectionsPerHost = 16;
+
+// Provider load balancers typically drop idle keep-alive connections after
+// about a minute; evict a bit earlier so we rarely reuse a dead socket.
+constexpr std::chrono::seconds kDefaultIdleTimeout{30};
+
+}  // namespace
+
+// =============================================================================
+// ConnectionPool::Lease
+// =============================================================================
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, HostPool* host_pool,
+                             std::unique_ptr<httplib::Client> client)
+    : pool_(pool), host_pool_(host_pool), client_(std::move(client)) {}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_),
+      host_pool_(other.host_pool_),
+      client_(std::move(other.client_)),
+      reusable_(other.reusable_) {
+  other.pool_ = nullptr;
+}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(
+    Lease&& other) noexcept {
+  if (this != &other) {
+    release();
+    pool_ = other.pool_;
+    host_pool_ = other.host_pool_;
+    client_ = std::move(other.client_);
+    reusable_ = other.reusable_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+ConnectionPool::Lease::~Lease() { release(); }
+
+void ConnectionPool::Lease::release() {
+  if (pool_ && client_) {
+    pool_->release(host_pool_, std::move(client_), reusable_);
+  }
+  pool_ = nullptr;
+}
+
+// =============================================================================
+// ConnectionPool
+// =============================================================================
+
+ConnectionPool& ConnectionPool::instance() {
+  static ConnectionPool pool;
+  return pool;
+}
+
+ConnectionPool::ConnectionPool()
+    : max_connections_per_host_(kDefaultMaxConnectionsPerHost),
+      idle_timeout_(kDefaultIdleTimeout) {
+  set_max_connections_per_host(static_cast<size_t>(config_int(
+      "MAX_CONNECTIONS_PER_HOST", kDefaultMaxConnectionsPerHost)));
+  set_idle_timeout(std::chrono::seconds(
+      config_int("IDLE_CONNECTION_TIMEOUT", kDefaultIdleTimeout.count())));
+}
+
+ConnectionPool::~ConnectionPool() {}
+
+ConnectionPool::Lease ConnectionPool::acquire(
+    const HttpClient::Endpoint& endpoint, int wait_seconds,
+    std::string* error) {
+  std::vector<std::unique_ptr<httplib::Client>> expired;
+  std::unique_ptr<httplib::Client> client;
+  HostPool* host_pool_ptr;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // The heterogeneous lookup only copies the key the first time a host is
+    // seen
+    auto found = hosts_.find(endpoint.key);
+    if (found == hosts_.end()) {
+      found = hosts_.emplace(endpoint.key, HostPool()).first;
+    }
+    HostPool& host_pool = found->second;
+    host_pool_ptr = &host_pool;
+    auto deadline = Clock::now() + std::chrono::seconds(wait_seconds);
+
+    while (true) {
+      collect_expired(&host_pool, Clock::now(), &expired);
+
+      // Reuse the most recently returned client; its socket is the least
+      // likely to have been closed by the server.
+      if (!host_pool.idle.empty()) {
+        client = std::move(host_pool.idle.back().client);
+        host_pool.idle.pop_back();
+        break;
+      }
+
+      if (host_pool.open < max_connections_per_host_) {
+        host_pool.open++;
+        break;
+      }
+
+      if (available_.wait_until(lock, deadline) == std::cv_status::timeout &&
+          host_pool.idle.empty() &&
+          host_pool.open >= max_connections_per_host_) {
+        *error = "Connection pool exhausted for " + endpoint.key;
+        return Lease();
+      }
+    }
+  }
+
+  // Expired clients are closed outside the lock; shutting down a TLS socket
+  // can block.
+  expired.clear();
+
+  if (!client) {
+    client = std::make_unique<httplib::Client>(endpoint.key);
+    client->set_keep_alive(true);
+    client->set_tcp_nodelay(true);
+    // HttpClient decodes compressed bodies itself
+    client->set_decompress(false);
+
+    // Connect to the cached address instead of resolving the host on every
+    // connect. Should that fail, httplib resolves it and reports the error.
+    DnsCache::Address address;
+    std::string ignored;
+    if (DnsCache::instance().resolve(endpoint.host, endpoint.port, &address,
+                                     &ignored)) {
+      client->set_hostname_addr_map({{endpoint.host, address.ip}});
+    }
+
+    if (!client->is_valid()) {
+      release(host_pool_ptr, std::move(client), false);
+      *error = "Failed to create HTTP client for " + endpoint.key;
+      return Lease();
+    }
+  }
+
+  return Lease(this, host_pool_ptr, std::move(client));
+}
+
+void ConnectionPool::release(HostPool* host_pool_ptr,
+                             std::unique_ptr<httplib::Client> client,
+                             bool reusable) {
+  std::vector<std::unique_ptr<httplib::Client>> expired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    HostPool& host_pool = *host_pool_ptr;
+    auto now = Clock::now();
+
+    if (reusable && host_pool.open <= max_connections_per_host_) {
+      host_pool.idle.push_back({std::move(client), now});
+    } else {
+      expired.push_back(std::move(client));
+      host_pool.open--;
+    }
+    collect_expired(&host_pool, now, &expired);
+  }
+  available_.notify_one();
+}
+
+void ConnectionPool::collect_expired(
+    HostPool* host_pool, Clock::time_point now,
+    std::vector<std::unique_ptr<httplib::Client>>* expired) {
+  auto& idle = host_pool->idle;
+  size_t kept = 0;
+  for (size_t i = 0; i < idle.size(); i++) {
+    if (now - idle[i].last_used >= idle_timeout_) {
+      expired->push_back(std::move(idle[i].client));
+      host_pool->open--;
+    } else {
+      idle[kept++] = std::move(idle[i]);
+    }
+  }
+  idle.resize(kept);
+}
+
+void ConnectionPool::set_max_connections_per_host(size_t max_connections) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_connections_per_host_ = max_connections > 0 ? max_connections : 1;
+}
+
+void ConnectionPool::set_idle_timeout(std::chrono::seconds idle_timeout) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_timeout_ = idle_timeout;
+}
+
+void ConnectionPool::clear() {
+  std::vector<std::unique_ptr<httplib::Client>> closed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : hosts_) {
+      for (auto& idle_client : entry.second.idle) {
+        closed.push_back(std::move(idle_client.client));
+        entry.second.open--;
+      }
+      entry.second.idle.clear();
+    }
+  }
+  available_.notify_all();
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,129 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_CONNECTION_POOL_H
+#define VSQL_AI_CONNECTION_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "http_client.h"
+
+namespace httplib {
+class Client;
+}
+
+namespace vsql_ai {
+
+// Process-wide pool of keep-alive HTTP clients keyed by (scheme, host, port).
+//
+// Each leased client is used by exactly one thread at a time. Returning it to
+// the pool keeps its socket (and TLS session) open so the next request to the
+// same endpoint skips the TCP connect and TLS handshake. Idle clients are
+// evicted lazily on acquire/release once they exceed the idle timeout.
+class ConnectionPool {
+ private:
+  struct HostPool;
+
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // RAII handle to a pooled client. The client goes back to the pool when the
+  // lease is destroyed, unless discard() was called.
+  class Lease {
+   public:
+    Lease() = default;
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    httplib::Client* operator->() const { return client_.get(); }
+    httplib::Client& operator*() const { return *client_; }
+    explicit operator bool() const { return client_ != nullptr; }
+
+    // Close the connection instead of returning it to the pool (e.g. after a
+    // transport error left the socket in an unknown state).
+    void discard() { reusable_ = false; }
+
+   private:
+    friend class ConnectionPool;
+    Lease(ConnectionPool* pool, HostPool* host_pool,
+          std::unique_ptr<httplib::Client> client);
+    void release();
+
+    ConnectionPool* pool_ = nullptr;
+    HostPool* host_pool_ = nullptr;
+    std::unique_ptr<httplib::Client> client_;
+    bool reusable_ = true;
+  };
+
+  static ConnectionPool& instance();
+
+  // Lease a client for the given endpoint, opening a new one if no idle
+  // client is available and the per-host limit allows it. Otherwise waits up
+  // to wait_seconds for another thread to release one. Returns an empty lease
+  // and sets *error on failure.
+  Lease acquire(const HttpClient::Endpoint& endpoint, int wait_seconds,
+                std::string* error);
+
+  // Configure the pool. Applies to subsequent acquires.
+  void set_max_connections_per_host(size_t max_connections);
+  void set_idle_timeout(std::chrono::seconds idle_timeout);
+
+  // Close all idle connections.
+  void clear();
+
+ private:
+  struct IdleClient {
+    std::unique_ptr<httplib::Client> client;
+    Clock::time_point last_used;
+  };
+
+  struct HostPool {
+    std::vector<IdleClient> idle;  // most recently used at the back
+    size_t open = 0;               // idle + leased
+  };
+
+  ConnectionPool();
+  ~ConnectionPool();
+
+  void release(HostPool* host_pool, std::unique_ptr<httplib::Client> client,
+               bool reusable);
+
+  // Move idle clients past the idle timeout into *expired. Caller holds mutex_.
+  void collect_expired(HostPool* host_pool, Clock::time_point now,
+                       std::vector<std::unique_ptr<httplib::Client>>* expired);
+
+  std::mutex mutex_;
+  std::condition_variable available_;
+  // Entries are never erased, so leases can hold on to their HostPool
+  std::map<std::string, HostPool, std::less<>> hosts_;
+  size_t max_connections_per_host_;
+  std::chrono::seconds idle_timeout_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_CONNECTION_POOL_H
@@ -0,0 +1,264 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "content_encoding.h"
+
+#ifdef VSQL_AI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef VSQL_AI_HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include "ascii_util.h"
+
+namespace vsql_ai {
+
+namespace {
+
+constexpr size_t kDecodeBytes = 16 * 1024;
+
+}  // namespace
+
+// =============================================================================
+// ContentDecoder
+// =============================================================================
+
+struct ContentDecoder::State {
+#ifdef VSQL_AI_HAVE_ZLIB
+  z_stream zlib{};
+  bool zlib_ready = false;
+#endif
+#ifdef VSQL_AI_HAVE_BROTLI
+  BrotliDecoderState* brotli = nullptr;
+#endif
+
+  ~State() {
+#ifdef VSQL_AI_HAVE_ZLIB
+    if (zlib_ready) {
+      inflateEnd(&zlib);
+    }
+#endif
+#ifdef VSQL_AI_HAVE_BROTLI
+    if (brotli) {
+      BrotliDecoderDestroyInstance(brotli);
+    }
+#endif
+  }
+};
+
+ContentDecoder::ContentDecoder() {}
+
+ContentDecoder::~ContentDecoder() {}
+
+const char* ContentDecoder::accept_encoding() {
+#if defined(VSQL_AI_HAVE_BROTLI) && defined(VSQL_AI_HAVE_ZLIB)
+  return "br, gzip, deflate";
+#elif defined(VSQL_AI_HAVE_BROTLI)
+  return "br";
+#elif defined(VSQL_AI_HAVE_ZLIB)
+  return "gzip, deflate";
+#else
+  return "";
+#endif
+}
+
+bool ContentDecoder::reset(std::string_view encoding) {
+  kind_ = Kind::kIdentity;
+  if (encoding.empty() || equals_ignore_case(encoding, "identity")) {
+    return true;
+  }
+  if (!state_) {
+    state_ = std::make_unique<State>();
+  }
+
+#ifdef VSQL_AI_HAVE_ZLIB
+  if (equals_ignore_case(encoding, "gzip") ||
+      equals_ignore_case(encoding, "x-gzip") ||
+      equals_ignore_case(encoding, "deflate")) {
+    // 15 + 32: the largest window, with a gzip or zlib header detected
+    // automatically
+    if (state_->zlib_ready) {
+      if (inflateReset(&state_->zlib) != Z_OK) {
+        return false;
+      }
+    } else {
+      if (inflateInit2(&state_->zlib, 15 + 32) != Z_OK) {
+        return false;
+      }
+      state_->zlib_ready = true;
+    }
+    kind_ = Kind::kZlib;
+    return true;
+  }
+#endif
+
+#ifdef VSQL_AI_HAVE_BROTLI
+  if (equals_ignore_case(encoding, "br")) {
+    if (state_->brotli) {
+      BrotliDecoderDestroyInstance(state_->brotli);
+    }
+    state_->brotli = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    if (!state_->brotli) {
+      return false;
+    }
+    kind_ = Kind::kBrotli;
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+bool ContentDecoder::decode(const char* data, size_t length,
+                            std::string* output) {
+  switch (kind_) {
+    case Kind::kIdentity:
+      output->append(data, length);
+      return true;
+
+    case Kind::kZlib: {
+#ifdef VSQL_AI_HAVE_ZLIB
+      z_stream& zlib = state_->zlib;
+      zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      zlib.avail_in = static_cast<uInt>(length);
+      char buffer[kDecodeBytes];
+      // A full output buffer may leave more output pending inside zlib
+      do {
+        zlib.next_out = reinterpret_cast<Bytef*>(buffer);
+        zlib.avail_out = sizeof(buffer);
+        int result = inflate(&zlib, Z_NO_FLUSH);
+        output->append(buffer, sizeof(buffer) - zlib.avail_out);
+        if (result == Z_STREAM_END || result == Z_BUF_ERROR) {
+          return true;  // done, or waiting for more input
+        }
+        if (result != Z_OK) {
+          return false;
+        }
+      } while (zlib.avail_in > 0 || zlib.avail_out == 0);
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    case Kind::kBrotli: {
+#ifdef VSQL_AI_HAVE_BROTLI
+      auto* next_in = reinterpret_cast<const uint8_t*>(data);
+      size_t available_in = length;
+      uint8_t buffer[kDecodeBytes];
+      while (true) {
+        uint8_t* next_out = buffer;
+        size_t available_out = sizeof(buffer);
+        BrotliDecoderResult result = BrotliDecoderDecompressStream(
+            state_->brotli, &available_in, &next_in, &available_out, &next_out,
+            nullptr);
+        output->append(reinterpret_cast<const char*>(buffer),
+                       sizeof(buffer) - available_out);
+        if (result == BROTLI_DECODER_RESULT_ERROR) {
+          return false;
+        }
+        if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+          return true;
+        }
+      }
+#else
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+// =============================================================================
+// BodyReceiver
+// =============================================================================
+
+void BodyReceiver::reset(HttpClient::Response* response,
+                         const HttpClient::ChunkHandler* on_chunk) {
+  response_ = response;
+  on_chunk_ = on_chunk;
+  error_.clear();
+  sent_at_ = std::chrono::steady_clock::now();
+  stopped_ = false;
+}
+
+bool BodyReceiver::start() {
+  response_->first_byte = std::chrono::steady_clock::now() - sent_at_;
+  std::string encoding = response_->header("content-encoding");
+  if (!decoder_.reset(encoding)) {
+    error_ = "Unsupported content encoding: " + encoding;
+    return false;
+  }
+  return true;
+}
+
+bool BodyReceiver::receive(const char* data, size_t length) {
+  if (length == 0) {
+    return !stopped_ && error_.empty();
+  }
+  response_->bytes_received += length;
+  if (decoder_.identity()) {
+    return deliver(data, length);
+  }
+
+  decoded_.clear();
+  if (!decoder_.decode(data, length, &decoded_)) {
+    error_ = "Compression error";
+    return false;
+  }
+  return deliver(decoded_.data(), decoded_.size());
+}
+
+bool BodyReceiver::deliver(const char* data, size_t length) {
+  response_->bytes_decoded += length;
+  if (length == 0) {
+    return true;
+  }
+  if (on_chunk_ && *on_chunk_ && response_->is_success()) {
+    if (!(*on_chunk_)(data, length)) {
+      stopped_ = true;
+      return false;
+    }
+    return true;
+  }
+  response_->body.append(data, length);
+  return true;
+}
+
+// =============================================================================
+// TransferCounters
+// =============================================================================
+
+void TransferCounters::record(const HttpClient::Response& response) {
+  bytes_received_.fetch_add(response.bytes_received,
+                            std::memory_order_relaxed);
+  bytes_decoded_.fetch_add(response.bytes_decoded, std::memory_order_relaxed);
+}
+
+TransferStats TransferCounters::stats() const {
+  TransferStats stats;
+  stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  stats.bytes_decoded = bytes_decoded_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void TransferCounters::reset() {
+  bytes_received_.store(0, std::memory_order_relaxed);
+  bytes_decoded_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,115 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_CONTENT_ENCODING_H
+#define VSQL_AI_CONTENT_ENCODING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "http_client.h"
+
+namespace vsql_ai {
+
+// Streaming decoder for a response's Content-Encoding. gzip and deflate need
+// the WITH_ZLIB build option and br needs WITH_BROTLI; a build with neither
+// only accepts identity bodies.
+class ContentDecoder {
+ public:
+  ContentDecoder();
+  ~ContentDecoder();
+
+  // Accept-Encoding value offered to servers, e.g. "br, gzip, deflate", or
+  // "" if this build decodes nothing
+  static const char* accept_encoding();
+
+  // Prepare for a body in the given encoding; "" and "identity" pass
+  // through. Returns false for an encoding this build cannot decode.
+  bool reset(std::string_view encoding);
+
+  bool identity() const { return kind_ == Kind::kIdentity; }
+
+  // Decode the next piece of the body, appending to *output. Returns false
+  // if the data is corrupt.
+  bool decode(const char* data, size_t length, std::string* output);
+
+ private:
+  enum class Kind { kIdentity, kZlib, kBrotli };
+  struct State;
+
+  Kind kind_ = Kind::kIdentity;
+  std::unique_ptr<State> state_;  // kept across responses
+};
+
+// Where a response body goes as it arrives, shared by both HTTP backends:
+// decoded, then handed to the chunk handler for 2xx responses or buffered in
+// Response::body otherwise. Counts the body bytes in the Response before and
+// after decoding, and the time to the response headers.
+class BodyReceiver {
+ public:
+  // Call as the request is sent
+  void reset(HttpClient::Response* response,
+             const HttpClient::ChunkHandler* on_chunk);
+
+  // Call once the final response's headers are in. Returns false, with
+  // error() set, if the body's encoding cannot be decoded.
+  bool start();
+
+  // Returns false once no more of the body should be read: the chunk
+  // handler stopped, or decoding failed and error() is set
+  bool receive(const char* data, size_t length);
+
+  bool stopped() const { return stopped_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool deliver(const char* data, size_t length);
+
+  HttpClient::Response* response_ = nullptr;
+  const HttpClient::ChunkHandler* on_chunk_ = nullptr;
+  ContentDecoder decoder_;
+  std::string decoded_;
+  std::string error_;
+  std::chrono::steady_clock::time_point sent_at_;
+  bool stopped_ = false;
+};
+
+// Cumulative response body bytes for one provider
+struct TransferStats {
+  uint64_t bytes_received = 0;  // as sent by the server
+  uint64_t bytes_decoded = 0;   // after Content-Encoding decoding
+};
+
+class TransferCounters {
+ public:
+  void record(const HttpClient::Response& response);
+
+  TransferStats stats() const;
+  void reset();
+
+ private:
+  std::atomic<uint64_t> bytes_received_{0};
+  std::atomic<uint64_t> bytes_decoded_{0};
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_CONTENT_ENCODING_H
@@ -0,0 +1,95 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "dns_cache.h"
+
+#include <netdb.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "config.h"
+
+namespace vsql_ai {
+
+namespace {
+
+constexpr long kDefaultTtl = 60;
+
+}  // namespace
+
+DnsCache& DnsCache::instance() {
+  static DnsCache cache;
+  return cache;
+}
+
+DnsCache::DnsCache()
+    : ttl_(std::max(0L, config_int("DNS_CACHE_TTL", kDefaultTtl))) {}
+
+bool DnsCache::resolve(const std::string& host, int port, Address* address,
+                       std::string* error) {
+  std::string key = host + ":" + std::to_string(port);
+  auto now = Clock::now();
+  bool stale = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+      auto age = now - found->second.resolved_at;
+      if (age < ttl_) {
+        *address = found->second.address;
+        return true;
+      }
+      if (age < 2 * ttl_) {
+        *address = found->second.address;
+        stale = true;
+      }
+    }
+  }
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;  // no IPv6 addresses on an IPv4-only host
+  addrinfo* results = nullptr;
+  auto lookup_start = Clock::now();
+  int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                           &results);
+  lookups_.record(Clock::now() - lookup_start);
+  if (status != 0 || !results) {
+    if (stale) {
+      return true;
+    }
+    *error = "Connection failed";
+    return false;
+  }
+
+  Address resolved;
+  memcpy(&resolved.storage, results->ai_addr, results->ai_addrlen);
+  resolved.length = results->ai_addrlen;
+  getnameinfo(results->ai_addr, results->ai_addrlen, resolved.ip,
+              sizeof(resolved.ip), nullptr, 0, NI_NUMERICHOST);
+  freeaddrinfo(results);
+  *address = resolved;
+
+  if (ttl_.count() > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[key] = {resolved, now};
+  }
+  return true;
+}
+
+}  // namespace vsql_ai
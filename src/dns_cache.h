@@ -0,0 +1,75 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_DNS_CACHE_H
+#define VSQL_AI_DNS_CACHE_H
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "metrics.h"
+
+namespace vsql_ai {
+
+// Process-wide cache of resolved provider addresses, shared by both HTTP
+// backends, so that opening a connection does not wait on getaddrinfo.
+//
+// getaddrinfo does not report record TTLs, so an entry is trusted for
+// VSQL_AI_DNS_CACHE_TTL seconds (default 60; 0 disables the cache). If
+// resolving again fails, the expired address keeps being used for up to
+// as long again rather than failing the request.
+class DnsCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Address {
+    sockaddr_storage storage;
+    socklen_t length = 0;
+    char ip[INET6_ADDRSTRLEN] = {};  // numeric form, e.g. "160.79.104.10"
+  };
+
+  static DnsCache& instance();
+
+  // Look up host:port, from the cache while the entry is fresh. Blocks
+  // while resolving. Returns false and sets *error on failure.
+  bool resolve(const std::string& host, int port, Address* address,
+               std::string* error);
+
+  // Time spent in getaddrinfo, i.e. on cache misses
+  LatencyHistogram& lookups() { return lookups_; }
+
+ private:
+  struct Entry {
+    Address address;
+    Clock::time_point resolved_at;
+  };
+
+  DnsCache();
+
+  std::chrono::seconds ttl_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;  // by host:port
+  LatencyHistogram lookups_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_DNS_CACHE_H
@@ -0,0 +1,310 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "embedding_store.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
+#include "config.h"
+#include "hash_util.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Segment files are created sparse at full size and mapped once; disk usage
+// grows only as records are appended.
+constexpr size_t kSegmentBytes = 64 * 1024 * 1024;
+constexpr long kDefaultMaxBytes = 4L * 1024 * 1024 * 1024;
+
+constexpr char kSegmentMagic[8] = {'V', 'S', 'Q', 'L', 'E', 'M', 'B', '1'};
+constexpr size_t kSegmentHeaderBytes = 64;
+
+constexpr uint32_t kRecordMagic = 0x56454331;  // "VEC1"
+constexpr uint32_t kMaxDimensions = 65536;
+
+// Fixed-size header in front of each record's float payload. The magic is
+// written last, so a record only becomes visible to a later scan once its
+// payload is in place.
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t dimensions;
+  uint64_t key;
+  uint32_t checksum;  // of the payload
+  uint32_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 24, "record header must stay packed");
+
+size_t record_bytes(uint32_t dimensions) {
+  return sizeof(RecordHeader) + dimensions * sizeof(float);
+}
+
+// FNV-1a over 32-bit words
+uint32_t checksum(const float* values, size_t count) {
+  uint32_t hash = 2166136261u;
+  const char* bytes = reinterpret_cast<const char*>(values);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t word;
+    memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+    hash = (hash ^ word) * 16777619u;
+  }
+  return hash;
+}
+
+std::string segment_path(const std::string& directory, uint32_t number) {
+  char name[32];
+  snprintf(name, sizeof(name), "segment-%06u.vec", number);
+  return directory + "/" + name;
+}
+
+}  // namespace
+
+EmbeddingStore& EmbeddingStore::instance() {
+  static EmbeddingStore store;
+  return store;
+}
+
+EmbeddingStore::EmbeddingStore() {
+  std::string directory = config_string("EMBEDDING_CACHE_DIR", "");
+  long max_bytes = config_int("EMBEDDING_CACHE_MAX_BYTES", kDefaultMaxBytes);
+  max_segments_ = std::max<size_t>(
+      1, static_cast<size_t>(std::max(0L, max_bytes)) / kSegmentBytes);
+
+  if (!directory.empty()) {
+    enabled_ = open(directory);
+  }
+
+  if (!enabled_) {
+    // Leave the store disabled; embeddings are still served by the provider
+    for (auto& segment : segments_) {
+      munmap(segment.base, kSegmentBytes);
+      close(segment.fd);
+    }
+    segments_.clear();
+    index_.clear();
+  }
+}
+
+EmbeddingStore::~EmbeddingStore() {
+  for (auto& segment : segments_) {
+    msync(segment.base, kSegmentBytes, MS_ASYNC);
+    munmap(segment.base, kSegmentBytes);
+    close(segment.fd);
+  }
+  if (lock_fd_ >= 0) {
+    close(lock_fd_);
+  }
+}
+
+bool EmbeddingStore::open(const std::string& directory) {
+  directory_ = directory;
+  if (mkdir(directory.c_str(), 0750) != 0 && errno != EEXIST) {
+    return false;
+  }
+
+  // Segments are written without coordination, so only one server process
+  // may use a directory at a time
+  lock_fd_ = ::open((directory + "/LOCK").c_str(), O_RDWR | O_CREAT, 0640);
+  if (lock_fd_ < 0 || flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+    return false;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  uint32_t number = 0;
+  while (number < max_segments_ && map_segment(number, false)) {
+    scan_segment(number);
+    number++;
+  }
+
+  if (segments_.empty()) {
+    return map_segment(0, true);
+  }
+  return true;
+}
+
+bool EmbeddingStore::map_segment(uint32_t number, bool create) {
+  std::string path = segment_path(directory_, number);
+  int flags = O_RDWR | (create ? O_CREAT | O_EXCL : 0);
+  int fd = ::open(path.c_str(), flags, 0640);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (create && ftruncate(fd, kSegmentBytes) != 0) {
+    close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != kSegmentBytes) {
+    close(fd);
+    return false;
+  }
+
+  void* base =
+      mmap(nullptr, kSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  Segment segment;
+  segment.fd = fd;
+  segment.base = static_cast<char*>(base);
+
+  if (create) {
+    memcpy(segment.base, kSegmentMagic, sizeof(kSegmentMagic));
+  } else if (memcmp(segment.base, kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+    munmap(base, kSegmentBytes);
+    close(fd);
+    return false;
+  }
+
+  segment.used = kSegmentHeaderBytes;
+  segments_.push_back(segment);
+  return true;
+}
+
+void EmbeddingStore::scan_segment(uint32_t number) {
+  Segment& segment = segments_[number];
+  size_t offset = kSegmentHeaderBytes;
+
+  while (offset + sizeof(RecordHeader) <= kSegmentBytes) {
+    RecordHeader header;
+    memcpy(&header, segment.base + offset, sizeof(header));
+
+    // Zeroed space or a torn record ends the segment; appends resume here
+    if (header.magic != kRecordMagic || header.dimensions == 0 ||
+        header.dimensions > kMaxDimensions ||
+        offset + record_bytes(header.dimensions) > kSegmentBytes) {
+      break;
+    }
+
+    auto* values = reinterpret_cast<const float*>(segment.base + offset +
+                                                  sizeof(RecordHeader));
+    if (checksum(values, header.dimensions) != header.checksum) {
+      break;
+    }
+
+    index_[header.key] = {number, header.dimensions,
+                          offset + sizeof(RecordHeader)};
+    bytes_ += record_bytes(header.dimensions);
+    offset += record_bytes(header.dimensions);
+  }
+
+  segment.used = offset;
+}
+
+uint64_t EmbeddingStore::make_key(std::string_view provider,
+                                  std::string_view model,
+                                  std::string_view text) {
+  std::hash<std::string_view> hasher;
+  uint64_t key = hasher(text);
+  key = hash_combine(key, text.size());
+  key = hash_combine(key, hasher(provider));
+  key = hash_combine(key, hasher(model));
+  return key;
+}
+
+bool EmbeddingStore::get(uint64_t key, std::vector<float>* values) {
+  if (!enabled()) {
+    return false;
+  }
+
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found == index_.end()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const Location& location = found->second;
+  auto* payload = reinterpret_cast<const float*>(
+      segments_[location.segment].base + location.offset);
+  values->assign(payload, payload + location.dimensions);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void EmbeddingStore::put(uint64_t key, const std::vector<float>& values) {
+  if (!enabled() || values.empty() || values.size() > kMaxDimensions) {
+    return;
+  }
+
+  auto dimensions = static_cast<uint32_t>(values.size());
+  size_t size = record_bytes(dimensions);
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (full_ || index_.count(key) > 0) {
+    return;
+  }
+
+  // Roll over to a new segment when the current one is out of space
+  if (segments_.back().used + size > kSegmentBytes) {
+    if (segments_.size() >= max_segments_ ||
+        !map_segment(static_cast<uint32_t>(segments_.size()), true)) {
+      full_ = true;
+      return;
+    }
+  }
+
+  auto number = static_cast<uint32_t>(segments_.size() - 1);
+  Segment& segment = segments_.back();
+  size_t offset = segment.used;
+  char* record = segment.base + offset;
+
+  RecordHeader header;
+  header.magic = 0;
+  header.dimensions = dimensions;
+  header.key = key;
+  header.checksum = checksum(values.data(), values.size());
+  header.reserved = 0;
+
+  memcpy(record + sizeof(RecordHeader), values.data(),
+         values.size() * sizeof(float));
+  memcpy(record, &header, sizeof(header));
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(record, &kRecordMagic, sizeof(kRecordMagic));
+
+  segment.used = offset + size;
+  index_[key] = {number, dimensions, offset + sizeof(RecordHeader)};
+  bytes_ += size;
+}
+
+EmbeddingStore::Stats EmbeddingStore::stats() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.records = index_.size();
+  stats.bytes = bytes_;
+  return stats;
+}
+
+}  // namespace vsql_ai
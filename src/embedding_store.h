@@ -0,0 +1,105 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_EMBEDDING_STORE_H
+#define VSQL_AI_EMBEDDING_STORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vsql_ai {
+
+// Optional persistent cache of embedding vectors, enabled by setting
+// VSQL_AI_EMBEDDING_CACHE_DIR.
+//
+// Vectors are stored as raw float32 in append-only, memory-mapped segment
+// files (segment-NNNNNN.vec). Each record carries its key and a checksum, so
+// the in-memory hash index is rebuilt by scanning the segments at startup and
+// a record torn by a crash is simply dropped. Once the size limit is reached
+// new embeddings are no longer stored; delete the directory to reset it.
+class EmbeddingStore {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t records = 0;
+    size_t bytes = 0;
+  };
+
+  static EmbeddingStore& instance();
+
+  // Embeddings are a pure function of model and text, so unlike the response
+  // cache the API key is not part of the key; entries stay valid across key
+  // rotation and failover.
+  static uint64_t make_key(std::string_view provider, std::string_view model,
+                           std::string_view text);
+
+  bool enabled() const { return enabled_; }
+
+  // Returns true and fills *values on a hit
+  bool get(uint64_t key, std::vector<float>* values);
+
+  void put(uint64_t key, const std::vector<float>& values);
+
+  Stats stats();
+
+ private:
+  struct Segment {
+    int fd = -1;
+    char* base = nullptr;
+    size_t used = 0;
+  };
+
+  struct Location {
+    uint32_t segment;
+    uint32_t dimensions;
+    uint64_t offset;  // of the payload within the segment
+  };
+
+  EmbeddingStore();
+  ~EmbeddingStore();
+
+  bool open(const std::string& directory);
+  bool map_segment(uint32_t number, bool create);
+
+  // Index the valid records of a freshly mapped segment. Caller holds the
+  // exclusive lock.
+  void scan_segment(uint32_t number);
+
+  std::shared_mutex mutex_;
+  std::string directory_;
+  std::vector<Segment> segments_;
+  std::unordered_map<uint64_t, Location> index_;
+  size_t max_segments_ = 0;
+  bool enabled_ = false;
+  bool full_ = false;
+  int lock_fd_ = -1;
+
+  // Bumped under the shared lock, hence atomic
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  size_t bytes_ = 0;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_EMBEDDING_STORE_H
@@ -0,0 +1,136 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_FLOAT_CHARS_H
+#define VSQL_AI_FLOAT_CHARS_H
+
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace vsql_ai {
+
+// Float <-> text conversion for JSON numbers. std::from_chars and
+// std::to_chars are used where the standard library implements them for
+// floating point, which __cpp_lib_to_chars advertises. Apple's libc++ does
+// not, so there the C library does the work: strtof on a bounded copy,
+// since the input is not null-terminated, and printf with enough digits to
+// round-trip. Both rely on LC_NUMERIC staying "C" for the '.' separator.
+
+namespace float_chars_detail {
+
+inline bool is_number_char(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+         c == 'e' || c == 'E';
+}
+
+inline const char* strtof_bounded(const char* p, const char* end,
+                                  float* value) {
+  const char* token_end = p;
+  while (token_end < end && is_number_char(*token_end)) {
+    token_end++;
+  }
+  size_t length = static_cast<size_t>(token_end - p);
+  char buffer[64];
+  std::string long_token;
+  const char* text = buffer;
+  if (length < sizeof(buffer)) {
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+  } else {
+    long_token.assign(p, length);
+    text = long_token.c_str();
+  }
+
+  char* parsed_end;
+  errno = 0;
+  float parsed = strtof(text, &parsed_end);
+  // ERANGE also flags subnormal results, which round-trip; only overflow
+  // to infinity is out of range
+  if (parsed_end == text || (errno == ERANGE && std::isinf(parsed))) {
+    return nullptr;
+  }
+  *value = parsed;
+  return p + (parsed_end - text);
+}
+
+template <typename T>
+char* snprintf_bounded(char* p, char* end, T value, int digits) {
+  char buffer[32];
+  int length = snprintf(buffer, sizeof(buffer), "%.*g", digits,
+                        static_cast<double>(value));
+  if (length <= 0 || length > end - p) {
+    return nullptr;
+  }
+  memcpy(p, buffer, static_cast<size_t>(length));
+  return p + length;
+}
+
+}  // namespace float_chars_detail
+
+// Parse the number at the start of [p, end) into *value. Returns the end
+// of the number, or nullptr if there is none or it overflows a float.
+// Values too small for a float become the nearest subnormal or zero.
+// As in JSON, a leading '+', whitespace, hex, inf and nan are rejected.
+inline const char* parse_float(const char* p, const char* end, float* value) {
+  const char* digits = p < end && *p == '-' ? p + 1 : p;
+  if (digits == end ||
+      !((*digits >= '0' && *digits <= '9') || *digits == '.')) {
+    return nullptr;
+  }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto parsed = std::from_chars(p, end, *value);
+  if (parsed.ec == std::errc::result_out_of_range) {
+    // Also returned for values below the smallest subnormal, such as
+    // 1e-46. strtof tells them apart from overflow and rounds them to 0.
+    return float_chars_detail::strtof_bounded(p, end, value);
+  }
+  return parsed.ec == std::errc() ? parsed.ptr : nullptr;
+#else
+  return float_chars_detail::strtof_bounded(p, end, value);
+#endif
+}
+
+// Write the shortest text that round-trips value, or where to_chars is
+// missing 9 significant digits, which also round-trip. Returns the end of
+// the text, or nullptr if it does not fit. value must be finite.
+inline char* format_float(char* p, char* end, float value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto formatted = std::to_chars(p, end, value);
+  return formatted.ec == std::errc() ? formatted.ptr : nullptr;
+#else
+  return float_chars_detail::snprintf_bounded(p, end, value, 9);
+#endif
+}
+
+// The same for doubles, with 17 significant digits where to_chars is
+// missing
+inline char* format_double(char* p, char* end, double value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto formatted = std::to_chars(p, end, value);
+  return formatted.ec == std::errc() ? formatted.ptr : nullptr;
+#else
+  return float_chars_detail::snprintf_bounded(p, end, value, 17);
+#endif
+}
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_FLOAT_CHARS_H
@@ -0,0 +1,272 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hedging.h"
+
+#include <algorithm>
+
+#include "call_context.h"
+#include "config.h"
+#include "worker_pool.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Samples of time to headers kept per provider
+constexpr size_t kSampleWindow = 512;
+
+// No hedging until the percentile means something
+constexpr size_t kMinSamples = 64;
+
+// Recompute the hedge delay after this many new samples
+constexpr size_t kRecomputeEvery = 32;
+
+// Unused budget carries over, but only up to this many hedges, so a quiet
+// period cannot fund a burst of duplicates
+constexpr double kMaxBudget = 10;
+
+constexpr long kDefaultPercentile = 95;
+
+}  // namespace
+
+// State shared by the caller, the timer and the duplicate's worker task
+struct Hedger::Flight {
+  enum class Hedge { kNone, kQueued, kRunning, kDone };
+
+  Tracker* tracker;
+  const Attempt* attempt;  // the caller's; only used while the caller waits
+  CallContext* call;       // likewise
+  HttpClient::RequestControl original_control;
+  HttpClient::RequestControl hedge_control;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  Hedge hedge = Hedge::kNone;
+  bool original_done = false;
+  bool original_ok = false;
+  bool hedge_won = false;
+  HttpClient::Response hedge_response;
+};
+
+Hedger& Hedger::instance() {
+  static Hedger hedger;
+  return hedger;
+}
+
+Hedger::Hedger()
+    : budget_per_request_(std::max(0L, config_int("HEDGE_BUDGET_PERCENT", 0)) /
+                          100.0),
+      percentile_(std::min(99L, std::max(50L, config_int("HEDGE_PERCENTILE",
+                                                         kDefaultPercentile))) /
+                  100.0) {
+  for (auto& tracker : trackers_) {
+    tracker.samples_us.reserve(kSampleWindow);
+  }
+}
+
+Hedger::~Hedger() {
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    stopping_ = true;
+  }
+  timer_changed_.notify_all();
+  if (timer_.joinable()) {
+    timer_.join();
+  }
+}
+
+HttpClient::Response Hedger::send(ProviderId id, const Attempt& attempt,
+                                  int* slot) {
+  *slot = 0;
+  if (!enabled()) {
+    return attempt(nullptr, 0);
+  }
+
+  Tracker& tracker = trackers_[static_cast<size_t>(id)];
+  {
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    tracker.budget = std::min(kMaxBudget, tracker.budget + budget_per_request_);
+  }
+
+  auto flight = std::make_shared<Flight>();
+  flight->tracker = &tracker;
+  flight->attempt = &attempt;
+  flight->call = CallContext::current();
+
+  auto start = Clock::now();
+  int64_t delay_us = tracker.delay_us.load(std::memory_order_relaxed);
+  if (delay_us >= 0) {
+    schedule(start + std::chrono::microseconds(delay_us), flight);
+  }
+
+  HttpClient::Response response = attempt(&flight->original_control, 0);
+
+  // Only the original's timing feeds the percentile. One cut short by a
+  // winning duplicate had not responded yet, so its elapsed time is a lower
+  // bound; leaving it out would bias the delay towards hedging sooner.
+  if (flight->original_control.responded()) {
+    record(&tracker, flight->original_control.responded_at() - start);
+  } else if (flight->original_control.cancelled()) {
+    record(&tracker, Clock::now() - start);
+  }
+
+  std::unique_lock<std::mutex> lock(flight->mutex);
+  flight->original_done = true;
+  flight->original_ok = response.is_success();
+
+  // A queued duplicate sees original_done and never starts. A running one
+  // is cancelled if the original succeeded, or else awaited as the fallback.
+  if (flight->hedge == Flight::Hedge::kRunning) {
+    if (flight->original_ok && !flight->hedge_won) {
+      flight->hedge_control.cancel();
+    }
+    flight->changed.wait(
+        lock, [&flight] { return flight->hedge == Flight::Hedge::kDone; });
+  }
+
+  if (flight->hedge_won) {
+    tracker.hedge_wins.fetch_add(1, std::memory_order_relaxed);
+    *slot = 1;
+    return std::move(flight->hedge_response);
+  }
+  return response;
+}
+
+void Hedger::record(Tracker* tracker, Clock::duration time_to_headers) {
+  int64_t sample_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(time_to_headers)
+          .count();
+
+  std::lock_guard<std::mutex> lock(tracker->mutex);
+  if (tracker->samples_us.size() < kSampleWindow) {
+    tracker->samples_us.push_back(sample_us);
+  } else {
+    tracker->samples_us[tracker->next_sample] = sample_us;
+  }
+  tracker->next_sample = (tracker->next_sample + 1) % kSampleWindow;
+
+  if (++tracker->new_samples < kRecomputeEvery ||
+      tracker->samples_us.size() < kMinSamples) {
+    return;
+  }
+  tracker->new_samples = 0;
+
+  std::vector<int64_t> sorted = tracker->samples_us;
+  auto rank = static_cast<size_t>(percentile_ * (sorted.size() - 1));
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  tracker->delay_us.store(sorted[rank], std::memory_order_relaxed);
+}
+
+void Hedger::schedule(Clock::time_point when, std::shared_ptr<Flight> flight) {
+  std::lock_guard<std::mutex> lock(timer_mutex_);
+  if (!timer_.joinable()) {
+    timer_ = std::thread(&Hedger::timer_loop, this);
+  }
+  bool earliest = timers_.empty() || when < timers_.begin()->first;
+  timers_.emplace(when, std::move(flight));
+  if (earliest) {
+    timer_changed_.notify_one();
+  }
+}
+
+void Hedger::timer_loop() {
+  std::unique_lock<std::mutex> lock(timer_mutex_);
+  while (!stopping_) {
+    if (timers_.empty()) {
+      timer_changed_.wait(lock);
+      continue;
+    }
+
+    auto first = timers_.begin();
+    if (Clock::now() < first->first) {
+      timer_changed_.wait_until(lock, first->first);
+      continue;
+    }
+
+    std::shared_ptr<Flight> flight = std::move(first->second);
+    timers_.erase(first);
+    lock.unlock();
+    fire(flight);
+    lock.lock();
+  }
+}
+
+void Hedger::fire(const std::shared_ptr<Flight>& flight) {
+  {
+    std::lock_guard<std::mutex> lock(flight->mutex);
+    // Not stalled after all
+    if (flight->original_done || flight->original_control.responded()) {
+      return;
+    }
+
+    Tracker& tracker = *flight->tracker;
+    {
+      std::lock_guard<std::mutex> budget_lock(tracker.mutex);
+      if (tracker.budget < 1) {
+        return;
+      }
+      tracker.budget -= 1;
+    }
+    tracker.hedges.fetch_add(1, std::memory_order_relaxed);
+    flight->hedge = Flight::Hedge::kQueued;
+  }
+
+  WorkerPool::instance().submit([flight] {
+    {
+      std::lock_guard<std::mutex> lock(flight->mutex);
+      if (flight->original_done) {
+        flight->hedge = Flight::Hedge::kDone;
+        return;
+      }
+      flight->hedge = Flight::Hedge::kRunning;
+    }
+
+    HttpClient::Response response;
+    {
+      CallContext::Scope scope(flight->call);
+      response = (*flight->attempt)(&flight->hedge_control, 1);
+    }
+
+    std::lock_guard<std::mutex> lock(flight->mutex);
+    if (response.is_success() &&
+        !(flight->original_done && flight->original_ok)) {
+      flight->hedge_won = true;
+      flight->hedge_response = std::move(response);
+      if (!flight->original_done) {
+        flight->original_control.cancel();
+      }
+    }
+    flight->hedge = Flight::Hedge::kDone;
+    flight->changed.notify_all();
+  });
+}
+
+Hedger::Stats Hedger::stats(ProviderId id) const {
+  const Tracker& tracker = trackers_[static_cast<size_t>(id)];
+  Stats stats;
+  stats.hedges = tracker.hedges.load(std::memory_order_relaxed);
+  stats.hedge_wins = tracker.hedge_wins.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void Hedger::reset_stats(ProviderId id) {
+  Tracker& tracker = trackers_[static_cast<size_t>(id)];
+  tracker.hedges.store(0, std::memory_order_relaxed);
+  tracker.hedge_wins.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace vsql_ai
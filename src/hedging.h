@@ -0,0 +1,108 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_HEDGING_H
+#define VSQL_AI_HEDGING_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ai_providers.h"
+#include "http_client.h"
+
+namespace vsql_ai {
+
+// Optional hedged requests to cut tail latency, enabled by setting
+// VSQL_AI_HEDGE_BUDGET_PERCENT.
+//
+// If a request has not received response headers within the provider's
+// recent VSQL_AI_HEDGE_PERCENTILE time to headers, a duplicate is sent on
+// another pooled connection. Whichever succeeds first is used and the other
+// is cancelled. Duplicates are paid for from a budget that grows by
+// BUDGET_PERCENT / 100 per request, which bounds the extra requests.
+class Hedger {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Runs one copy of a request. slot is 0 for the original and 1 for the
+  // duplicate, so the two can write their output to separate storage.
+  using Attempt = std::function<HttpClient::Response(
+      HttpClient::RequestControl* control, int slot)>;
+
+  struct Stats {
+    uint64_t hedges = 0;
+    uint64_t hedge_wins = 0;
+  };
+
+  static Hedger& instance();
+
+  bool enabled() const { return budget_per_request_ > 0; }
+
+  // Run attempt, hedging it if it stalls. Returns the winning response and
+  // sets *slot to the slot that produced it.
+  HttpClient::Response send(ProviderId id, const Attempt& attempt, int* slot);
+
+  Stats stats(ProviderId id) const;
+
+  // Zero the counters; the learned hedge delay is kept
+  void reset_stats(ProviderId id);
+
+ private:
+  struct Flight;
+
+  // Recent time-to-headers samples and hedge budget of one provider
+  struct Tracker {
+    std::mutex mutex;
+    std::vector<int64_t> samples_us;  // ring buffer
+    size_t next_sample = 0;
+    size_t new_samples = 0;
+    double budget = 0;
+    std::atomic<int64_t> delay_us{-1};  // -1 until there are enough samples
+    std::atomic<uint64_t> hedges{0};
+    std::atomic<uint64_t> hedge_wins{0};
+  };
+
+  Hedger();
+  ~Hedger();
+
+  void record(Tracker* tracker, Clock::duration time_to_headers);
+  void schedule(Clock::time_point when, std::shared_ptr<Flight> flight);
+  void fire(const std::shared_ptr<Flight>& flight);
+  void timer_loop();
+
+  double budget_per_request_;
+  double percentile_;
+  std::array<Tracker, kProviderCount> trackers_;
+
+  std::mutex timer_mutex_;
+  std::condition_variable timer_changed_;
+  std::multimap<Clock::time_point, std::shared_ptr<Flight>> timers_;
+  std::thread timer_;
+  bool stopping_ = false;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_HEDGING_H
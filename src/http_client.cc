@@ -14,120 +14,393 @@
  * along with this program; if not, see <https://www.gnu.org/licenses/>.
  */
 
-#define CPPHTTPLIB_OPENSSL_SUPPORT
 #include "httplib.h"
 
 #include "http_client.h"
 
-#include <regex>
+#include <utility>
+
+#include "ascii_util.h"
+#include "call_context.h"
+#include "connection_pool.h"
+#include "content_encoding.h"
+#include "dns_cache.h"
+#include "http_engine.h"
+#include "worker_pool.h"
 
 namespace vsql_ai {
 
-HttpClient::HttpClient() {}
+namespace {
 
-HttpClient::~HttpClient() {}
+// Warm-up requests are only worth waiting for briefly; unloading the
+// extension waits for them
+constexpr int kWarmUpTimeoutSeconds = 5;
+
+std::string error_message(httplib::Error err) {
+  switch (err) {
+    case httplib::Error::Connection:
+      return "Connection failed";
+    case httplib::Error::BindIPAddress:
+      return "Failed to bind IP address";
+    case httplib::Error::Read:
+      return "Read error";
+    case httplib::Error::Write:
+      return "Write error";
+    case httplib::Error::ExceedRedirectCount:
+      return "Too many redirects";
+    case httplib::Error::Canceled:
+      return "Request canceled";
+    case httplib::Error::SSLConnection:
+      return "SSL connection failed";
+    case httplib::Error::SSLLoadingCerts:
+      return "Failed to load SSL certificates";
+    case httplib::Error::SSLServerVerification:
+      return "SSL server verification failed";
+    case httplib::Error::UnsupportedMultipartBoundaryChars:
+      return "Unsupported multipart boundary characters";
+    case httplib::Error::Compression:
+      return "Compression error";
+    case httplib::Error::ConnectionTimeout:
+      return "Connection timed out";
+    case httplib::Error::ConnectionClosed:
+      return "Connection closed";
+    case httplib::Error::Timeout:
+      return "Request timed out";
+    default:
+      return "Unknown error";
+  }
+}
+
+// Failures of the network rather than of the request itself
+bool is_transient(httplib::Error err) {
+  switch (err) {
+    case httplib::Error::Connection:
+    case httplib::Error::Read:
+    case httplib::Error::Write:
+    case httplib::Error::SSLConnection:
+    case httplib::Error::ConnectionTimeout:
+    case httplib::Error::ConnectionClosed:
+    case httplib::Error::Timeout:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void copy_headers(const httplib::Headers& from,
+                  std::map<std::string, std::string>* to) {
+  for (const auto& header : from) {
+    std::string name = header.first;
+    to_lower(&name);
+    (*to)[name] = header.second;
+  }
+}
+
+}  // namespace
+
+// =============================================================================
+// HttpClient::RequestControl
+// =============================================================================
+
+void HttpClient::RequestControl::cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cancelled_ = true;
+  // Unblocks the request at once rather than at its next timeout
+  if (abort_) {
+    abort_();
+  }
+  cancelled_cv_.notify_all();
+}
+
+bool HttpClient::RequestControl::cancelled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cancelled_;
+}
+
+bool HttpClient::RequestControl::responded() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return responded_;
+}
+
+HttpClient::RequestControl::Clock::time_point
+HttpClient::RequestControl::responded_at() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return responded_at_;
+}
+
+bool HttpClient::RequestControl::wait_for(std::chrono::milliseconds duration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !cancelled_cv_.wait_for(lock, duration, [this] { return cancelled_; });
+}
+
+bool HttpClient::RequestControl::attach(std::function<void()> abort) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cancelled_) {
+    return false;
+  }
+  abort_ = std::move(abort);
+  return true;
+}
 
-bool HttpClient::parse_url(const std::string& url, std::string* scheme,
-                           std::string* host, int* port) {
-  // Parse URL using regex: (https?)://([^:/]+)(?::(\d+))?
-  std::regex url_regex(R"((https?)://([^:/]+)(?::(\d+))?)");
-  std::smatch match;
+void HttpClient::RequestControl::detach() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  abort_ = nullptr;
+}
+
+void HttpClient::RequestControl::mark_responded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!responded_) {
+    responded_ = true;
+    responded_at_ = Clock::now();
+  }
+}
+
+// =============================================================================
+// HttpClient::Endpoint
+// =============================================================================
 
-  if (!std::regex_search(url, match, url_regex)) {
+bool HttpClient::Endpoint::parse(std::string_view url, Endpoint* endpoint) {
+  size_t separator = url.find("://");
+  if (separator == std::string_view::npos) {
+    return false;
+  }
+  std::string_view scheme = url.substr(0, separator);
+  if (scheme != "http" && scheme != "https") {
     return false;
   }
 
-  *scheme = match[1].str();
-  *host = match[2].str();
+  std::string_view rest = url.substr(separator + 3);
+  size_t slash = rest.find('/');
+  std::string_view authority = rest.substr(0, slash);
+  std::string_view base_path =
+      slash == std::string_view::npos ? std::string_view() : rest.substr(slash);
+  while (!base_path.empty() && base_path.back() == '/') {
+    base_path.remove_suffix(1);  // request paths start with one
+  }
 
-  if (match[3].matched) {
-    *port = std::stoi(match[3].str());
-  } else {
-    *port = (*scheme == "https") ? 443 : 80;
+  size_t colon = authority.find(':');
+  std::string_view host = authority.substr(0, colon);
+  if (host.empty()) {
+    return false;
+  }
+  int port = scheme == "https" ? 443 : 80;
+  if (colon != std::string_view::npos) {
+    std::string_view digits = authority.substr(colon + 1);
+    if (digits.empty() || digits.size() > 5) {
+      return false;
+    }
+    port = 0;
+    for (char c : digits) {
+      if (c < '0' || c > '9') {
+        return false;
+      }
+      port = port * 10 + (c - '0');
+    }
+    if (port == 0 || port > 65535) {
+      return false;
+    }
   }
 
+  endpoint->scheme = std::string(scheme);
+  endpoint->host = std::string(host);
+  endpoint->port = port;
+  endpoint->base_path = std::string(base_path);
+  endpoint->key = endpoint->scheme + "://" + endpoint->host + ":" +
+                  std::to_string(port);
   return true;
 }
 
+// =============================================================================
+// HttpClient
+// =============================================================================
+
+HttpClient::HttpClient() {}
+
+HttpClient::~HttpClient() {}
+
 HttpClient::Response HttpClient::post(
-    const std::string& url, const std::string& path, const std::string& body,
+    const Endpoint& endpoint, const std::string& path, const std::string& body,
+    const std::map<std::string, std::string>& headers, int timeout_seconds) {
+  return send("POST", endpoint, path, body, headers, timeout_seconds, nullptr,
+              nullptr);
+}
+
+HttpClient::Response HttpClient::post_stream(
+    const Endpoint& endpoint, const std::string& path, const std::string& body,
+    const std::map<std::string, std::string>& headers, int timeout_seconds,
+    const ChunkHandler& on_chunk, RequestControl* control) {
+  return send("POST", endpoint, path, body, headers, timeout_seconds,
+              &on_chunk, control);
+}
+
+HttpClient::Response HttpClient::get(
+    const Endpoint& endpoint, const std::string& path,
     const std::map<std::string, std::string>& headers, int timeout_seconds) {
+  return send("GET", endpoint, path, std::string(), headers, timeout_seconds,
+              nullptr, nullptr);
+}
+
+HttpClient::Response HttpClient::get_stream(
+    const Endpoint& endpoint, const std::string& path,
+    const std::map<std::string, std::string>& headers, int timeout_seconds,
+    const ChunkHandler& on_chunk) {
+  return send("GET", endpoint, path, std::string(), headers, timeout_seconds,
+              &on_chunk, nullptr);
+}
+
+void HttpClient::warm_up(const Endpoint& endpoint, size_t connections) {
+  if (connections == 0) {
+    return;
+  }
+
+  // Constructed before the worker pool, so that they outlive its threads when
+  // the extension is unloaded
+  DnsCache::instance();
+  ConnectionPool::instance();
+  HttpEngine::instance();
+
+  WorkerPool::instance().submit([endpoint, connections] {
+    DnsCache::Address address;
+    std::string error;
+    if (!DnsCache::instance().resolve(endpoint.host, endpoint.port, &address,
+                                      &error)) {
+      return;
+    }
+
+    // Sent all at once, so each needs a connection of its own
+    const std::map<std::string, std::string> headers;
+    WorkerPool::instance().parallel_for(connections, connections, [&](size_t) {
+      HttpClient client;
+      client.post(endpoint, "/", "", headers, kWarmUpTimeoutSeconds);
+    });
+  });
+}
+
+HttpClient::Response HttpClient::send(
+    const char* method, const Endpoint& endpoint, const std::string& path,
+    const std::string& body,
+    const std::map<std::string, std::string>& headers, int timeout_seconds,
+    const ChunkHandler* on_chunk, RequestControl* control) {
   Response response;
   response.status_code = 0;
 
-  // Parse URL
-  std::string scheme, host;
-  int port;
-  if (!parse_url(url, &scheme, &host, &port)) {
-    response.error = "Invalid URL format";
-    return response;
+  // A request made for a SQL call ends with the call: its timeout is capped
+  // at the time the call has left, and cancelling the call aborts it
+  CallContext* call = CallContext::current();
+  RequestControl call_control;
+  if (call) {
+    if (!control) {
+      control = &call_control;
+    }
+    timeout_seconds = call->cap_timeout(timeout_seconds);
+  }
+  CallContext::Link link(call, control);
+
+  HttpEngine& engine = HttpEngine::instance();
+  if (engine.enabled()) {
+    HttpEngine::Request request;
+    request.method = method;
+    request.endpoint = &endpoint;
+    request.path = path;
+    request.timeout_seconds = timeout_seconds;
+    request.body = body;
+    request.headers = &headers;
+    if (on_chunk) {
+      request.on_chunk = [on_chunk](const char* data, size_t length) {
+        return (*on_chunk)(data, length);
+      };
+    }
+    request.control = control;
+    return engine.send(std::move(request));
   }
 
   try {
-    // Create HTTP client
-    httplib::Client cli(url);
+    // Lease a keep-alive client for this endpoint from the shared pool
+    auto cli = ConnectionPool::instance().acquire(endpoint, timeout_seconds,
+                                                  &response.error);
+    if (!cli) {
+      return response;
+    }
 
     // Set timeouts
-    cli.set_connection_timeout(timeout_seconds);
-    cli.set_read_timeout(timeout_seconds);
-    cli.set_write_timeout(timeout_seconds);
+    cli->set_connection_timeout(timeout_seconds);
+    cli->set_read_timeout(timeout_seconds);
+    cli->set_write_timeout(timeout_seconds);
 
-    // Build headers
-    httplib::Headers http_headers;
+    // Build request
+    httplib::Request req;
+    req.method = method;
+    req.path.reserve(endpoint.base_path.size() + path.size());
+    req.path.append(endpoint.base_path).append(path);
     for (const auto& header : headers) {
-      http_headers.insert({header.first, header.second});
+      req.headers.insert({header.first, header.second});
+    }
+    if (!body.empty() && !req.has_header("Content-Type")) {
+      req.set_header("Content-Type", "application/json");
+    }
+    const char* accept_encoding = ContentDecoder::accept_encoding();
+    if (*accept_encoding && !req.has_header("Accept-Encoding")) {
+      req.set_header("Accept-Encoding", accept_encoding);
     }
+    req.body = body;
+
+    // The body is decoded here rather than by httplib, so that its size on
+    // the wire is known. 2xx bodies go to the caller as they arrive;
+    // anything else is small and buffered for error reporting.
+    BodyReceiver receiver;
+    receiver.reset(&response, on_chunk);
+    req.response_handler = [&](const httplib::Response& res) {
+      response.status_code = res.status;
+      copy_headers(res.headers, &response.headers);
+      if (control) {
+        control->mark_responded();
+      }
+      return receiver.start();
+    };
+    req.content_receiver = [&](const char* data, size_t length,
+                               size_t /*offset*/, size_t /*total_length*/) {
+      return receiver.receive(data, length);
+    };
 
-    // Make POST request
-    auto res = cli.Post(path, http_headers, body, "application/json");
+    // Make the request
+    // stop() shuts the socket down, so a blocked read or write returns
+    httplib::Client* client = &*cli;
+    if (control && !control->attach([client] { client->stop(); })) {
+      response.error = error_message(httplib::Error::Canceled);
+      return response;
+    }
+    auto res = cli->send(req);
+    if (control) {
+      control->detach();
+      if (control->cancelled()) {
+        // Whatever the socket reported, this was not a network failure
+        cli.discard();
+        response.status_code = 0;
+        response.error = error_message(httplib::Error::Canceled);
+        return response;
+      }
+    }
 
     if (!res) {
-      // Connection failed
-      auto err = res.error();
-      switch (err) {
-        case httplib::Error::Connection:
-          response.error = "Connection failed";
-          break;
-        case httplib::Error::BindIPAddress:
-          response.error = "Failed to bind IP address";
-          break;
-        case httplib::Error::Read:
-          response.error = "Read error";
-          break;
-        case httplib::Error::Write:
-          response.error = "Write error";
-          break;
-        case httplib::Error::ExceedRedirectCount:
-          response.error = "Too many redirects";
-          break;
-        case httplib::Error::Canceled:
-          response.error = "Request canceled";
-          break;
-        case httplib::Error::SSLConnection:
-          response.error = "SSL connection failed";
-          break;
-        case httplib::Error::SSLLoadingCerts:
-          response.error = "Failed to load SSL certificates";
-          break;
-        case httplib::Error::SSLServerVerification:
-          response.error = "SSL server verification failed";
-          break;
-        case httplib::Error::UnsupportedMultipartBoundaryChars:
-          response.error = "Unsupported multipart boundary characters";
-          break;
-        case httplib::Error::Compression:
-          response.error = "Compression error";
-          break;
-        default:
-          response.error = "Unknown error";
-          break;
+      // Connection failed or unread body left on the socket; don't hand
+      // this connection to the next caller
+      cli.discard();
+      if (receiver.stopped()) {
+        return response;
+      }
+      response.status_code = 0;
+      if (!receiver.error().empty()) {
+        response.error = receiver.error();
+        return response;
       }
+      response.error = error_message(res.error());
+      response.transient = is_transient(res.error());
       return response;
     }
 
-    // Success (HTTP response received, even if status >= 400)
+    // Success (HTTP response received, even if status >= 400); the
+    // receiver has already filled in the headers and body
     response.status_code = res->status;
-    response.body = res->body;
     // Don't set error here - let the caller handle HTTP status codes
     // and parse the response body for detailed error messages
 
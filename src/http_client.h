@@ -17,34 +17,139 @@
 #ifndef VSQL_AI_HTTP_CLIENT_H
 #define VSQL_AI_HTTP_CLIENT_H
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
+#include <string_view>
 
 namespace vsql_ai {
 
 class HttpClient {
  public:
+  // Where requests go: a base URL parsed once, e.g. when a provider is set
+  // up, and reused for every request to it
+  struct Endpoint {
+    std::string scheme;  // "http" or "https"
+    std::string host;
+    int port = 0;
+    std::string base_path;  // prepended to request paths; "" for the root
+    std::string key;        // "scheme://host:port", connections are pooled by
+
+    // Parse "http[s]://host[:port][/base/path]". Returns false if malformed.
+    static bool parse(std::string_view url, Endpoint* endpoint);
+  };
+
   struct Response {
     int status_code;
     std::string body;
     std::string error;
+    std::map<std::string, std::string> headers;  // names in lower case
+    bool transient = false;  // network failure that may succeed if retried
+
+    // Body size as sent by the server and after Content-Encoding decoding
+    size_t bytes_received = 0;
+    size_t bytes_decoded = 0;
+
+    // From handing the request to the transport to the response headers
+    std::chrono::steady_clock::duration first_byte{};
 
     bool is_success() const { return status_code >= 200 && status_code < 300; }
+
+    // Value of a response header (name in lower case), or "" if absent
+    std::string header(const std::string& name) const {
+      auto found = headers.find(name);
+      return found != headers.end() ? found->second : std::string();
+    }
+  };
+
+  // Shared with other threads to watch and abort a request in flight
+  class RequestControl {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    // Abort the request, which then fails with "Request canceled". Safe to
+    // call from any thread, before or during the request.
+    void cancel();
+    bool cancelled() const;
+
+    // Whether response headers have arrived, and when
+    bool responded() const;
+    Clock::time_point responded_at() const;
+
+    // Sleep for up to duration; returns false early if cancelled
+    bool wait_for(std::chrono::milliseconds duration);
+
+   private:
+    friend class HttpClient;
+    friend class HttpEngine;
+
+    // Register how to abort the request in flight. Returns false if it was
+    // cancelled before it started.
+    bool attach(std::function<void()> abort);
+    void detach();
+    void mark_responded();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cancelled_cv_;
+    std::function<void()> abort_;
+    bool cancelled_ = false;
+    bool responded_ = false;
+    Clock::time_point responded_at_;
   };
 
   HttpClient();
   ~HttpClient();
 
   // Make a POST request
-  Response post(const std::string& url, const std::string& path,
+  Response post(const Endpoint& endpoint, const std::string& path,
                 const std::string& body,
                 const std::map<std::string, std::string>& headers,
                 int timeout_seconds = 30);
 
+  // Receives a successful response's body as it arrives. Return false to
+  // stop reading; the connection is then closed rather than reused.
+  using ChunkHandler = std::function<bool(const char* data, size_t length)>;
+
+  // Make a POST request and stream a 2xx body to on_chunk instead of
+  // buffering it. Other responses are buffered in Response::body as usual,
+  // so callers can parse the API's error message. Stopping early is not an
+  // error.
+  Response post_stream(const Endpoint& endpoint, const std::string& path,
+                       const std::string& body,
+                       const std::map<std::string, std::string>& headers,
+                       int timeout_seconds, const ChunkHandler& on_chunk,
+                       RequestControl* control = nullptr);
+
+  // Make a GET request
+  Response get(const Endpoint& endpoint, const std::string& path,
+               const std::map<std::string, std::string>& headers,
+               int timeout_seconds = 30);
+
+  // Make a GET request, streaming a 2xx body to on_chunk as post_stream()
+  // does
+  Response get_stream(const Endpoint& endpoint, const std::string& path,
+                      const std::map<std::string, std::string>& headers,
+                      int timeout_seconds, const ChunkHandler& on_chunk);
+
+  // Resolve the endpoint's host and open up to connections keep-alive
+  // connections to it in the background, so that the first requests after a
+  // restart skip DNS, TCP and TLS setup. Each connection is opened by a POST
+  // to the base path, which the API answers with an error. Returns at once.
+  static void warm_up(const Endpoint& endpoint, size_t connections);
+
  private:
-  // Helper to extract host from URL
-  static bool parse_url(const std::string& url, std::string* scheme,
-                        std::string* host, int* port);
+  // Shared implementation; on_chunk may be null to buffer the whole body.
+  // method is "GET" or "POST"; GET requests have no body.
+  Response send(const char* method, const Endpoint& endpoint,
+                const std::string& path,
+                const std::string& body,
+                const std::map<std::string, std::string>& headers,
+                int timeout_seconds, const ChunkHandler* on_chunk,
+                RequestControl* control);
 };
 
 }  // namespace vsql_ai
@@ -0,0 +1,1712 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "http_engine.h"
+
+// epoll is Linux-only; elsewhere the engine stays disabled (see the end of
+// this file) and HttpClient keeps using httplib
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+#include <nghttp2/nghttp2.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "ascii_util.h"
+#include "config.h"
+#include "content_encoding.h"
+#include "dns_cache.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Same settings, and defaults, as the httplib backend's ConnectionPool
+constexpr long kDefaultMaxConnectionsPerHost = 16;
+constexpr long kDefaultIdleTimeout = 30;
+
+constexpr size_t kMaxHeadBytes = 64 * 1024;
+constexpr size_t kReadBytes = 16 * 1024;
+constexpr int kMaxEvents = 64;
+
+// Longest the event loop sleeps, so shutdown and expiry are never far off
+constexpr int kMaxWaitMs = 1000;
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+// Servers commonly allow 100 concurrent streams; more requests than that
+// to one host open another connection
+constexpr uint32_t kMaxStreamsPerSession = 100;
+
+// Flow-control windows, large enough that an embedding batch response is
+// not throttled by window updates
+constexpr int32_t kStreamWindow = 1 << 20;
+constexpr int32_t kSessionWindow = 16 << 20;
+
+// ALPN protocols offered, in wire format
+const unsigned char kAlpnProtocols[] = "\x02h2\x08http/1.1";
+
+// Frames serialized per write
+constexpr size_t kMaxOutputBytes = 64 * 1024;
+#endif
+
+const char kCanceled[] = "Request canceled";
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+// Incremental HTTP/1.1 response reader. Bytes are fed as they arrive; the
+// head fills in the Response, and the body goes through a BodyReceiver as
+// with httplib.
+class ResponseReader {
+ public:
+  void reset(HttpClient::Response* response,
+             const HttpClient::ChunkHandler* on_chunk) {
+    response_ = response;
+    body_.reset(response, on_chunk);
+    state_ = State::kHead;
+    has_head_ = false;
+    line_.clear();
+    remaining_ = 0;
+    keep_alive_ = true;
+    stopped_ = false;
+  }
+
+  // Returns false if the response is malformed; see error()
+  bool feed(const char* data, size_t length) {
+    while (length > 0) {
+      switch (state_) {
+        case State::kHead: {
+          size_t searched = line_.size() >= 3 ? line_.size() - 3 : 0;
+          size_t old_size = line_.size();
+          line_.append(data, length);
+          size_t end = line_.find("\r\n\r\n", searched);
+          if (end == std::string::npos) {
+            return line_.size() <= kMaxHeadBytes;
+          }
+          // Whatever follows the head is the start of the body
+          size_t used = end + 4 - old_size;
+          data += used;
+          length -= used;
+          line_.resize(end);
+          if (!parse_head()) {
+            return false;
+          }
+          line_.clear();
+          break;
+        }
+
+        case State::kBody:
+        case State::kChunkData: {
+          size_t take = std::min<size_t>(remaining_, length);
+          if (!deliver(data, take)) {
+            return stopped_;
+          }
+          data += take;
+          length -= take;
+          remaining_ -= take;
+          if (remaining_ == 0) {
+            state_ = state_ == State::kBody ? State::kDone : State::kChunkEnd;
+          }
+          break;
+        }
+
+        case State::kUntilClose:
+          return deliver(data, length) || stopped_;
+
+        case State::kChunkSize:
+        case State::kChunkEnd:
+        case State::kTrailer: {
+          std::string_view line;
+          if (!read_line(&data, &length, &line)) {
+            return line_.size() <= kMaxHeadBytes;
+          }
+          if (!chunk_line(line)) {
+            return false;
+          }
+          line_.clear();
+          break;
+        }
+
+        case State::kDone:
+          // Bytes past the response; the connection cannot be reused
+          keep_alive_ = false;
+          return true;
+      }
+      if (stopped_) {
+        return true;
+      }
+    }
+    return true;
+  }
+
+  // The peer closed the connection. Returns whether that ends the response
+  // rather than cutting it short.
+  bool end_of_stream() {
+    keep_alive_ = false;
+    if (state_ == State::kUntilClose) {
+      state_ = State::kDone;
+    }
+    return state_ == State::kDone;
+  }
+
+  // Whether the final response's head has been read
+  bool has_head() const { return has_head_; }
+  bool done() const { return state_ == State::kDone; }
+  bool stopped() const { return stopped_; }
+  bool keep_alive() const { return keep_alive_; }
+
+  std::string error() const {
+    return body_.error().empty() ? "Invalid HTTP response" : body_.error();
+  }
+
+ private:
+  enum class State {
+    kHead,
+    kBody,        // remaining_ bytes of a Content-Length body
+    kChunkSize,
+    kChunkData,   // remaining_ bytes of the current chunk
+    kChunkEnd,    // CRLF after a chunk
+    kTrailer,
+    kUntilClose,  // no length given; the body ends with the connection
+    kDone
+  };
+
+  bool parse_head() {
+    std::string_view head(line_);
+    size_t eol = head.find("\r\n");
+    std::string_view status_line = head.substr(0, eol);
+    head = eol == std::string_view::npos ? std::string_view()
+                                         : head.substr(eol + 2);
+
+    // HTTP/1.1 200 OK
+    if (status_line.size() < 12 || status_line.substr(0, 5) != "HTTP/") {
+      return false;
+    }
+    size_t space = status_line.find(' ');
+    if (space == std::string_view::npos || space + 4 > status_line.size()) {
+      return false;
+    }
+    int status = 0;
+    for (char c : status_line.substr(space + 1, 3)) {
+      if (c < '0' || c > '9') {
+        return false;
+      }
+      status = status * 10 + (c - '0');
+    }
+    bool http10 = status_line.substr(0, 8) == "HTTP/1.0";
+
+    // Interim responses (100 Continue) are followed by the real one
+    if (status >= 100 && status < 200) {
+      state_ = State::kHead;
+      return true;
+    }
+
+    response_->status_code = status;
+    response_->headers.clear();
+    bool chunked = false;
+    bool has_length = false;
+    size_t content_length = 0;
+    keep_alive_ = !http10;
+
+    while (!head.empty()) {
+      eol = head.find("\r\n");
+      std::string_view line = head.substr(0, eol);
+      head = eol == std::string_view::npos ? std::string_view()
+                                           : head.substr(eol + 2);
+      size_t colon = line.find(':');
+      if (colon == std::string_view::npos) {
+        continue;
+      }
+      std::string name(trim(line.substr(0, colon)));
+      to_lower(&name);
+      std::string_view value = trim(line.substr(colon + 1));
+
+      if (name == "content-length") {
+        has_length = true;
+        content_length = std::strtoull(std::string(value).c_str(), nullptr,
+                                       10);
+      } else if (name == "transfer-encoding") {
+        chunked = value.size() >= 7 &&
+                  equals_ignore_case(value.substr(value.size() - 7),
+                                     "chunked");
+      } else if (name == "connection") {
+        if (equals_ignore_case(value, "close")) {
+          keep_alive_ = false;
+        } else if (equals_ignore_case(value, "keep-alive")) {
+          keep_alive_ = true;
+        }
+      }
+      response_->headers[name] = std::string(value);
+    }
+
+    has_head_ = true;
+    if (!body_.start()) {
+      return false;
+    }
+    if (status == 204 || status == 304) {
+      state_ = State::kDone;
+    } else if (chunked) {
+      state_ = State::kChunkSize;
+    } else if (has_length) {
+      remaining_ = content_length;
+      state_ = remaining_ > 0 ? State::kBody : State::kDone;
+    } else {
+      state_ = State::kUntilClose;
+      keep_alive_ = false;
+    }
+    return true;
+  }
+
+  // Collect one CRLF-terminated line into line_. Returns false until it is
+  // complete, with all input consumed.
+  bool read_line(const char** data, size_t* length, std::string_view* line) {
+    const char* newline =
+        static_cast<const char*>(memchr(*data, '\n', *length));
+    size_t take = newline ? newline - *data + 1 : *length;
+    line_.append(*data, take);
+    *data += take;
+    *length -= take;
+    if (!newline) {
+      return false;
+    }
+    *line = std::string_view(line_);
+    line->remove_suffix(line->size() >= 2 && (*line)[line->size() - 2] == '\r'
+                            ? 2
+                            : 1);
+    return true;
+  }
+
+  bool chunk_line(std::string_view line) {
+    switch (state_) {
+      case State::kChunkSize: {
+        // Size in hex, possibly followed by ;extensions
+        size_t size = 0;
+        size_t digits = 0;
+        for (char c : line) {
+          int digit = std::isxdigit(static_cast<unsigned char>(c))
+                          ? (std::isdigit(static_cast<unsigned char>(c))
+                                 ? c - '0'
+                                 : to_lower(c) - 'a' + 10)
+                          : -1;
+          if (digit < 0) {
+            break;
+          }
+          size = size * 16 + static_cast<size_t>(digit);
+          digits++;
+        }
+        if (digits == 0 || digits > 15) {
+          return false;
+        }
+        remaining_ = size;
+        state_ = size > 0 ? State::kChunkData : State::kTrailer;
+        return true;
+      }
+      case State::kChunkEnd:
+        state_ = State::kChunkSize;
+        return line.empty();
+      case State::kTrailer:
+        if (line.empty()) {
+          state_ = State::kDone;
+        }
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Returns false once the chunk handler asks to stop or decoding fails
+  bool deliver(const char* data, size_t length) {
+    if (!body_.receive(data, length)) {
+      stopped_ = body_.stopped();
+      keep_alive_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  HttpClient::Response* response_ = nullptr;
+  BodyReceiver body_;
+  State state_ = State::kHead;
+  std::string line_;  // partial head or chunk line
+  size_t remaining_ = 0;
+  bool has_head_ = false;
+  bool keep_alive_ = true;
+  bool stopped_ = false;
+};
+
+}  // namespace
+
+struct HttpEngine::Exchange {
+  uint64_t id = 0;
+  std::string key;  // of the host
+  std::string scheme;
+  std::string host;
+  std::string wire;  // the serialized request
+  size_t body_offset = 0;  // where the body starts in wire
+  DnsCache::Address address;
+  std::chrono::seconds timeout{30};
+  HttpClient::ChunkHandler on_chunk;
+  HttpClient::RequestControl* control = nullptr;
+  Completion done;
+  HttpClient::Response response;
+  Clock::time_point queued_at;
+  bool resent = false;  // after a stale keep-alive connection
+};
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+// One request on an HTTP/2 connection. A request completed early (cancelled
+// or timed out) leaves its stream behind, without an exchange, until the
+// reset is through.
+struct HttpEngine::Stream {
+  int32_t id = 0;
+  std::unique_ptr<Exchange> exchange;
+  size_t body_sent = 0;   // offset into the exchange's wire
+  bool received = false;  // any response frames
+  bool responded = false;
+  bool stopped = false;  // by the chunk handler
+  Clock::time_point deadline;
+  BodyReceiver body;
+};
+#endif
+
+struct HttpEngine::Connection {
+  enum class State {
+    kConnecting,
+    kHandshake,
+    kWriting,
+    kReading,
+    kIdle,
+    kSession  // HTTP/2
+  };
+
+  uint64_t id = 0;
+  int fd = -1;
+  SSL* ssl = nullptr;
+  std::string key;
+  bool tls = false;
+  State state = State::kConnecting;
+  bool used = false;      // completed an earlier exchange
+  bool received = false;  // any response bytes for the current one
+  uint32_t wanted = 0;      // epoll events the current step waits for
+  uint32_t registered = 0;  // epoll events registered
+  std::unique_ptr<Exchange> exchange;
+  size_t written = 0;
+  ResponseReader reader;
+  Clock::time_point deadline;  // of the current exchange's next progress
+  Clock::time_point idle_since;
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  HttpEngine* engine = nullptr;
+  nghttp2_session* session = nullptr;
+  std::vector<std::unique_ptr<Stream>> streams;
+  std::string output;  // frames being written
+  size_t output_written = 0;
+  bool going_away = false;  // no new streams
+#endif
+};
+
+// =============================================================================
+// HttpEngine
+// =============================================================================
+
+HttpEngine& HttpEngine::instance() {
+  static HttpEngine engine;
+  return engine;
+}
+
+HttpEngine::HttpEngine()
+    : max_connections_per_host_(static_cast<size_t>(std::max(
+          1L, config_int("MAX_CONNECTIONS_PER_HOST",
+                         kDefaultMaxConnectionsPerHost)))),
+      idle_timeout_(config_int("IDLE_CONNECTION_TIMEOUT", kDefaultIdleTimeout)),
+      read_buffer_(kReadBytes) {
+  if (config_string("HTTP_BACKEND", "httplib") != "epoll") {
+    return;
+  }
+
+  ssl_ctx_ = SSL_CTX_new(TLS_client_method());
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (!ssl_ctx_ || epoll_fd_ < 0 || wake_fd_ < 0) {
+    return;  // stay disabled; requests keep using httplib
+  }
+  SSL_CTX_set_default_verify_paths(ssl_ctx_);
+  SSL_CTX_set_verify(ssl_ctx_, SSL_VERIFY_PEER, nullptr);
+  SSL_CTX_set_min_proto_version(ssl_ctx_, TLS1_2_VERSION);
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  http2_ = config_int("HTTP2", 1) != 0;
+  if (http2_) {
+    SSL_CTX_set_alpn_protos(ssl_ctx_, kAlpnProtocols,
+                            sizeof(kAlpnProtocols) - 1);
+  }
+#endif
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = 0;  // connection ids start at 1
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+  enabled_ = true;
+  thread_ = std::thread(&HttpEngine::run, this);
+}
+
+HttpEngine::~HttpEngine() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake();
+    thread_.join();
+  }
+  if (epoll_fd_ >= 0) {
+    ::close(epoll_fd_);
+  }
+  if (wake_fd_ >= 0) {
+    ::close(wake_fd_);
+  }
+  if (ssl_ctx_) {
+    SSL_CTX_free(ssl_ctx_);
+  }
+}
+
+void HttpEngine::submit(Request request, Completion done) {
+  if (!enabled_) {
+    HttpClient::Response response;
+    response.status_code = 0;
+    response.error = "HTTP engine is not enabled";
+    done(std::move(response));
+    return;
+  }
+
+  const HttpClient::Endpoint& endpoint = *request.endpoint;
+  auto exchange = std::make_unique<Exchange>();
+  exchange->key = endpoint.key;
+  exchange->scheme = endpoint.scheme;
+  exchange->host = endpoint.host;
+  exchange->timeout = std::chrono::seconds(request.timeout_seconds);
+  exchange->on_chunk = std::move(request.on_chunk);
+  exchange->control = request.control;
+  exchange->done = std::move(done);
+  exchange->response.status_code = 0;
+
+  // Serialize the request once; it is written from this buffer
+  std::string& wire = exchange->wire;
+  wire.reserve(256 + endpoint.base_path.size() + request.path.size() +
+               request.body.size());
+  wire.append(request.method).append(" ");
+  wire.append(endpoint.base_path).append(request.path);
+  wire.append(" HTTP/1.1\r\nHost: ").append(endpoint.host);
+  bool default_port = (endpoint.scheme == "https" && endpoint.port == 443) ||
+                      (endpoint.scheme == "http" && endpoint.port == 80);
+  if (!default_port) {
+    wire.append(":").append(std::to_string(endpoint.port));
+  }
+  wire.append("\r\n");
+  bool has_content_type = false;
+  bool has_accept_encoding = false;
+  if (request.headers) {
+    for (const auto& header : *request.headers) {
+      has_content_type |= equals_ignore_case(header.first, "content-type");
+      has_accept_encoding |=
+          equals_ignore_case(header.first, "accept-encoding");
+      wire.append(header.first).append(": ").append(header.second);
+      wire.append("\r\n");
+    }
+  }
+  if (!has_content_type && !request.body.empty()) {
+    wire.append("Content-Type: application/json\r\n");
+  }
+  const char* accept_encoding = ContentDecoder::accept_encoding();
+  if (*accept_encoding && !has_accept_encoding) {
+    wire.append("Accept-Encoding: ").append(accept_encoding).append("\r\n");
+  }
+  if (request.method != "GET") {
+    wire.append("Content-Length: ");
+    wire.append(std::to_string(request.body.size())).append("\r\n");
+  }
+  wire.append("\r\n");
+  exchange->body_offset = wire.size();
+  wire.append(request.body);
+
+  // Resolving may block, so it happens here rather than on the engine thread
+  if (DnsCache::instance().resolve(endpoint.host, endpoint.port,
+                                   &exchange->address,
+                                   &exchange->response.error)) {
+    exchange->response.error.clear();
+  } else {
+    exchange->response.transient = true;
+  }
+
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_exchange_id_++;
+  }
+  exchange->id = id;
+
+  // Attached outside mutex_: cancel() calls the abort with the control's own
+  // lock held, and the abort takes mutex_
+  if (exchange->control &&
+      !exchange->control->attach([this, id] {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          cancelled_.push_back(id);
+        }
+        wake();
+      })) {
+    exchange->response.error = kCanceled;
+    exchange->response.transient = false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitted_.push_back(std::move(exchange));
+  }
+  wake();
+}
+
+HttpClient::Response HttpEngine::send(Request request) {
+  std::mutex mutex;
+  std::condition_variable finished_cv;
+  bool finished = false;
+  HttpClient::Response response;
+
+  submit(std::move(request), [&](HttpClient::Response result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    response = std::move(result);
+    finished = true;
+    // Notify under the lock; the waiter's stack goes away once it wakes
+    finished_cv.notify_one();
+  });
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finished_cv.wait(lock, [&finished] { return finished; });
+  return response;
+}
+
+void HttpEngine::wake() {
+  uint64_t one = 1;
+  ssize_t written = write(wake_fd_, &one, sizeof(one));
+  (void)written;  // already signalled if the counter is full
+}
+
+void HttpEngine::run() {
+  epoll_event events[kMaxEvents];
+  while (true) {
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents,
+                           next_timeout_ms(Clock::now()));
+    for (int i = 0; i < count; i++) {
+      uint64_t id = events[i].data.u64;
+      if (id == 0) {
+        uint64_t value;
+        ssize_t drained = read(wake_fd_, &value, sizeof(value));
+        (void)drained;
+        continue;
+      }
+      // A connection closed earlier in this batch has no entry any more
+      auto found = connections_.find(id);
+      if (found != connections_.end()) {
+        drive(found->second.get(), events[i].events);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        break;
+      }
+    }
+    take_submissions();
+    expire(Clock::now());
+  }
+
+  // Fail whatever is still in flight, so no caller waits forever. Queued
+  // requests go first; closing a connection would otherwise start them.
+  take_submissions();
+  for (auto& entry : hosts_) {
+    while (!entry.second.waiting.empty()) {
+      auto exchange = std::move(entry.second.waiting.front());
+      entry.second.waiting.pop_front();
+      exchange->response.error = "Connection closed";
+      exchange->response.transient = true;
+      complete(std::move(exchange));
+    }
+  }
+  while (!connections_.empty()) {
+    fail(connections_.begin()->second.get(), "Connection closed", true, false);
+  }
+}
+
+void HttpEngine::take_submissions() {
+  std::vector<std::unique_ptr<Exchange>> submitted;
+  std::vector<uint64_t> cancelled;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitted.swap(submitted_);
+    cancelled.swap(cancelled_);
+  }
+  for (auto& exchange : submitted) {
+    dispatch(std::move(exchange));
+  }
+  for (uint64_t id : cancelled) {
+    cancel_exchange(id);
+  }
+}
+
+void HttpEngine::dispatch(std::unique_ptr<Exchange> exchange) {
+  if (!exchange->response.error.empty()) {
+    complete(std::move(exchange));
+    return;
+  }
+
+  Host& host = hosts_[exchange->key];
+  exchange->queued_at = Clock::now();
+  host.waiting.push_back(std::move(exchange));
+  serve(&host);
+}
+
+void HttpEngine::serve(Host* host) {
+  while (!host->waiting.empty()) {
+#ifdef VSQL_AI_HAVE_NGHTTP2
+    if (Connection* session = available_session(host)) {
+      auto exchange = std::move(host->waiting.front());
+      host->waiting.pop_front();
+      open_stream(session, std::move(exchange));
+      continue;
+    }
+    // The connection being set up will most likely take them all
+    if (host->http2 && host->connecting > 0) {
+      return;
+    }
+#endif
+    if (!host->idle.empty()) {
+      Connection* connection = host->idle.back();
+      host->idle.pop_back();
+      auto exchange = std::move(host->waiting.front());
+      host->waiting.pop_front();
+      start(connection, std::move(exchange));
+    } else if (host->open < max_connections_per_host_) {
+      auto exchange = std::move(host->waiting.front());
+      host->waiting.pop_front();
+      connect(host, &exchange);
+    } else {
+      return;
+    }
+  }
+}
+
+bool HttpEngine::connect(Host* host, std::unique_ptr<Exchange>* exchange) {
+  const DnsCache::Address& address = (*exchange)->address;
+  int fd = socket(address.storage.ss_family,
+                  SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    (*exchange)->response.error = "Connection failed";
+    (*exchange)->response.transient = true;
+    complete(std::move(*exchange));
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address.storage),
+                address.length) != 0 &&
+      errno != EINPROGRESS) {
+    ::close(fd);
+    (*exchange)->response.error = "Connection failed";
+    (*exchange)->response.transient = true;
+    complete(std::move(*exchange));
+    return false;
+  }
+
+  auto connection = std::make_unique<Connection>();
+  connection->id = next_connection_id_++;
+  connection->fd = fd;
+  connection->key = (*exchange)->key;
+  connection->tls = (*exchange)->scheme == "https";
+  connection->state = Connection::State::kConnecting;
+  connection->wanted = EPOLLOUT;
+
+  epoll_event event = {};
+  event.events = EPOLLOUT;
+  event.data.u64 = connection->id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  connection->registered = EPOLLOUT;
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  connection->engine = this;
+#endif
+
+  Connection* raw = connection.get();
+  connections_[raw->id] = std::move(connection);
+  host->open++;
+  host->connecting++;
+
+  raw->exchange = std::move(*exchange);
+  raw->deadline = Clock::now() + raw->exchange->timeout;
+  raw->reader.reset(&raw->exchange->response, &raw->exchange->on_chunk);
+  running_[raw->exchange->id] = raw;
+  return true;
+}
+
+void HttpEngine::start(Connection* connection,
+                       std::unique_ptr<Exchange> exchange) {
+  connection->exchange = std::move(exchange);
+  connection->state = Connection::State::kWriting;
+  connection->written = 0;
+  connection->received = false;
+  connection->deadline = Clock::now() + connection->exchange->timeout;
+  connection->reader.reset(&connection->exchange->response,
+                           &connection->exchange->on_chunk);
+  running_[connection->exchange->id] = connection;
+  drive(connection, EPOLLOUT);
+}
+
+void HttpEngine::drive(Connection* connection, uint32_t /*events*/) {
+  using State = Connection::State;
+
+  while (true) {
+    switch (connection->state) {
+#ifdef VSQL_AI_HAVE_NGHTTP2
+      case State::kSession:
+        drive_session(connection);
+        return;
+#else
+      case State::kSession:
+        return;
+#endif
+
+      case State::kIdle:
+        // Idle keep-alive connections only become readable when the server
+        // closes them
+        close(connection);
+        return;
+
+      case State::kConnecting: {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connection->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error == EINPROGRESS || error == EALREADY) {
+          return;
+        }
+        if (error != 0) {
+          fail(connection, "Connection failed", true, false);
+          return;
+        }
+        if (connection->tls) {
+          connection->ssl = SSL_new(ssl_ctx_);
+          const std::string& host = connection->exchange->host;
+          if (!connection->ssl ||
+              SSL_set_fd(connection->ssl, connection->fd) != 1 ||
+              SSL_set_tlsext_host_name(connection->ssl, host.c_str()) != 1 ||
+              SSL_set1_host(connection->ssl, host.c_str()) != 1) {
+            fail(connection, "SSL connection failed", true, false);
+            return;
+          }
+          SSL_set_connect_state(connection->ssl);
+          connection->state = State::kHandshake;
+        } else {
+          hosts_[connection->key].connecting--;
+          connection->state = State::kWriting;
+        }
+        connection->deadline = Clock::now() + connection->exchange->timeout;
+        break;
+      }
+
+      case State::kHandshake: {
+        int result = SSL_connect(connection->ssl);
+        if (result == 1) {
+          hosts_[connection->key].connecting--;
+#ifdef VSQL_AI_HAVE_NGHTTP2
+          const unsigned char* protocol = nullptr;
+          unsigned int length = 0;
+          SSL_get0_alpn_selected(connection->ssl, &protocol, &length);
+          if (length == 2 && memcmp(protocol, "h2", 2) == 0) {
+            start_session(connection);
+            return;
+          }
+#endif
+          connection->state = State::kWriting;
+          break;
+        }
+        int error = SSL_get_error(connection->ssl, result);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+          connection->wanted =
+              error == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT;
+          update_interest(connection);
+          return;
+        }
+        ERR_clear_error();
+        if (SSL_get_verify_result(connection->ssl) != X509_V_OK) {
+          fail(connection, "SSL server verification failed", false, false);
+        } else {
+          fail(connection, "SSL connection failed", true, false);
+        }
+        return;
+      }
+
+      case State::kWriting: {
+        const std::string& wire = connection->exchange->wire;
+        while (connection->written < wire.size()) {
+          const char* data = wire.data() + connection->written;
+          size_t length = wire.size() - connection->written;
+          ssize_t sent;
+          if (connection->ssl) {
+            int result =
+                SSL_write(connection->ssl, data, static_cast<int>(length));
+            sent = result;
+            if (result <= 0) {
+              int error = SSL_get_error(connection->ssl, result);
+              if (error == SSL_ERROR_WANT_READ ||
+                  error == SSL_ERROR_WANT_WRITE) {
+                connection->wanted =
+                    error == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT;
+                update_interest(connection);
+                return;
+              }
+              ERR_clear_error();
+              fail(connection, "Write error", true);
+              return;
+            }
+          } else {
+            sent = ::send(connection->fd, data, length, MSG_NOSIGNAL);
+            if (sent < 0) {
+              if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                connection->wanted = EPOLLOUT;
+                update_interest(connection);
+                return;
+              }
+              fail(connection, "Write error", true);
+              return;
+            }
+          }
+          connection->written += static_cast<size_t>(sent);
+          connection->deadline = Clock::now() + connection->exchange->timeout;
+        }
+        connection->state = State::kReading;
+        break;
+      }
+
+      case State::kReading: {
+        char* buffer = read_buffer_.data();
+        ssize_t received;
+        if (connection->ssl) {
+          int result =
+              SSL_read(connection->ssl, buffer, static_cast<int>(kReadBytes));
+          received = result;
+          if (result <= 0) {
+            int error = SSL_get_error(connection->ssl, result);
+            if (error == SSL_ERROR_WANT_READ ||
+                error == SSL_ERROR_WANT_WRITE) {
+              connection->wanted =
+                  error == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT;
+              update_interest(connection);
+              return;
+            }
+            ERR_clear_error();
+            // close_notify, or a close without one
+            if (error != SSL_ERROR_ZERO_RETURN &&
+                !(error == SSL_ERROR_SYSCALL && errno == 0)) {
+              fail(connection, "Read error", true);
+              return;
+            }
+            received = 0;
+          }
+        } else {
+          received = recv(connection->fd, buffer, kReadBytes, 0);
+          if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+              connection->wanted = EPOLLIN;
+              update_interest(connection);
+              return;
+            }
+            fail(connection, "Read error", true);
+            return;
+          }
+        }
+
+        if (received == 0) {
+          if (connection->reader.end_of_stream()) {
+            finish(connection, false);
+          } else {
+            fail(connection, "Connection closed", true);
+          }
+          return;
+        }
+
+        connection->received = true;
+        connection->deadline = Clock::now() + connection->exchange->timeout;
+        bool had_head = connection->reader.has_head();
+        if (!connection->reader.feed(buffer, static_cast<size_t>(received))) {
+          fail(connection, connection->reader.error(), false, false);
+          return;
+        }
+        if (!had_head && connection->reader.has_head() &&
+            connection->exchange->control) {
+          connection->exchange->control->mark_responded();
+        }
+        if (connection->reader.stopped()) {
+          finish(connection, false);
+          return;
+        }
+        if (connection->reader.done()) {
+          finish(connection, connection->reader.keep_alive());
+          return;
+        }
+        break;
+      }
+    }
+  }
+}
+
+void HttpEngine::update_interest(Connection* connection) {
+  if (connection->wanted == connection->registered) {
+    return;
+  }
+  epoll_event event = {};
+  event.events = connection->wanted;
+  event.data.u64 = connection->id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection->fd, &event);
+  connection->registered = connection->wanted;
+}
+
+void HttpEngine::finish(Connection* connection, bool reusable) {
+  std::unique_ptr<Exchange> exchange = std::move(connection->exchange);
+  running_.erase(exchange->id);
+
+  if (reusable) {
+    connection->used = true;
+    connection->state = Connection::State::kIdle;
+    connection->idle_since = Clock::now();
+    connection->wanted = EPOLLIN;
+    update_interest(connection);
+
+    Host& host = hosts_[connection->key];
+    host.idle.push_back(connection);
+    serve(&host);
+  } else {
+    close(connection);
+  }
+  complete(std::move(exchange));
+}
+
+void HttpEngine::fail(Connection* connection, const std::string& error,
+                      bool transient, bool retry_stale) {
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  if (connection->session) {
+    fail_session(connection, error, transient, retry_stale);
+    return;
+  }
+#endif
+  std::unique_ptr<Exchange> exchange = std::move(connection->exchange);
+  if (exchange) {
+    running_.erase(exchange->id);
+  }
+  bool stale = retry_stale && exchange && connection->used &&
+               !connection->received && !exchange->resent;
+  close(connection);
+  if (!exchange) {
+    return;
+  }
+
+  if (stale) {
+    exchange->resent = true;
+    dispatch(std::move(exchange));
+    return;
+  }
+  exchange->response.status_code = 0;
+  exchange->response.error = error;
+  exchange->response.transient = transient;
+  complete(std::move(exchange));
+}
+
+void HttpEngine::close(Connection* connection) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  if (connection->session) {
+    nghttp2_session_del(connection->session);
+  }
+#endif
+  if (connection->ssl) {
+    SSL_free(connection->ssl);
+  }
+  ::close(connection->fd);
+
+  Host& host = hosts_[connection->key];
+  host.idle.erase(std::remove(host.idle.begin(), host.idle.end(), connection),
+                  host.idle.end());
+  host.sessions.erase(
+      std::remove(host.sessions.begin(), host.sessions.end(), connection),
+      host.sessions.end());
+  host.open--;
+  if (connection->state == Connection::State::kConnecting ||
+      connection->state == Connection::State::kHandshake) {
+    host.connecting--;
+  }
+  if (connection->exchange) {
+    running_.erase(connection->exchange->id);
+  }
+  connections_.erase(connection->id);
+
+  // A queued request can have the freed slot
+  serve(&host);
+}
+
+void HttpEngine::complete(std::unique_ptr<Exchange> exchange) {
+  if (exchange->control) {
+    exchange->control->detach();
+  }
+  exchange->done(std::move(exchange->response));
+}
+
+void HttpEngine::cancel_exchange(uint64_t id) {
+  std::unique_ptr<Exchange> exchange;
+  auto running = running_.find(id);
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  if (running != running_.end() && running->second->session) {
+    Connection* connection = running->second;
+    for (auto& stream : connection->streams) {
+      if (stream->exchange && stream->exchange->id == id) {
+        abandon(connection, stream.get(), kCanceled, false);
+        break;
+      }
+    }
+    drive_session(connection);  // send the reset
+    return;
+  }
+#endif
+  if (running != running_.end()) {
+    Connection* connection = running->second;
+    exchange = std::move(connection->exchange);
+    running_.erase(running);
+    close(connection);
+  } else {
+    for (auto& entry : hosts_) {
+      auto& waiting = entry.second.waiting;
+      auto found = std::find_if(
+          waiting.begin(), waiting.end(),
+          [id](const std::unique_ptr<Exchange>& queued) {
+            return queued->id == id;
+          });
+      if (found != waiting.end()) {
+        exchange = std::move(*found);
+        waiting.erase(found);
+        break;
+      }
+    }
+  }
+
+  // Already finished
+  if (!exchange) {
+    return;
+  }
+  exchange->response.status_code = 0;
+  exchange->response.error = kCanceled;
+  exchange->response.transient = false;
+  complete(std::move(exchange));
+}
+
+void HttpEngine::expire(Clock::time_point now) {
+  std::vector<uint64_t> timed_out;
+  std::vector<uint64_t> idle_expired;
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  std::vector<uint64_t> sessions;
+#endif
+  for (const auto& entry : connections_) {
+    const Connection& connection = *entry.second;
+#ifdef VSQL_AI_HAVE_NGHTTP2
+    if (connection.session) {
+      sessions.push_back(connection.id);
+      continue;
+    }
+#endif
+    if (connection.exchange) {
+      if (now >= connection.deadline) {
+        timed_out.push_back(connection.id);
+      }
+    } else if (now - connection.idle_since >= idle_timeout_) {
+      idle_expired.push_back(connection.id);
+    }
+  }
+
+  for (uint64_t id : timed_out) {
+    auto found = connections_.find(id);
+    if (found == connections_.end()) {
+      continue;
+    }
+    Connection* connection = found->second.get();
+    bool connecting = connection->state == Connection::State::kConnecting ||
+                      connection->state == Connection::State::kHandshake;
+    fail(connection, connecting ? "Connection timed out" : "Request timed out",
+         true, false);
+  }
+  for (uint64_t id : idle_expired) {
+    auto found = connections_.find(id);
+    if (found != connections_.end()) {
+      close(found->second.get());
+    }
+  }
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  for (uint64_t id : sessions) {
+    auto found = connections_.find(id);
+    if (found == connections_.end()) {
+      continue;
+    }
+    Connection* connection = found->second.get();
+    if (connection->streams.empty()) {
+      if (now - connection->idle_since >= idle_timeout_) {
+        close(connection);
+      }
+      continue;
+    }
+    bool expired = false;
+    for (auto& stream : connection->streams) {
+      if (stream->exchange && now >= stream->deadline) {
+        abandon(connection, stream.get(), "Request timed out", true);
+        expired = true;
+      }
+    }
+    if (expired) {
+      drive_session(connection);
+    }
+  }
+#endif
+
+  // Requests queued for a connection give up after their timeout, like the
+  // httplib backend's pool
+  for (auto& entry : hosts_) {
+    auto& waiting = entry.second.waiting;
+    while (!waiting.empty() &&
+           now - waiting.front()->queued_at >= waiting.front()->timeout) {
+      auto exchange = std::move(waiting.front());
+      waiting.pop_front();
+      exchange->response.error = "Connection pool exhausted for " + entry.first;
+      complete(std::move(exchange));
+    }
+  }
+}
+
+int HttpEngine::next_timeout_ms(Clock::time_point now) const {
+  auto next = now + std::chrono::milliseconds(kMaxWaitMs);
+  for (const auto& entry : connections_) {
+    const Connection& connection = *entry.second;
+#ifdef VSQL_AI_HAVE_NGHTTP2
+    if (connection.session) {
+      if (connection.streams.empty()) {
+        next = std::min(next, connection.idle_since + idle_timeout_);
+      }
+      for (const auto& stream : connection.streams) {
+        if (stream->exchange) {
+          next = std::min(next, stream->deadline);
+        }
+      }
+      continue;
+    }
+#endif
+    next = std::min(next, connection.exchange
+                              ? connection.deadline
+                              : connection.idle_since + idle_timeout_);
+  }
+  for (const auto& entry : hosts_) {
+    if (!entry.second.waiting.empty()) {
+      const Exchange& first = *entry.second.waiting.front();
+      next = std::min(next, first.queued_at + first.timeout);
+    }
+  }
+  auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now);
+  // Round up, so a deadline is not polled for repeatedly just before it
+  return std::max<int>(0, static_cast<int>(wait.count()) + 1);
+}
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+
+// =============================================================================
+// HTTP/2
+// =============================================================================
+
+struct HttpEngine::Http2 {
+  static Stream* stream(nghttp2_session* session, int32_t stream_id) {
+    auto* stream = static_cast<Stream*>(
+        nghttp2_session_get_stream_user_data(session, stream_id));
+    return stream && stream->exchange ? stream : nullptr;
+  }
+
+  static int on_header(nghttp2_session* session, const nghttp2_frame* frame,
+                       const uint8_t* name, size_t name_length,
+                       const uint8_t* value, size_t value_length,
+                       uint8_t /*flags*/, void* /*user_data*/) {
+    Stream* found = stream(session, frame->hd.stream_id);
+    if (frame->hd.type != NGHTTP2_HEADERS || !found) {
+      return 0;
+    }
+    std::string_view header_name(reinterpret_cast<const char*>(name),
+                                 name_length);
+    std::string_view header_value(reinterpret_cast<const char*>(value),
+                                  value_length);
+    HttpClient::Response& response = found->exchange->response;
+    found->received = true;
+    if (header_name == ":status") {
+      // Each interim (1xx) response is replaced by the next
+      response.status_code = std::atoi(std::string(header_value).c_str());
+      response.headers.clear();
+    } else if (!header_name.empty() && header_name[0] != ':') {
+      // HTTP/2 header names are lower case already
+      response.headers[std::string(header_name)] = std::string(header_value);
+    }
+    return 0;
+  }
+
+  static int on_frame_recv(nghttp2_session* session,
+                           const nghttp2_frame* frame, void* user_data) {
+    auto* connection = static_cast<Connection*>(user_data);
+    if (frame->hd.type == NGHTTP2_GOAWAY) {
+      connection->going_away = true;
+      return 0;
+    }
+    Stream* found = stream(session, frame->hd.stream_id);
+    if (!found) {
+      return 0;
+    }
+    found->deadline = Clock::now() + found->exchange->timeout;
+    if (frame->hd.type == NGHTTP2_HEADERS && !found->responded &&
+        found->exchange->response.status_code >= 200) {
+      found->responded = true;
+      if (found->exchange->control) {
+        found->exchange->control->mark_responded();
+      }
+      if (!found->body.start()) {
+        connection->engine->abandon(connection, found,
+                                    found->body.error().c_str(), false);
+      }
+    }
+    return 0;
+  }
+
+  static int on_data_chunk_recv(nghttp2_session* session, uint8_t /*flags*/,
+                                int32_t stream_id, const uint8_t* data,
+                                size_t length, void* user_data) {
+    Stream* found = stream(session, stream_id);
+    if (!found || found->stopped) {
+      return 0;
+    }
+    found->received = true;
+    if (found->body.receive(reinterpret_cast<const char*>(data), length)) {
+      return 0;
+    }
+    if (found->body.stopped()) {
+      // Unlike HTTP/1.1, the connection stays usable
+      found->stopped = true;
+      nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id,
+                                NGHTTP2_CANCEL);
+    } else {
+      auto* connection = static_cast<Connection*>(user_data);
+      connection->engine->abandon(connection, found,
+                                  found->body.error().c_str(), false);
+    }
+    return 0;
+  }
+
+  static int on_stream_close(nghttp2_session* session, int32_t stream_id,
+                             uint32_t error_code, void* user_data) {
+    auto* closed = static_cast<Stream*>(
+        nghttp2_session_get_stream_user_data(session, stream_id));
+    if (closed) {
+      auto* connection = static_cast<Connection*>(user_data);
+      connection->engine->close_stream(connection, closed, error_code);
+    }
+    return 0;
+  }
+
+  static ssize_t read_body(nghttp2_session* /*session*/, int32_t /*stream_id*/,
+                           uint8_t* buffer, size_t length,
+                           uint32_t* data_flags, nghttp2_data_source* source,
+                           void* /*user_data*/) {
+    auto* sending = static_cast<Stream*>(source->ptr);
+    if (!sending->exchange) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+      return 0;
+    }
+    const std::string& wire = sending->exchange->wire;
+    size_t count = std::min(length, wire.size() - sending->body_sent);
+    memcpy(buffer, wire.data() + sending->body_sent, count);
+    sending->body_sent += count;
+    if (sending->body_sent == wire.size()) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return static_cast<ssize_t>(count);
+  }
+};
+
+void HttpEngine::start_session(Connection* connection) {
+  nghttp2_session_callbacks* callbacks;
+  nghttp2_session_callbacks_new(&callbacks);
+  nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                   Http2::on_header);
+  nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
+                                                       Http2::on_frame_recv);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(
+      callbacks, Http2::on_data_chunk_recv);
+  nghttp2_session_callbacks_set_on_stream_close_callback(
+      callbacks, Http2::on_stream_close);
+  int result =
+      nghttp2_session_client_new(&connection->session, callbacks, connection);
+  nghttp2_session_callbacks_del(callbacks);
+  if (result != 0) {
+    connection->session = nullptr;
+    fail(connection, "SSL connection failed", true, false);
+    return;
+  }
+
+  nghttp2_settings_entry settings[] = {
+      {NGHTTP2_SETTINGS_ENABLE_PUSH, 0},
+      {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, kStreamWindow}};
+  nghttp2_submit_settings(connection->session, NGHTTP2_FLAG_NONE, settings,
+                          sizeof(settings) / sizeof(settings[0]));
+  nghttp2_session_set_local_window_size(connection->session, NGHTTP2_FLAG_NONE,
+                                        0, kSessionWindow);
+
+  connection->state = Connection::State::kSession;
+  connection->idle_since = Clock::now();
+  Host& host = hosts_[connection->key];
+  host.http2 = true;
+  host.sessions.push_back(connection);
+
+  // The request that opened the connection becomes its first stream, and
+  // whatever queued up meanwhile follows it
+  std::unique_ptr<Exchange> exchange = std::move(connection->exchange);
+  running_.erase(exchange->id);
+  open_stream(connection, std::move(exchange));
+  serve(&host);
+}
+
+HttpEngine::Connection* HttpEngine::available_session(Host* host) {
+  for (Connection* connection : host->sessions) {
+    uint32_t limit = std::min(
+        kMaxStreamsPerSession,
+        nghttp2_session_get_remote_settings(
+            connection->session, NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS));
+    if (!connection->going_away && connection->streams.size() < limit) {
+      return connection;
+    }
+  }
+  return nullptr;
+}
+
+void HttpEngine::open_stream(Connection* connection,
+                             std::unique_ptr<Exchange> exchange) {
+  // The request goes out as the same head that was serialized for HTTP/1.1:
+  // "<method> <path> HTTP/1.1", then one header per line
+  std::string_view head(exchange->wire.data(), exchange->body_offset - 4);
+  size_t eol = head.find("\r\n");
+  std::string_view request_line = head.substr(0, eol);
+  size_t space = request_line.find(' ');
+  std::string_view method = request_line.substr(0, space);
+  std::string_view path =
+      request_line.substr(space + 1, request_line.rfind(' ') - space - 1);
+  head.remove_prefix(std::min(head.size(), eol + 2));
+
+  std::vector<std::string> names;
+  std::vector<std::string_view> values;
+  names.reserve(16);
+  values.reserve(16);
+  names.push_back(":method");
+  values.push_back(method);
+  names.push_back(":scheme");
+  values.push_back(exchange->scheme);
+  names.push_back(":path");
+  values.push_back(path);
+  while (!head.empty()) {
+    eol = head.find("\r\n");
+    std::string_view line = head.substr(0, eol);
+    head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+    std::string name(trim(line.substr(0, colon)));
+    to_lower(&name);
+    std::string_view value = trim(line.substr(colon + 1));
+    if (name == "host") {
+      name = ":authority";
+    } else if (name == "connection" || name == "keep-alive" ||
+               name == "proxy-connection" || name == "transfer-encoding" ||
+               name == "upgrade") {
+      continue;  // not allowed in HTTP/2
+    }
+    names.push_back(std::move(name));
+    values.push_back(value);
+  }
+
+  std::vector<nghttp2_nv> fields(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    fields[i].name = reinterpret_cast<uint8_t*>(names[i].data());
+    fields[i].namelen = names[i].size();
+    fields[i].value =
+        reinterpret_cast<uint8_t*>(const_cast<char*>(values[i].data()));
+    fields[i].valuelen = values[i].size();
+    fields[i].flags = NGHTTP2_NV_FLAG_NONE;
+  }
+
+  auto stream = std::make_unique<Stream>();
+  stream->body_sent = exchange->body_offset;
+  stream->deadline = Clock::now() + exchange->timeout;
+  bool has_body = exchange->body_offset < exchange->wire.size();
+  uint64_t exchange_id = exchange->id;
+  stream->exchange = std::move(exchange);
+  stream->body.reset(&stream->exchange->response, &stream->exchange->on_chunk);
+
+  nghttp2_data_provider body;
+  body.source.ptr = stream.get();
+  body.read_callback = Http2::read_body;
+  int32_t stream_id = nghttp2_submit_request(
+      connection->session, nullptr, fields.data(), fields.size(),
+      has_body ? &body : nullptr, stream.get());
+  if (stream_id < 0) {
+    // Out of stream ids; later requests go to another connection
+    connection->going_away = true;
+    dispatch(std::move(stream->exchange));
+    return;
+  }
+
+  stream->id = stream_id;
+  running_[exchange_id] = connection;
+  connection->streams.push_back(std::move(stream));
+  connection->wanted = EPOLLIN | EPOLLOUT;
+  update_interest(connection);
+}
+
+void HttpEngine::drive_session(Connection* connection) {
+  // Take in everything the server sent; nghttp2 calls back as frames complete
+  while (true) {
+    char* buffer = read_buffer_.data();
+    int result =
+        SSL_read(connection->ssl, buffer, static_cast<int>(kReadBytes));
+    if (result <= 0) {
+      int error = SSL_get_error(connection->ssl, result);
+      if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        break;
+      }
+      ERR_clear_error();
+      bool closed = error == SSL_ERROR_ZERO_RETURN ||
+                    (error == SSL_ERROR_SYSCALL && errno == 0);
+      fail_session(connection, closed ? "Connection closed" : "Read error",
+                   true, true);
+      return;
+    }
+    if (nghttp2_session_mem_recv(connection->session,
+                                 reinterpret_cast<const uint8_t*>(buffer),
+                                 static_cast<size_t>(result)) < 0) {
+      fail_session(connection, "Invalid HTTP response", false, false);
+      return;
+    }
+  }
+
+  // Then write whatever frames are due, until the socket is full
+  while (true) {
+    if (connection->output_written == connection->output.size()) {
+      connection->output.clear();
+      connection->output_written = 0;
+      while (connection->output.size() < kMaxOutputBytes) {
+        const uint8_t* data;
+        ssize_t length = nghttp2_session_mem_send(connection->session, &data);
+        if (length < 0) {
+          fail_session(connection, "Write error", true, false);
+          return;
+        }
+        if (length == 0) {
+          break;
+        }
+        connection->output.append(reinterpret_cast<const char*>(data),
+                                  static_cast<size_t>(length));
+      }
+      if (connection->output.empty()) {
+        break;
+      }
+    }
+
+    // Retried with the same bytes after WANT_WRITE, as OpenSSL requires
+    int result = SSL_write(
+        connection->ssl, connection->output.data() + connection->output_written,
+        static_cast<int>(connection->output.size() -
+                         connection->output_written));
+    if (result <= 0) {
+      int error = SSL_get_error(connection->ssl, result);
+      if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        connection->wanted = error == SSL_ERROR_WANT_WRITE
+                                 ? static_cast<uint32_t>(EPOLLIN | EPOLLOUT)
+                                 : static_cast<uint32_t>(EPOLLIN);
+        update_interest(connection);
+        return;
+      }
+      ERR_clear_error();
+      fail_session(connection, "Write error", true, true);
+      return;
+    }
+    connection->output_written += static_cast<size_t>(result);
+  }
+
+  // The server said goodbye and every stream is over
+  if (!nghttp2_session_want_read(connection->session) &&
+      !nghttp2_session_want_write(connection->session)) {
+    close(connection);
+    return;
+  }
+  connection->wanted = EPOLLIN;
+  update_interest(connection);
+
+  // Streams that closed made room for queued requests
+  serve(&hosts_[connection->key]);
+}
+
+void HttpEngine::close_stream(Connection* connection, Stream* stream,
+                              uint32_t error_code) {
+  std::unique_ptr<Exchange> exchange = std::move(stream->exchange);
+  bool stopped = stream->stopped;
+  bool received = stream->received;
+  nghttp2_session_set_stream_user_data(connection->session, stream->id,
+                                       nullptr);
+  auto& streams = connection->streams;
+  streams.erase(std::find_if(streams.begin(), streams.end(),
+                             [stream](const std::unique_ptr<Stream>& open) {
+                               return open.get() == stream;
+                             }));
+  if (streams.empty()) {
+    connection->idle_since = Clock::now();
+  }
+
+  // Completed early
+  if (!exchange) {
+    return;
+  }
+  running_.erase(exchange->id);
+
+  if (error_code == NGHTTP2_NO_ERROR || stopped) {
+    complete(std::move(exchange));
+    return;
+  }
+  // Refused streams were never processed, so they are safe to send again
+  if (error_code == NGHTTP2_REFUSED_STREAM && !received && !exchange->resent) {
+    exchange->resent = true;
+    dispatch(std::move(exchange));
+    return;
+  }
+  exchange->response.status_code = 0;
+  exchange->response.error = "Stream reset";
+  exchange->response.transient = true;
+  complete(std::move(exchange));
+}
+
+void HttpEngine::abandon(Connection* connection, Stream* stream,
+                         const char* error, bool transient) {
+  std::unique_ptr<Exchange> exchange = std::move(stream->exchange);
+  running_.erase(exchange->id);
+  nghttp2_submit_rst_stream(connection->session, NGHTTP2_FLAG_NONE, stream->id,
+                            NGHTTP2_CANCEL);
+  exchange->response.status_code = 0;
+  exchange->response.error = error;
+  exchange->response.transient = transient;
+  complete(std::move(exchange));
+}
+
+void HttpEngine::fail_session(Connection* connection, const std::string& error,
+                              bool transient, bool retry_stale) {
+  std::vector<std::unique_ptr<Exchange>> resend;
+  for (auto& stream : connection->streams) {
+    std::unique_ptr<Exchange> exchange = std::move(stream->exchange);
+    if (!exchange) {
+      continue;
+    }
+    running_.erase(exchange->id);
+    // As with a stale HTTP/1.1 connection
+    if (retry_stale && !stream->received && !exchange->resent) {
+      exchange->resent = true;
+      resend.push_back(std::move(exchange));
+      continue;
+    }
+    exchange->response.status_code = 0;
+    exchange->response.error = error;
+    exchange->response.transient = transient;
+    complete(std::move(exchange));
+  }
+  connection->streams.clear();
+  close(connection);
+  for (auto& exchange : resend) {
+    dispatch(std::move(exchange));
+  }
+}
+
+#endif  // VSQL_AI_HAVE_NGHTTP2
+
+}  // namespace vsql_ai
+
+#else  // !__linux__
+
+namespace vsql_ai {
+
+// Never created; complete only so the members can be destroyed
+struct HttpEngine::Exchange {};
+struct HttpEngine::Connection {};
+
+HttpEngine& HttpEngine::instance() {
+  static HttpEngine engine;
+  return engine;
+}
+
+HttpEngine::HttpEngine() : max_connections_per_host_(0), idle_timeout_(0) {}
+
+HttpEngine::~HttpEngine() {}
+
+void HttpEngine::submit(Request /*request*/, Completion done) {
+  HttpClient::Response response;
+  response.status_code = 0;
+  response.error = "HTTP engine is not enabled";
+  done(std::move(response));
+}
+
+HttpClient::Response HttpEngine::send(Request request) {
+  HttpClient::Response response;
+  submit(std::move(request), [&response](HttpClient::Response result) {
+    response = std::move(result);
+  });
+  return response;
+}
+
+}  // namespace vsql_ai
+
+#endif  // __linux__
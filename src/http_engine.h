@@ -0,0 +1,171 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_HTTP_ENGINE_H
+#define VSQL_AI_HTTP_ENGINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "http_client.h"
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+namespace vsql_ai {
+
+// Event-driven HTTP client, selected with VSQL_AI_HTTP_BACKEND=epoll.
+//
+// One thread multiplexes every request over non-blocking sockets with epoll,
+// with its own keep-alive connections (at most MAX_CONNECTIONS_PER_HOST per
+// host, further requests queue for one). HttpClient routes its requests
+// here when it is enabled, so callers keep their interface; submit() lets a
+// caller keep many requests in flight without a thread for each.
+//
+// Built with nghttp2 (VSQL_AI_HAVE_NGHTTP2), HTTPS connections offer HTTP/2
+// through ALPN unless VSQL_AI_HTTP2=0. Once a host has agreed, its requests
+// become streams sharing a connection, up to the server's stream limit,
+// instead of each holding a connection of its own.
+class HttpEngine {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Completion = std::function<void(HttpClient::Response response)>;
+
+  struct Request {
+    const HttpClient::Endpoint* endpoint = nullptr;
+    int timeout_seconds = 30;
+
+    // Only read by submit(), which serializes the request
+    std::string_view method = "POST";  // or "GET", without a body
+    std::string_view path;  // after the endpoint's base path
+    std::string_view body;
+    const std::map<std::string, std::string>* headers = nullptr;
+
+    // Receives a 2xx body as it arrives, on the engine thread, as
+    // HttpClient::post_stream() describes; empty to buffer the body
+    HttpClient::ChunkHandler on_chunk;
+
+    // Optional; must outlive the request
+    HttpClient::RequestControl* control = nullptr;
+  };
+
+  static HttpEngine& instance();
+
+  bool enabled() const { return enabled_; }
+
+  // Start a request. done is called once with the response or error, on
+  // the engine thread; it must not block. Fails at once unless enabled().
+  void submit(Request request, Completion done);
+
+  // Run a request and wait for it
+  HttpClient::Response send(Request request);
+
+ private:
+  struct Exchange;
+  struct Connection;
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  struct Stream;
+  struct Http2;  // nghttp2 callbacks
+#endif
+
+  // Connections and queued requests of one scheme://host:port
+  struct Host {
+    std::vector<Connection*> idle;      // HTTP/1.1, most recently used last
+    std::vector<Connection*> sessions;  // HTTP/2
+    size_t open = 0;
+    size_t connecting = 0;  // of open, not yet through the TLS handshake
+    bool http2 = false;     // negotiated by an earlier connection
+    std::deque<std::unique_ptr<Exchange>> waiting;
+  };
+
+  HttpEngine();
+  ~HttpEngine();
+
+  void wake();
+  void run();
+
+  // Engine thread only
+  void take_submissions();
+  void dispatch(std::unique_ptr<Exchange> exchange);
+  // Hand the host's queued requests to connections, new ones if allowed
+  void serve(Host* host);
+  void start(Connection* connection, std::unique_ptr<Exchange> exchange);
+  bool connect(Host* host, std::unique_ptr<Exchange>* exchange);
+  void drive(Connection* connection, uint32_t events);
+  void update_interest(Connection* connection);
+  void finish(Connection* connection, bool reusable);
+  // Fail the connection's exchange. A request that never got a byte back
+  // on a reused connection was most likely sent to a keep-alive socket the
+  // server had closed, and is resent once on a new one if retry_stale.
+  void fail(Connection* connection, const std::string& error, bool transient,
+            bool retry_stale = true);
+  void close(Connection* connection);
+  void complete(std::unique_ptr<Exchange> exchange);
+  void cancel_exchange(uint64_t id);
+  void expire(Clock::time_point now);
+  int next_timeout_ms(Clock::time_point now) const;
+
+#ifdef VSQL_AI_HAVE_NGHTTP2
+  void start_session(Connection* connection);
+  Connection* available_session(Host* host);
+  void open_stream(Connection* connection, std::unique_ptr<Exchange> exchange);
+  void drive_session(Connection* connection);
+  // Called by nghttp2 once a stream is over
+  void close_stream(Connection* connection, Stream* stream,
+                    uint32_t error_code);
+  // Complete a stream's request early and reset the stream
+  void abandon(Connection* connection, Stream* stream, const char* error,
+               bool transient);
+  void fail_session(Connection* connection, const std::string& error,
+                    bool transient, bool retry_stale);
+#endif
+
+  bool enabled_ = false;
+  bool http2_ = false;
+  SSL_CTX* ssl_ctx_ = nullptr;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  size_t max_connections_per_host_;
+  std::chrono::seconds idle_timeout_;
+  std::thread thread_;
+
+  // Shared with submitting threads
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Exchange>> submitted_;
+  std::vector<uint64_t> cancelled_;
+  uint64_t next_exchange_id_ = 1;
+  bool stopping_ = false;
+
+  // Engine thread only
+  std::map<std::string, Host> hosts_;
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+  std::unordered_map<uint64_t, Connection*> running_;  // by exchange id
+  uint64_t next_connection_id_ = 1;
+  std::vector<char> read_buffer_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_HTTP_ENGINE_H
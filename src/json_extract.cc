@@ -0,0 +1,585 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "json_extract.h"
+
+#include <array>
+#include <initializer_list>
+
+#include "float_chars.h"
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace vsql_ai {
+
+namespace {
+
+// Responses nest a handful of levels; anything deeper is parsed but never
+// matches a path
+constexpr size_t kMaxDepth = 8;
+
+// Deeper documents are rejected by EmbeddingScanner, which recurses
+constexpr size_t kMaxNesting = 64;
+
+// SAX handler that tracks the path from the root to the current value, so
+// subclasses can pick out fields by path. It also captures the top-level
+// error object.
+class PathHandler : public nlohmann::json_sax<json> {
+ public:
+  explicit PathHandler(ApiError* api_error) : api_error_(api_error) {}
+
+  bool null() override { return value_done(); }
+  bool boolean(bool value) override { return value_done(); }
+
+  bool number_integer(number_integer_t value) override { return value_done(); }
+  bool number_unsigned(number_unsigned_t value) override {
+    on_unsigned(value);
+    return value_done();
+  }
+  bool number_float(number_float_t value, const string_t& text) override {
+    return value_done();
+  }
+
+  bool string(string_t& value) override {
+    if (api_error_ && depth_ == 2 && frames_[0].key == "error") {
+      const std::string& field = frames_[1].key;
+      if (field == "message") {
+        api_error_->message = value;
+      } else if ((field == "status" || field == "type") &&
+                 api_error_->message.empty()) {
+        api_error_->message = value;
+      }
+    }
+    on_string(value);
+    return value_done();
+  }
+
+  bool binary(binary_t& value) override { return value_done(); }
+
+  bool start_object(std::size_t elements) override {
+    if (api_error_ && at({"error"})) {
+      api_error_->present = true;
+    }
+    push(false);
+    return true;
+  }
+
+  bool key(string_t& name) override {
+    if (depth_ <= kMaxDepth) {
+      frames_[depth_ - 1].key.assign(name);
+    }
+    return true;
+  }
+
+  bool end_object() override {
+    pop();
+    return value_done();
+  }
+
+  bool start_array(std::size_t elements) override {
+    push(true);
+    return true;
+  }
+
+  bool end_array() override {
+    pop();
+    return value_done();
+  }
+
+  bool parse_error(std::size_t position, const std::string& last_token,
+                   const nlohmann::detail::exception& ex) override {
+    error_ = std::string("JSON parse error: ") + ex.what();
+    return false;
+  }
+
+  const std::string& error() const { return error_; }
+
+ protected:
+  // Whether the current value is at path. "*" matches any array index and a
+  // number one index, e.g. {"candidates", "0", "content"}.
+  bool at(std::initializer_list<std::string_view> path) const {
+    if (path.size() != depth_ || depth_ > kMaxDepth) {
+      return false;
+    }
+    const Frame* frame = frames_.data();
+    for (std::string_view segment : path) {
+      if (!frame->array) {
+        if (frame->key != segment) {
+          return false;
+        }
+      } else if (segment != "*") {
+        size_t index = 0;
+        for (char c : segment) {
+          if (c < '0' || c > '9') {
+            return false;
+          }
+          index = index * 10 + static_cast<size_t>(c - '0');
+        }
+        if (frame->index != index) {
+          return false;
+        }
+      }
+      frame++;
+    }
+    return true;
+  }
+
+  // Called with each string value; at() names its path
+  virtual void on_string(std::string& value) {}
+
+  // Called with each non-negative integer value
+  virtual void on_unsigned(uint64_t value) {}
+
+ private:
+  struct Frame {
+    bool array = false;
+    size_t index = 0;  // of the current element, in arrays
+    std::string key;   // of the current member, in objects
+  };
+
+  void push(bool array) {
+    if (depth_ < kMaxDepth) {
+      Frame& frame = frames_[depth_];
+      frame.array = array;
+      frame.index = 0;
+      frame.key.clear();
+    }
+    depth_++;
+  }
+
+  void pop() { depth_--; }
+
+  bool value_done() {
+    if (depth_ > 0 && depth_ <= kMaxDepth && frames_[depth_ - 1].array) {
+      frames_[depth_ - 1].index++;
+    }
+    return true;
+  }
+
+  ApiError* api_error_;
+  std::array<Frame, kMaxDepth> frames_;
+  size_t depth_ = 0;
+  std::string error_;
+};
+
+// Scanner for embedding responses, which are almost entirely numbers. It
+// walks the document structure without decoding anything but the values
+// arrays, whose numbers go straight through parse_float() into floats:
+// several times faster than the SAX lexer. Scalars elsewhere are skipped
+// without being validated, and error bodies are left to PathHandler.
+class EmbeddingScanner {
+ public:
+  EmbeddingScanner(std::string_view body,
+                   std::vector<std::vector<float>>* embeddings)
+      : p_(body.data()), end_(body.data() + body.size()),
+        begin_(body.data()), embeddings_(embeddings) {}
+
+  // Returns false and sets *error if the body is malformed. *has_error is
+  // set if the root object has an "error" member.
+  bool scan(bool* has_error, std::string* error) {
+    has_error_ = has_error;
+    skip_space();
+    if (!value(Context::kRoot) || (skip_space(), p_ != end_)) {
+      *error = "JSON parse error at byte " + std::to_string(p_ - begin_);
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  // Where a value sits, as far as the embedding fields are concerned
+  enum class Context {
+    kRoot,
+    kEmbedding,        // root.embedding
+    kEmbeddingsArray,  // root.embeddings
+    kEmbeddingsItem,   // root.embeddings[i]
+    kValues,           // .values of either
+    kOther
+  };
+
+  void skip_space() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+      p_++;
+    }
+  }
+
+  bool consume(char c) {
+    skip_space();
+    if (p_ < end_ && *p_ == c) {
+      p_++;
+      return true;
+    }
+    return false;
+  }
+
+  // Skip a string, setting *raw to its undecoded contents
+  bool string(std::string_view* raw) {
+    const char* start = ++p_;
+    while (p_ < end_ && *p_ != '"') {
+      if (static_cast<unsigned char>(*p_) < 0x20) {
+        return false;
+      }
+      p_ += *p_ == '\\' ? 2 : 1;
+    }
+    if (p_ >= end_) {
+      return false;
+    }
+    *raw = std::string_view(start, p_ - start);
+    p_++;
+    return true;
+  }
+
+  // Skip a number or literal
+  bool scalar() {
+    const char* start = p_;
+    while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+           *p_ != ' ' && *p_ != '\n' && *p_ != '\r' && *p_ != '\t') {
+      p_++;
+    }
+    return p_ > start;
+  }
+
+  bool numbers(std::vector<float>* values) {
+    p_++;
+    if (consume(']')) {
+      return true;
+    }
+    while (true) {
+      skip_space();
+      float value;
+      const char* parsed = parse_float(p_, end_, &value);
+      if (parsed == nullptr) {
+        return false;
+      }
+      values->push_back(value);
+      p_ = parsed;
+      if (consume(']')) {
+        return true;
+      }
+      if (!consume(',')) {
+        return false;
+      }
+    }
+  }
+
+  bool value(Context context) {
+    if (p_ >= end_) {
+      return false;
+    }
+    switch (*p_) {
+      case '{':
+        return object(context);
+      case '[':
+        if (context == Context::kValues) {
+          embeddings_->emplace_back();
+          return numbers(&embeddings_->back());
+        }
+        return array(context == Context::kEmbeddingsArray
+                         ? Context::kEmbeddingsItem
+                         : Context::kOther);
+      case '"': {
+        std::string_view raw;
+        return string(&raw);
+      }
+      default:
+        return scalar();
+    }
+  }
+
+  bool object(Context context) {
+    if (++nesting_ > kMaxNesting) {
+      return false;
+    }
+    p_++;
+    if (consume('}')) {
+      nesting_--;
+      return true;
+    }
+    while (true) {
+      skip_space();
+      std::string_view key;
+      if (p_ >= end_ || *p_ != '"' || !string(&key) || !consume(':')) {
+        return false;
+      }
+
+      Context member = Context::kOther;
+      if (context == Context::kRoot) {
+        if (key == "embedding") {
+          member = Context::kEmbedding;
+        } else if (key == "embeddings") {
+          member = Context::kEmbeddingsArray;
+        } else if (key == "error") {
+          *has_error_ = true;
+        }
+      } else if ((context == Context::kEmbedding ||
+                  context == Context::kEmbeddingsItem) &&
+                 key == "values") {
+        member = Context::kValues;
+      }
+
+      skip_space();
+      if (!value(member)) {
+        return false;
+      }
+      if (consume('}')) {
+        nesting_--;
+        return true;
+      }
+      if (!consume(',')) {
+        return false;
+      }
+    }
+  }
+
+  bool array(Context element) {
+    if (++nesting_ > kMaxNesting) {
+      return false;
+    }
+    p_++;
+    if (consume(']')) {
+      nesting_--;
+      return true;
+    }
+    while (true) {
+      skip_space();
+      if (!value(element)) {
+        return false;
+      }
+      if (consume(']')) {
+        nesting_--;
+        return true;
+      }
+      if (!consume(',')) {
+        return false;
+      }
+    }
+  }
+
+  const char* p_;
+  const char* end_;
+  const char* begin_;
+  std::vector<std::vector<float>>* embeddings_;
+  bool* has_error_ = nullptr;
+  size_t nesting_ = 0;
+};
+
+class AnthropicEventHandler : public PathHandler {
+ public:
+  AnthropicEventHandler(AnthropicStreamEvent* event, TokenUsage* usage)
+      : PathHandler(&event->error), event_(event), usage_(usage) {}
+
+ protected:
+  void on_string(std::string& value) override {
+    if (at({"type"})) {
+      event_->type = value;
+    } else if (at({"delta", "type"})) {
+      event_->delta_type = value;
+    } else if (at({"delta", "text"})) {
+      event_->delta_text.swap(value);
+    }
+  }
+
+  void on_unsigned(uint64_t value) override {
+    if (at({"message", "usage", "input_tokens"}) ||
+        at({"usage", "input_tokens"})) {
+      usage_->input_tokens = value;
+    } else if (at({"message", "usage", "output_tokens"}) ||
+               at({"usage", "output_tokens"})) {
+      usage_->output_tokens = value;
+    } else if (at({"message", "usage", "cache_read_input_tokens"}) ||
+               at({"usage", "cache_read_input_tokens"})) {
+      usage_->cached_input_tokens = value;
+    }
+  }
+
+ private:
+  AnthropicStreamEvent* event_;
+  TokenUsage* usage_;
+};
+
+class GoogleChunkHandler : public PathHandler {
+ public:
+  GoogleChunkHandler(std::string* text, TokenUsage* usage,
+                     ApiError* api_error)
+      : PathHandler(api_error), text_(text), usage_(usage) {}
+
+ protected:
+  void on_string(std::string& value) override {
+    if (at({"candidates", "0", "content", "parts", "*", "text"})) {
+      text_->append(value);
+    }
+  }
+
+  void on_unsigned(uint64_t value) override {
+    if (at({"usageMetadata", "promptTokenCount"})) {
+      usage_->input_tokens = value;
+    } else if (at({"usageMetadata", "candidatesTokenCount"})) {
+      usage_->output_tokens = value;
+    } else if (at({"usageMetadata", "cachedContentTokenCount"})) {
+      usage_->cached_input_tokens = value;
+    }
+  }
+
+ private:
+  std::string* text_;
+  TokenUsage* usage_;
+};
+
+class CachedContentHandler : public PathHandler {
+ public:
+  CachedContentHandler(std::string* name, ApiError* api_error)
+      : PathHandler(api_error), name_(name) {}
+
+ protected:
+  void on_string(std::string& value) override {
+    if (at({"name"})) {
+      name_->swap(value);
+    }
+  }
+
+ private:
+  std::string* name_;
+};
+
+class MessageBatchHandler : public PathHandler {
+ public:
+  MessageBatchHandler(MessageBatch* batch, ApiError* api_error)
+      : PathHandler(api_error), batch_(batch) {}
+
+ protected:
+  void on_string(std::string& value) override {
+    if (at({"id"})) {
+      batch_->id.swap(value);
+    } else if (at({"processing_status"})) {
+      batch_->processing_status.swap(value);
+    }
+  }
+
+  void on_unsigned(uint64_t value) override {
+    if (at({"request_counts", "processing"})) {
+      batch_->processing = value;
+    } else if (at({"request_counts", "succeeded"})) {
+      batch_->succeeded = value;
+    } else if (at({"request_counts", "errored"})) {
+      batch_->errored = value;
+    } else if (at({"request_counts", "canceled"})) {
+      batch_->canceled = value;
+    } else if (at({"request_counts", "expired"})) {
+      batch_->expired = value;
+    }
+  }
+
+ private:
+  MessageBatch* batch_;
+};
+
+class MessageBatchResultHandler : public PathHandler {
+ public:
+  explicit MessageBatchResultHandler(MessageBatchResult* result)
+      : PathHandler(nullptr), result_(result) {}
+
+ protected:
+  void on_string(std::string& value) override {
+    if (at({"custom_id"})) {
+      result_->custom_id.swap(value);
+    } else if (at({"result", "type"})) {
+      result_->type.swap(value);
+    } else if (at({"result", "message", "content", "*", "text"})) {
+      result_->text.append(value);
+    } else if (at({"result", "error", "error", "message"})) {
+      result_->message.swap(value);
+    }
+  }
+
+  void on_unsigned(uint64_t value) override {
+    if (at({"result", "message", "usage", "input_tokens"})) {
+      result_->usage.input_tokens = value;
+    } else if (at({"result", "message", "usage", "output_tokens"})) {
+      result_->usage.output_tokens = value;
+    } else if (at({"result", "message", "usage",
+                   "cache_read_input_tokens"})) {
+      result_->usage.cached_input_tokens = value;
+    }
+  }
+
+ private:
+  MessageBatchResult* result_;
+};
+
+bool run(std::string_view data, PathHandler* handler, std::string* error) {
+  if (!json::sax_parse(data.data(), data.data() + data.size(), handler)) {
+    *error = handler->error();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool extract_embeddings(std::string_view body,
+                        std::vector<std::vector<float>>* embeddings,
+                        ApiError* api_error, std::string* error) {
+  bool has_error = false;
+  EmbeddingScanner scanner(body, embeddings);
+  if (!scanner.scan(&has_error, error)) {
+    return false;
+  }
+  // Errors are rare; decode their message properly
+  return !has_error || extract_api_error(body, api_error, error);
+}
+
+bool extract_anthropic_event(std::string_view data,
+                             AnthropicStreamEvent* event, TokenUsage* usage,
+                             std::string* error) {
+  AnthropicEventHandler handler(event, usage);
+  return run(data, &handler, error);
+}
+
+bool extract_google_chunk(std::string_view data, std::string* text,
+                          TokenUsage* usage, ApiError* api_error,
+                          std::string* error) {
+  GoogleChunkHandler handler(text, usage, api_error);
+  return run(data, &handler, error);
+}
+
+bool extract_cached_content(std::string_view body, std::string* name,
+                            ApiError* api_error, std::string* error) {
+  CachedContentHandler handler(name, api_error);
+  return run(body, &handler, error);
+}
+
+bool extract_message_batch(std::string_view body, MessageBatch* batch,
+                           ApiError* api_error, std::string* error) {
+  MessageBatchHandler handler(batch, api_error);
+  return run(body, &handler, error);
+}
+
+bool extract_message_batch_result(std::string_view line,
+                                  MessageBatchResult* result,
+                                  std::string* error) {
+  MessageBatchResultHandler handler(result);
+  return run(line, &handler, error);
+}
+
+bool extract_api_error(std::string_view body, ApiError* api_error,
+                       std::string* error) {
+  PathHandler handler(api_error);
+  return run(body, &handler, error);
+}
+
+}  // namespace vsql_ai
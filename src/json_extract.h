@@ -0,0 +1,108 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_JSON_EXTRACT_H
+#define VSQL_AI_JSON_EXTRACT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "metrics.h"
+
+namespace vsql_ai {
+
+// Field extraction from provider responses without building a json DOM:
+// only the fields asked for are kept. Each function returns false and sets
+// *error if the input is not valid JSON.
+
+// The {"error": {...}} object either provider may return
+struct ApiError {
+  bool present = false;
+  std::string message;  // error.message, else error.status or error.type
+};
+
+// Embedding responses of :embedContent ({"embedding":{"values":[...]}}) and
+// :batchEmbedContents ({"embeddings":[{"values":[...]}, ...]}). Numbers are
+// parsed straight into one float vector per embedding, in response order.
+bool extract_embeddings(std::string_view body,
+                        std::vector<std::vector<float>>* embeddings,
+                        ApiError* api_error, std::string* error);
+
+// One event of an Anthropic Messages stream
+struct AnthropicStreamEvent {
+  std::string type;
+  std::string delta_type;
+  std::string delta_text;
+  ApiError error;
+};
+
+// Token counts in the event (message.usage of message_start, usage of
+// message_delta) overwrite those in *usage; both are running totals.
+// cache_read_input_tokens is taken as cached_input_tokens.
+bool extract_anthropic_event(std::string_view data,
+                             AnthropicStreamEvent* event, TokenUsage* usage,
+                             std::string* error);
+
+// One chunk of a Gemini streamGenerateContent response: the text of
+// candidates[0].content.parts[*] is appended to *text, and the running
+// totals of usageMetadata overwrite those in *usage (cachedContentTokenCount
+// as cached_input_tokens)
+bool extract_google_chunk(std::string_view data, std::string* text,
+                          TokenUsage* usage, ApiError* api_error,
+                          std::string* error);
+
+// The name ("cachedContents/...") of a Gemini cached content resource, as
+// returned when it is created
+bool extract_cached_content(std::string_view body, std::string* name,
+                            ApiError* api_error, std::string* error);
+
+// A Message Batches API batch, as returned when it is created or polled
+struct MessageBatch {
+  std::string id;
+  std::string processing_status;  // "in_progress", "canceling" or "ended"
+
+  // request_counts
+  uint64_t processing = 0;
+  uint64_t succeeded = 0;
+  uint64_t errored = 0;
+  uint64_t canceled = 0;
+  uint64_t expired = 0;
+};
+
+bool extract_message_batch(std::string_view body, MessageBatch* batch,
+                           ApiError* api_error, std::string* error);
+
+// One line of a batch's JSONL results
+struct MessageBatchResult {
+  std::string custom_id;
+  std::string type;     // "succeeded", "errored", "canceled" or "expired"
+  std::string text;     // of the message's text blocks, if succeeded
+  std::string message;  // of the error, if errored
+  TokenUsage usage;
+};
+
+bool extract_message_batch_result(std::string_view line,
+                                  MessageBatchResult* result,
+                                  std::string* error);
+
+// Only the error object of a response body
+bool extract_api_error(std::string_view body, ApiError* api_error,
+                       std::string* error);
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_JSON_EXTRACT_H
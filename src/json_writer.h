@@ -0,0 +1,63 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_JSON_WRITER_H
+#define VSQL_AI_JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+
+namespace vsql_ai {
+
+// Append s to *out as a quoted JSON string. Each byte of invalid UTF-8 is
+// replaced with U+FFFD rather than failing the request.
+void append_json_string(std::string* out, std::string_view s);
+
+// Writes JSON straight into a caller-owned buffer, for building request
+// bodies without a json DOM. Commas are placed automatically; nesting is up
+// to the caller.
+//
+//   JsonWriter writer(&body);
+//   writer.begin_object().key("model").string(model).end_object();
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string* out) : out_(out) {}
+
+  JsonWriter& begin_object();
+  JsonWriter& end_object();
+  JsonWriter& begin_array();
+  JsonWriter& end_array();
+
+  JsonWriter& key(std::string_view name);
+
+  JsonWriter& string(std::string_view value);
+  JsonWriter& integer(long value);
+  JsonWriter& number(double value);
+  JsonWriter& boolean(bool value);
+
+ private:
+  // Write the comma before a value unless it is the first in its container
+  // or follows a key
+  void separate();
+
+  std::string* out_;
+  bool first_ = true;
+  bool after_key_ = false;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_JSON_WRITER_H
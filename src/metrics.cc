@@ -0,0 +1,213 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace vsql_ai {
+
+namespace {
+
+constexpr char kOtherModel[] = "(other)";
+
+double us_to_ms(uint64_t us) { return static_cast<double>(us) / 1000.0; }
+
+}  // namespace
+
+// =============================================================================
+// LatencyHistogram
+// =============================================================================
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - kSubBucketBits;
+  uint64_t sub_bucket = (value >> shift) - kSubBuckets;
+  return static_cast<size_t>((shift + 1) * kSubBuckets + sub_bucket);
+}
+
+uint64_t LatencyHistogram::bucket_value(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  uint64_t lower = (kSubBuckets + index % kSubBuckets) << shift;
+  return lower + ((uint64_t{1} << shift) >> 1);
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration latency) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                .count();
+  uint64_t value = std::min<uint64_t>(std::max<int64_t>(0, us),
+                                      (uint64_t{1} << kMaxValueBits) - 1);
+
+  counts_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_us_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_us_.compare_exchange_weak(max, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const {
+  std::array<uint64_t, kBucketCount> counts;
+  uint64_t total = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  Summary summary;
+  summary.count = total;
+  if (total == 0) {
+    return summary;
+  }
+  uint64_t max = max_us_.load(std::memory_order_relaxed);
+  summary.mean_ms =
+      us_to_ms(sum_us_.load(std::memory_order_relaxed)) / total;
+  summary.max_ms = us_to_ms(max);
+
+  // Walk the buckets once, filling each percentile as its rank is reached
+  const double quantiles[] = {0.50, 0.90, 0.99};
+  double* outputs[] = {&summary.p50_ms, &summary.p90_ms, &summary.p99_ms};
+  size_t next = 0;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount && next < 3; i++) {
+    seen += counts[i];
+    while (next < 3 && seen > 0 &&
+           static_cast<double>(seen) >= quantiles[next] * total) {
+      *outputs[next++] = us_to_ms(std::min(bucket_value(i), max));
+    }
+  }
+  return summary;
+}
+
+void LatencyHistogram::reset() {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  sum_us_.store(0, std::memory_order_relaxed);
+  max_us_.store(0, std::memory_order_relaxed);
+}
+
+// =============================================================================
+// ModelMetrics
+// =============================================================================
+
+void ModelMetrics::record_call(std::chrono::steady_clock::duration latency,
+                               bool failed) {
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  if (failed) {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+  call_.record(latency);
+}
+
+void ModelMetrics::record_cache_hit() {
+  cache_hits_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModelMetrics::record_deduplicated() {
+  deduplicated_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModelMetrics::record_usage(const TokenUsage& usage) {
+  input_tokens_.fetch_add(usage.input_tokens, std::memory_order_relaxed);
+  output_tokens_.fetch_add(usage.output_tokens, std::memory_order_relaxed);
+  cached_input_tokens_.fetch_add(usage.cached_input_tokens,
+                                 std::memory_order_relaxed);
+}
+
+ModelMetrics::Snapshot ModelMetrics::snapshot() const {
+  Snapshot snapshot;
+  snapshot.calls = calls_.load(std::memory_order_relaxed);
+  snapshot.errors = errors_.load(std::memory_order_relaxed);
+  snapshot.cache_hits = cache_hits_.load(std::memory_order_relaxed);
+  snapshot.deduplicated = deduplicated_.load(std::memory_order_relaxed);
+  snapshot.input_tokens = input_tokens_.load(std::memory_order_relaxed);
+  snapshot.output_tokens = output_tokens_.load(std::memory_order_relaxed);
+  snapshot.cached_input_tokens =
+      cached_input_tokens_.load(std::memory_order_relaxed);
+  snapshot.call = call_.summary();
+  snapshot.request = request_.summary();
+  snapshot.first_byte = first_byte_.summary();
+  snapshot.parse = parse_.summary();
+  return snapshot;
+}
+
+void ModelMetrics::reset() {
+  calls_.store(0, std::memory_order_relaxed);
+  errors_.store(0, std::memory_order_relaxed);
+  cache_hits_.store(0, std::memory_order_relaxed);
+  deduplicated_.store(0, std::memory_order_relaxed);
+  input_tokens_.store(0, std::memory_order_relaxed);
+  output_tokens_.store(0, std::memory_order_relaxed);
+  cached_input_tokens_.store(0, std::memory_order_relaxed);
+  call_.reset();
+  request_.reset();
+  first_byte_.reset();
+  parse_.reset();
+}
+
+// =============================================================================
+// ModelMetricsTable
+// =============================================================================
+
+ModelMetrics& ModelMetricsTable::get(std::string_view model) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto found = models_.find(model);
+    if (found != models_.end()) {
+      return *found->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (models_.size() >= kMaxModels) {
+    model = kOtherModel;
+  }
+  auto found = models_.find(model);
+  if (found == models_.end()) {
+    found = models_
+                .emplace(std::string(model), std::make_unique<ModelMetrics>())
+                .first;
+  }
+  return *found->second;
+}
+
+void ModelMetricsTable::for_each(
+    const std::function<void(const std::string& model,
+                             const ModelMetrics& metrics)>& visit) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  for (const auto& entry : models_) {
+    visit(entry.first, *entry.second);
+  }
+}
+
+void ModelMetricsTable::reset() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  for (auto& entry : models_) {
+    entry.second->reset();
+  }
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,156 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_METRICS_H
+#define VSQL_AI_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace vsql_ai {
+
+// Latency histogram in the style of HdrHistogram: microsecond values are
+// bucketed by power of two, with 8 linear sub-buckets each, so percentiles
+// come out within about 6% over a range of 1us to half an hour. Recording is a
+// few relaxed atomic adds; samples are at most one per HTTP request, far too
+// sparse for the shared counters to contend.
+class LatencyHistogram {
+ public:
+  struct Summary {
+    uint64_t count = 0;
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+  };
+
+  void record(std::chrono::steady_clock::duration latency);
+
+  // Counts are read one by one, so a summary taken while samples are
+  // recorded may be off by those samples
+  Summary summary() const;
+
+  void reset();
+
+ private:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxValueBits = 31;  // ~36 minutes in microseconds
+  static constexpr size_t kBucketCount =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t bucket_index(uint64_t value);
+
+  // Representative value of a bucket: the middle of its range
+  static uint64_t bucket_value(size_t index);
+
+  std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<uint64_t> max_us_{0};
+};
+
+// Token counts from a response's usage fields
+struct TokenUsage {
+  uint64_t input_tokens = 0;
+  uint64_t output_tokens = 0;
+  // Input read from the provider's prompt cache. Anthropic counts these
+  // apart from input_tokens, Google within them.
+  uint64_t cached_input_tokens = 0;
+};
+
+// Counters and latency histograms for one provider model. Phases:
+//   call        a whole ai_prompt or embedding call, retries included
+//   request     one HTTP exchange, from sending to the end of the body
+//   first_byte  from sending to the response headers; a fresh connection
+//               adds its TCP and TLS setup here
+//   parse       extracting text or vectors from the response body
+class ModelMetrics {
+ public:
+  struct Snapshot {
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    uint64_t cache_hits = 0;
+    uint64_t deduplicated = 0;  // answered by an identical call in flight
+    uint64_t input_tokens = 0;
+    uint64_t output_tokens = 0;
+    uint64_t cached_input_tokens = 0;
+    LatencyHistogram::Summary call;
+    LatencyHistogram::Summary request;
+    LatencyHistogram::Summary first_byte;
+    LatencyHistogram::Summary parse;
+  };
+
+  void record_call(std::chrono::steady_clock::duration latency, bool failed);
+  void record_cache_hit();
+  void record_deduplicated();
+  void record_usage(const TokenUsage& usage);
+
+  LatencyHistogram& request() { return request_; }
+  LatencyHistogram& first_byte() { return first_byte_; }
+  LatencyHistogram& parse() { return parse_; }
+
+  Snapshot snapshot() const;
+  void reset();
+
+ private:
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> errors_{0};
+  std::atomic<uint64_t> cache_hits_{0};
+  std::atomic<uint64_t> deduplicated_{0};
+  std::atomic<uint64_t> input_tokens_{0};
+  std::atomic<uint64_t> output_tokens_{0};
+  std::atomic<uint64_t> cached_input_tokens_{0};
+  LatencyHistogram call_;
+  LatencyHistogram request_;
+  LatencyHistogram first_byte_;
+  LatencyHistogram parse_;
+};
+
+// The ModelMetrics of one provider, by model name. Model names come from
+// SQL arguments, so past kMaxModels distinct names further models share
+// one "(other)" entry. Entries are never removed; callers may keep the
+// returned reference.
+class ModelMetricsTable {
+ public:
+  static constexpr size_t kMaxModels = 32;
+
+  ModelMetrics& get(std::string_view model);
+
+  void for_each(
+      const std::function<void(const std::string& model,
+                               const ModelMetrics& metrics)>& visit) const;
+
+  void reset();
+
+ private:
+  mutable std::shared_mutex mutex_;
+  std::map<std::string, std::unique_ptr<ModelMetrics>, std::less<>> models_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_METRICS_H
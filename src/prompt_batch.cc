@@ -0,0 +1,293 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "prompt_batch.h"
+
+#include <algorithm>
+
+#include "config.h"
+#include "connection_pool.h"
+#include "dns_cache.h"
+#include "http_engine.h"
+#include "rate_limiter.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Batches usually take minutes to hours, so polling once a minute costs
+// next to nothing in rate limit and adds little delay
+constexpr long kDefaultPollInterval = 60;
+
+// Results stay in memory for a day after they are downloaded. The API keeps
+// them for 29 days, so an evicted batch can still be asked about again.
+constexpr long kDefaultRetention = 24 * 60 * 60;
+
+// Metrics entry for batches first seen through their id, whose model is
+// not known
+constexpr char kUnknownModel[] = "(unknown)";
+
+std::string batch_key(const AIProvider* provider, std::string_view batch_id) {
+  std::string key = provider_name(provider->id());
+  key.append("/").append(batch_id);
+  return key;
+}
+
+}  // namespace
+
+PromptBatches& PromptBatches::instance() {
+  static PromptBatches batches;
+  return batches;
+}
+
+PromptBatches::PromptBatches()
+    : poll_interval_(std::max(
+          1L, config_int("BATCH_POLL_INTERVAL", kDefaultPollInterval))),
+      retention_(
+          std::max(1L, config_int("BATCH_RETENTION", kDefaultRetention))) {
+  // Constructed before this, so that they outlive the poller when the
+  // extension is unloaded
+  ProviderRegistry::instance();
+  RateLimiter::instance();
+  DnsCache::instance();
+  ConnectionPool::instance();
+  HttpEngine::instance();
+}
+
+PromptBatches::~PromptBatches() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (poller_.joinable()) {
+    poller_.join();
+  }
+}
+
+bool PromptBatches::submit(AIProvider* provider, std::string_view model,
+                           std::string_view api_key,
+                           const std::vector<std::string>& custom_ids,
+                           const std::vector<std::string>& prompts,
+                           const PromptOptions& options, std::string* batch_id,
+                           std::string* error) {
+  MessageBatch created;
+  if (!provider->create_batch(model, api_key, custom_ids, prompts, options,
+                              &created, error)) {
+    return false;
+  }
+
+  auto batch = std::make_shared<Batch>();
+  batch->provider = provider;
+  batch->id = created.id;
+  batch->model = std::string(model);
+  batch->api_key = std::string(api_key);
+  batch->status.batch = std::move(created);
+  auto now = Clock::now();
+  batch->next_poll = now + poll_interval_;
+  batch->expires = now + retention_;
+  *batch_id = batch->id;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  track(std::move(batch));
+  return true;
+}
+
+bool PromptBatches::status(AIProvider* provider, std::string_view api_key,
+                           std::string_view batch_id, Status* status,
+                           std::string* error) {
+  auto batch = find(provider, api_key, batch_id, error);
+  if (!batch) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  *status = batch->status;
+  return true;
+}
+
+bool PromptBatches::result(AIProvider* provider, std::string_view api_key,
+                           std::string_view batch_id,
+                           std::string_view custom_id, std::string* text,
+                           bool* found, std::string* error) {
+  auto batch = find(provider, api_key, batch_id, error);
+  if (!batch) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Status& status = batch->status;
+  if (!status.results_ready) {
+    if (status.batch.processing_status != "ended") {
+      *error = "Batch " + batch->id + " has not ended yet (" +
+               status.batch.processing_status + ")";
+    } else {
+      *error = "Results of batch " + batch->id + " are still downloading";
+      if (!status.poll_error.empty()) {
+        *error += ": " + status.poll_error;
+      }
+    }
+    return false;
+  }
+
+  auto answer = batch->texts.find(std::string(custom_id));
+  *found = answer != batch->texts.end();
+  if (*found) {
+    *text = answer->second;
+  }
+  return true;
+}
+
+std::shared_ptr<PromptBatches::Batch> PromptBatches::find(
+    AIProvider* provider, std::string_view api_key, std::string_view batch_id,
+    std::string* error) {
+  std::string key = batch_key(provider, batch_id);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = batches_.find(key);
+    if (found != batches_.end()) {
+      // Batches belong to an API key; the id alone does not reveal results
+      if (found->second->api_key != api_key) {
+        *error = "Unknown batch " + std::string(batch_id);
+        return nullptr;
+      }
+      return found->second;
+    }
+  }
+
+  // Not tracked here: ask the provider, which also checks the key
+  MessageBatch state;
+  if (!provider->get_batch(kUnknownModel, api_key, batch_id, &state, error)) {
+    return nullptr;
+  }
+
+  auto batch = std::make_shared<Batch>();
+  batch->provider = provider;
+  batch->id = std::string(batch_id);
+  batch->model = kUnknownModel;
+  batch->api_key = std::string(api_key);
+  batch->status.batch = std::move(state);
+  // Poll again at once, which downloads the results if it has ended
+  auto now = Clock::now();
+  batch->next_poll = now;
+  batch->expires = now + retention_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return track(std::move(batch));
+}
+
+std::shared_ptr<PromptBatches::Batch> PromptBatches::track(
+    std::shared_ptr<Batch> batch) {
+  auto inserted =
+      batches_.emplace(batch_key(batch->provider, batch->id), batch);
+  if (!poller_.joinable()) {
+    poller_ = std::thread(&PromptBatches::poll_loop, this);
+  }
+  wake_.notify_one();
+  return inserted.first->second;
+}
+
+void PromptBatches::poll_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    auto now = Clock::now();
+    auto next = now + poll_interval_;
+    std::vector<std::shared_ptr<Batch>> due;
+    for (auto it = batches_.begin(); it != batches_.end();) {
+      Batch& batch = *it->second;
+      if (now >= batch.expires) {
+        it = batches_.erase(it);
+        continue;
+      }
+      next = std::min(next, batch.expires);
+      if (!batch.status.results_ready) {
+        if (now >= batch.next_poll) {
+          due.push_back(it->second);
+        } else {
+          next = std::min(next, batch.next_poll);
+        }
+      }
+      ++it;
+    }
+
+    if (due.empty()) {
+      wake_.wait_until(lock, next);
+      continue;
+    }
+
+    // Polls go out without the lock, so lookups are answered meanwhile
+    for (auto& batch : due) {
+      if (stopping_) {
+        break;
+      }
+      lock.unlock();
+      poll(batch.get());
+      lock.lock();
+    }
+  }
+}
+
+void PromptBatches::poll(Batch* batch) {
+  MessageBatch state;
+  std::string error;
+  bool polled = batch->provider->get_batch(batch->model, batch->api_key,
+                                           batch->id, &state, &error);
+
+  std::unordered_map<std::string, std::string> texts;
+  std::vector<std::pair<std::string, std::string>> failures;
+  bool downloaded = false;
+  if (polled && state.processing_status == "ended") {
+    downloaded = batch->provider->get_batch_results(
+        batch->model, batch->api_key, batch->id,
+        [&](MessageBatchResult& result) {
+          if (result.type == "succeeded") {
+            texts[result.custom_id] = std::move(result.text);
+            return;
+          }
+          // A retried download repeats results
+          bool seen = std::any_of(
+              failures.begin(), failures.end(),
+              [&](const auto& failure) {
+                return failure.first == result.custom_id;
+              });
+          if (!seen && failures.size() < kMaxReportedFailures) {
+            failures.emplace_back(
+                std::move(result.custom_id),
+                result.message.empty() ? std::move(result.type)
+                                       : std::move(result.message));
+          }
+        },
+        &error);
+  }
+
+  auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  Status& status = batch->status;
+  if (polled) {
+    status.batch = std::move(state);
+    batch->expires = now + retention_;
+  }
+  status.poll_error = std::move(error);
+  if (downloaded) {
+    batch->texts.swap(texts);
+    status.failures = std::move(failures);
+    status.results_ready = true;
+  } else {
+    batch->next_poll = now + poll_interval_;
+  }
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,129 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_PROMPT_BATCH_H
+#define VSQL_AI_PROMPT_BATCH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ai_providers.h"
+
+namespace vsql_ai {
+
+// Message batches submitted through ai_prompt_batch_submit(). A background
+// thread polls each batch every VSQL_AI_BATCH_POLL_INTERVAL seconds and,
+// once it has ended, downloads its results and keeps them in memory for
+// VSQL_AI_BATCH_RETENTION seconds, so no SQL connection ever waits on a
+// batch. A batch this server does not know, e.g. one submitted before a
+// restart, is tracked from the first time it is asked about.
+class PromptBatches {
+ public:
+  struct Status {
+    MessageBatch batch;
+    bool results_ready = false;
+    std::string poll_error;  // of the last poll or download, if it failed
+
+    // Custom ids of prompts that did not succeed, with the error message or
+    // the result type ("canceled", "expired"); at most kMaxReportedFailures
+    std::vector<std::pair<std::string, std::string>> failures;
+  };
+
+  static constexpr size_t kMaxReportedFailures = 16;
+
+  static PromptBatches& instance();
+
+  // Submit prompts as one batch and start tracking it. Returns false and
+  // sets *error if the provider rejects it.
+  bool submit(AIProvider* provider, std::string_view model,
+              std::string_view api_key,
+              const std::vector<std::string>& custom_ids,
+              const std::vector<std::string>& prompts,
+              const PromptOptions& options, std::string* batch_id,
+              std::string* error);
+
+  // Latest state of a batch, as of its last poll
+  bool status(AIProvider* provider, std::string_view api_key,
+              std::string_view batch_id, Status* status, std::string* error);
+
+  // Answer to one prompt of a batch. Returns false and sets *error until
+  // the results have been downloaded. *found is false if the prompt did not
+  // succeed or the batch has no such custom id.
+  bool result(AIProvider* provider, std::string_view api_key,
+              std::string_view batch_id, std::string_view custom_id,
+              std::string* text, bool* found, std::string* error);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Batch {
+    AIProvider* provider = nullptr;
+    std::string id;
+    std::string model;
+    std::string api_key;
+
+    // Guarded by mutex_
+    Status status;
+    std::unordered_map<std::string, std::string> texts;  // by custom id
+    Clock::time_point next_poll;
+    Clock::time_point expires;  // dropped then; extended by each poll
+  };
+
+  PromptBatches();
+  ~PromptBatches();
+
+  // The tracked batch, after checking the API key, or one looked up from
+  // the provider and tracked from now on. Returns null and sets *error if
+  // there is no such batch.
+  std::shared_ptr<Batch> find(AIProvider* provider, std::string_view api_key,
+                              std::string_view batch_id, std::string* error);
+
+  // Add a batch and make sure the poller runs. Returns the batch tracked
+  // under its id, which is an earlier one if two sessions race to track
+  // it. Caller holds mutex_.
+  std::shared_ptr<Batch> track(std::shared_ptr<Batch> batch);
+
+  void poll_loop();
+
+  // Poll one batch, downloading its results if it has ended. Called
+  // without mutex_.
+  void poll(Batch* batch);
+
+  std::chrono::seconds poll_interval_;
+  std::chrono::seconds retention_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  // By provider name and batch id, e.g. "anthropic/msgbatch_..."
+  std::map<std::string, std::shared_ptr<Batch>> batches_;
+  std::thread poller_;
+  bool stopping_ = false;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_PROMPT_BATCH_H
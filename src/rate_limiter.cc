@@ -0,0 +1,144 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "hash_util.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Pause after a 429 that carries no retry-after
+constexpr std::chrono::milliseconds kDefaultRetryAfter{1000};
+
+// 429s from requests that were already in flight report the same overload;
+// halve the limit at most once per interval
+constexpr std::chrono::milliseconds kDecreaseInterval{1000};
+
+}  // namespace
+
+RateLimiter& RateLimiter::instance() {
+  static RateLimiter limiter;
+  return limiter;
+}
+
+uint64_t RateLimiter::make_key(std::string_view provider,
+                               std::string_view api_key) {
+  std::hash<std::string_view> hasher;
+  return hash_combine(hasher(provider), hasher(api_key));
+}
+
+void RateLimiter::refill(Bucket* bucket, Clock::time_point now) {
+  // refilled may lie in the future while the bucket is paused
+  if (bucket->rate_per_second <= 0 || now <= bucket->refilled) {
+    return;
+  }
+  // Allow bursts of up to one second's worth of requests
+  double burst = std::max(1.0, bucket->rate_per_second);
+  double elapsed =
+      std::chrono::duration<double>(now - bucket->refilled).count();
+  bucket->tokens =
+      std::min(burst, bucket->tokens + elapsed * bucket->rate_per_second);
+  bucket->refilled = now;
+}
+
+bool RateLimiter::acquire(uint64_t key, const Limits& limits,
+                          Clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto& slot = buckets_[key];
+  if (!slot) {
+    // Start optimistic; the first 429 brings the limit down
+    slot = std::make_unique<Bucket>();
+    slot->max_in_flight = std::max<size_t>(1, limits.max_in_flight);
+    slot->concurrency_limit = static_cast<double>(slot->max_in_flight);
+    slot->rate_per_second = limits.requests_per_minute / 60.0;
+    slot->configured_rate = limits.requests_per_minute > 0;
+    slot->tokens = std::max(1.0, slot->rate_per_second);
+    slot->refilled = Clock::now();
+  }
+  Bucket& bucket = *slot;
+
+  while (true) {
+    auto now = Clock::now();
+    refill(&bucket, now);
+
+    auto wake = deadline;
+    auto limit =
+        std::max<size_t>(1, static_cast<size_t>(bucket.concurrency_limit));
+    if (now < bucket.blocked_until) {
+      wake = std::min(wake, bucket.blocked_until);
+    } else if (bucket.in_flight >= limit) {
+      // Woken by release()
+    } else if (bucket.rate_per_second > 0 && bucket.tokens < 1) {
+      auto refill_time = std::chrono::duration<double>(
+          (1 - bucket.tokens) / bucket.rate_per_second);
+      wake = std::min(
+          wake, now + std::chrono::duration_cast<Clock::duration>(refill_time));
+    } else {
+      if (bucket.rate_per_second > 0) {
+        bucket.tokens -= 1;
+      }
+      bucket.in_flight++;
+      return true;
+    }
+
+    if (now >= deadline) {
+      return false;
+    }
+    bucket.changed.wait_until(lock, wake);
+  }
+}
+
+void RateLimiter::release(uint64_t key, const Feedback& feedback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Bucket& bucket = *buckets_[key];
+  auto now = Clock::now();
+
+  bucket.in_flight--;
+
+  if (feedback.requests_per_minute > 0 && !bucket.configured_rate) {
+    refill(&bucket, now);
+    bucket.rate_per_second = feedback.requests_per_minute / 60.0;
+  }
+
+  if (feedback.throttled) {
+    // Multiplicative decrease, and hold every session off until the server
+    // is ready for us again
+    auto retry_after = feedback.retry_after.count() > 0 ? feedback.retry_after
+                                                        : kDefaultRetryAfter;
+    bucket.blocked_until = std::max(bucket.blocked_until, now + retry_after);
+    bucket.tokens = 0;
+    bucket.refilled = bucket.blocked_until;
+    if (now - bucket.last_decrease >= kDecreaseInterval) {
+      bucket.concurrency_limit = std::max(1.0, bucket.concurrency_limit / 2);
+      bucket.last_decrease = now;
+    }
+  } else {
+    // Additive increase: about +1 per limit's worth of successes
+    bucket.concurrency_limit =
+        std::min(static_cast<double>(bucket.max_in_flight),
+                 bucket.concurrency_limit + 1 / bucket.concurrency_limit);
+  }
+
+  bucket.changed.notify_all();
+}
+
+}  // namespace vsql_ai
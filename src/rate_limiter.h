@@ -0,0 +1,93 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_RATE_LIMITER_H
+#define VSQL_AI_RATE_LIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace vsql_ai {
+
+// Client-side admission control shared by all sessions, with one bucket per
+// (provider, API key) since that is what provider quotas are charged to.
+//
+// Each bucket combines a token bucket, for the request rate the provider
+// advertises (or that is configured), with an AIMD concurrency limit: every
+// success raises the limit by about one per window of requests, and a 429
+// halves it and pauses the bucket for the server's retry-after. Throughput
+// thus settles just under the quota instead of bouncing off it.
+class RateLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Limits {
+    size_t max_in_flight;        // ceiling for the adaptive concurrency limit
+    double requests_per_minute;  // 0 = learn from response headers
+  };
+
+  // What a finished request told us about the quota
+  struct Feedback {
+    bool throttled = false;  // HTTP 429
+    std::chrono::milliseconds retry_after{0};  // 0 = not given
+    double requests_per_minute = 0;            // advertised limit, 0 = unknown
+  };
+
+  static RateLimiter& instance();
+
+  // The API key only contributes to a hash; it is never stored
+  static uint64_t make_key(std::string_view provider, std::string_view api_key);
+
+  // Wait for a token and a concurrency slot. Returns false if the deadline
+  // passes first. A successful acquire must be paired with release().
+  bool acquire(uint64_t key, const Limits& limits, Clock::time_point deadline);
+
+  void release(uint64_t key, const Feedback& feedback);
+
+ private:
+  struct Bucket {
+    std::condition_variable changed;
+    size_t max_in_flight = 1;
+    size_t in_flight = 0;
+    double concurrency_limit = 1;
+
+    double rate_per_second = 0;  // 0 = unlimited
+    bool configured_rate = false;
+    double tokens = 0;
+    Clock::time_point refilled;
+
+    Clock::time_point blocked_until;
+    Clock::time_point last_decrease;
+  };
+
+  RateLimiter() = default;
+
+  static void refill(Bucket* bucket, Clock::time_point now);
+
+  std::mutex mutex_;
+  // Buckets are never removed; there is one per provider and API key in use
+  std::unordered_map<uint64_t, std::unique_ptr<Bucket>> buckets_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_RATE_LIMITER_H
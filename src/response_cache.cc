@@ -0,0 +1,135 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "response_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "config.h"
+#include "hash_util.h"
+
+namespace vsql_ai {
+
+namespace {
+
+constexpr long kDefaultMaxBytes = 64L * 1024 * 1024;
+constexpr long kDefaultTtlSeconds = 3600;
+
+}  // namespace
+
+ResponseCache& ResponseCache::instance() {
+  static ResponseCache cache;
+  return cache;
+}
+
+ResponseCache::ResponseCache()
+    : max_bytes_(static_cast<size_t>(
+          std::max(0L, config_int("RESPONSE_CACHE_BYTES", kDefaultMaxBytes)))),
+      ttl_(std::max(1L, config_int("RESPONSE_CACHE_TTL", kDefaultTtlSeconds))) {}
+
+uint64_t ResponseCache::make_key(std::string_view provider,
+                                 std::string_view model,
+                                 std::string_view api_key,
+                                 std::string_view request_body) {
+  std::hash<std::string_view> hasher;
+  uint64_t key = hasher(request_body);
+  key = hash_combine(key, request_body.size());
+  key = hash_combine(key, hasher(provider));
+  key = hash_combine(key, hasher(model));
+  key = hash_combine(key, hasher(api_key));
+  return key;
+}
+
+size_t ResponseCache::entry_size(const Entry& entry) {
+  // List node plus hash table slot, roughly
+  return sizeof(Entry) + entry.response.capacity() + 4 * sizeof(void*);
+}
+
+bool ResponseCache::get(uint64_t key, std::string* response) {
+  if (!enabled()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found == index_.end()) {
+    stats_.misses++;
+    return false;
+  }
+
+  auto it = found->second;
+  if (Clock::now() >= it->expires_at) {
+    erase(it);
+    stats_.misses++;
+    return false;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it);
+  *response = it->response;
+  stats_.hits++;
+  return true;
+}
+
+void ResponseCache::put(uint64_t key, const std::string& response) {
+  if (!enabled()) {
+    return;
+  }
+
+  Entry entry{key, response, Clock::now() + ttl_};
+  size_t size = entry_size(entry);
+  if (size > max_bytes_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    erase(found->second);
+  }
+
+  lru_.push_front(std::move(entry));
+  index_[key] = lru_.begin();
+  bytes_ += size;
+
+  while (bytes_ > max_bytes_) {
+    erase(std::prev(lru_.end()));
+    stats_.evictions++;
+  }
+}
+
+void ResponseCache::erase(std::list<Entry>::iterator it) {
+  bytes_ -= entry_size(*it);
+  index_.erase(it->key);
+  lru_.erase(it);
+}
+
+ResponseCache::Stats ResponseCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.entries = lru_.size();
+  stats.bytes = bytes_;
+  return stats;
+}
+
+void ResponseCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  bytes_ = 0;
+}
+
+}  // namespace vsql_ai
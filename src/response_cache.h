@@ -0,0 +1,90 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_RESPONSE_CACHE_H
+#define VSQL_AI_RESPONSE_CACHE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace vsql_ai {
+
+// Process-wide LRU cache of successful prompt responses, bounded by total
+// bytes and entry age. Keys are 64-bit hashes of everything that determines
+// the response: provider, model, API key and the exact request body.
+class ResponseCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  static ResponseCache& instance();
+
+  // The API key is part of the key so a request with an invalid or revoked
+  // key never gets an answer another key paid for.
+  static uint64_t make_key(std::string_view provider, std::string_view model,
+                           std::string_view api_key,
+                           std::string_view request_body);
+
+  // Returns true and fills *response on a live hit
+  bool get(uint64_t key, std::string* response);
+
+  void put(uint64_t key, const std::string& response);
+
+  bool enabled() const { return max_bytes_ > 0; }
+
+  Stats stats();
+  void clear();
+
+ private:
+  struct Entry {
+    uint64_t key;
+    std::string response;
+    Clock::time_point expires_at;
+  };
+
+  ResponseCache();
+
+  // Bytes an entry is charged against the budget, including bookkeeping
+  static size_t entry_size(const Entry& entry);
+
+  // Drop the entry at `it`. Caller holds mutex_.
+  void erase(std::list<Entry>::iterator it);
+
+  std::mutex mutex_;
+  std::list<Entry> lru_;  // most recently used at the front
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+  size_t bytes_ = 0;
+  size_t max_bytes_;
+  std::chrono::seconds ttl_;
+  Stats stats_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_RESPONSE_CACHE_H
@@ -0,0 +1,80 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "retry_policy.h"
+
+#include <algorithm>
+#include <random>
+
+namespace vsql_ai {
+
+bool RetryPolicy::retryable_status(int status) {
+  switch (status) {
+    case 429:
+    case 500:
+    case 502:
+    case 503:
+    case 529:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::chrono::milliseconds RetryPolicy::backoff(int attempt) const {
+  thread_local std::mt19937_64 random{std::random_device{}()};
+
+  // Cap the shift; max_delay is reached long before it overflows
+  int shift = std::min(std::max(attempt - 1, 0), 20);
+  auto ceiling = std::min<int64_t>(max_delay.count(),
+                                   base_delay.count() * (int64_t{1} << shift));
+  std::uniform_int_distribution<int64_t> jitter(0,
+                                                std::max<int64_t>(0, ceiling));
+  return std::chrono::milliseconds(jitter(random));
+}
+
+void RetryCounters::record(int attempts, bool exhausted,
+                           std::chrono::steady_clock::duration retry_time) {
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  if (attempts > 1) {
+    retries_.fetch_add(attempts - 1, std::memory_order_relaxed);
+    retry_time_ms_.fetch_add(
+        std::chrono::duration_cast<std::chrono::milliseconds>(retry_time)
+            .count(),
+        std::memory_order_relaxed);
+  }
+  if (exhausted) {
+    exhausted_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+RetryStats RetryCounters::stats() const {
+  RetryStats stats;
+  stats.requests = requests_.load(std::memory_order_relaxed);
+  stats.retries = retries_.load(std::memory_order_relaxed);
+  stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+  stats.retry_time_ms = retry_time_ms_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void RetryCounters::reset() {
+  requests_.store(0, std::memory_order_relaxed);
+  retries_.store(0, std::memory_order_relaxed);
+  exhausted_.store(0, std::memory_order_relaxed);
+  retry_time_ms_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,67 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_RETRY_POLICY_H
+#define VSQL_AI_RETRY_POLICY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace vsql_ai {
+
+// When and how long to wait before sending a failed request again
+struct RetryPolicy {
+  int max_attempts;  // including the first; 429s are paced by the rate
+                     // limiter and only bounded by the deadline
+  std::chrono::milliseconds base_delay;
+  std::chrono::milliseconds max_delay;
+  std::chrono::milliseconds deadline;  // across all attempts
+
+  // 429, 500, 502, 503 and 529 (Anthropic's "overloaded")
+  static bool retryable_status(int status);
+
+  // Full jitter: uniform in [0, min(max_delay, base_delay * 2^(attempt-1))],
+  // so clients that failed together do not retry together
+  std::chrono::milliseconds backoff(int attempt) const;
+};
+
+// Cumulative counters for one provider's requests
+struct RetryStats {
+  uint64_t requests = 0;
+  uint64_t retries = 0;
+  uint64_t exhausted = 0;      // gave up with a retryable failure
+  uint64_t retry_time_ms = 0;  // latency added by failed attempts and waits
+};
+
+class RetryCounters {
+ public:
+  void record(int attempts, bool exhausted,
+              std::chrono::steady_clock::duration retry_time);
+
+  RetryStats stats() const;
+  void reset();
+
+ private:
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> retries_{0};
+  std::atomic<uint64_t> exhausted_{0};
+  std::atomic<uint64_t> retry_time_ms_{0};
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_RETRY_POLICY_H
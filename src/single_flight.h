@@ -0,0 +1,204 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_SINGLE_FLIGHT_H
+#define VSQL_AI_SINGLE_FLIGHT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "call_context.h"
+
+namespace vsql_ai {
+
+// Collapses concurrent identical provider calls into one. The first caller
+// for a key becomes the leader and makes the call; callers arriving while it
+// is in flight wait and receive the leader's outcome, error included,
+// instead of sending the same request again. Once the outcome is published
+// the key is free, so later callers start afresh (and usually hit a cache
+// the leader filled).
+//
+// A leader whose own SQL call is cancelled or runs out of time publishes
+// nothing: its waiters may have longer to run, so they join again and one
+// of them leads a new attempt.
+template <typename Value>
+class SingleFlight {
+ public:
+  class Ticket {
+   public:
+    Ticket(Ticket&& other) noexcept
+        : flights_(other.flights_),
+          key_(other.key_),
+          call_(std::move(other.call_)),
+          leader_(other.leader_),
+          error_(other.error_),
+          value_(std::move(other.value_)),
+          waited_error_(std::move(other.waited_error_)) {
+      other.call_.reset();
+    }
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    // A leader that never published gives its waiters *error, the error
+    // pointer passed to join(), unless its call ended early
+    ~Ticket() {
+      if (leader_ && call_) {
+        CallContext* context = CallContext::current();
+        if (context && context->cancelled()) {
+          abandon();
+        } else {
+          publish(Value());
+        }
+      }
+    }
+
+    bool leader() const { return leader_; }
+
+    // Leader: hand the outcome to the waiters. The value is only copied if
+    // someone is waiting.
+    void publish(const Value& value) {
+      if (!call_) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(flights_->mutex_);
+        if (call_->waiters > 0) {
+          call_->value = value;
+          call_->error = *error_;
+        }
+        call_->done = true;
+        flights_->calls_.erase(key_);
+      }
+      call_->published.notify_all();
+      call_.reset();
+    }
+
+    // Waiter: the leader's value, with its error in *error. join() has
+    // already waited for it.
+    Value wait(std::string* error) {
+      *error = std::move(waited_error_);
+      return std::move(value_);
+    }
+
+   private:
+    friend class SingleFlight;
+
+    struct Call {
+      std::condition_variable published;
+      bool done = false;
+      bool abandoned = false;  // done without an outcome; join again
+      size_t waiters = 0;
+      Value value;
+      std::string error;
+    };
+
+    Ticket(SingleFlight* flights, uint64_t key, std::shared_ptr<Call> call,
+           bool leader, const std::string* error)
+        : flights_(flights),
+          key_(key),
+          call_(std::move(call)),
+          leader_(leader),
+          error_(error) {}
+
+    // Leader: free the key without an outcome
+    void abandon() {
+      {
+        std::lock_guard<std::mutex> lock(flights_->mutex_);
+        call_->done = true;
+        call_->abandoned = true;
+        flights_->calls_.erase(key_);
+      }
+      call_->published.notify_all();
+      call_.reset();
+    }
+
+    SingleFlight* flights_;
+    uint64_t key_;
+    std::shared_ptr<Call> call_;  // the leader's; null once it has published
+    bool leader_;
+    const std::string* error_;
+
+    // Waiter: the outcome received
+    Value value_;
+    std::string waited_error_;
+  };
+
+  // With enabled false every caller leads and nothing is shared
+  explicit SingleFlight(bool enabled) : enabled_(enabled) {}
+
+  // Join the call for key. *error is where a leader's caller will have put
+  // the call's error by the time it publishes or drops the ticket.
+  //
+  // While another caller leads, this waits for its outcome, or until the
+  // deadline of the caller's own SQL call. If that leader gives up, the
+  // caller joins again and may lead.
+  Ticket join(uint64_t key, const std::string* error) {
+    if (!enabled_) {
+      return Ticket(this, key, nullptr, true, error);
+    }
+    CallContext* context = CallContext::current();
+    auto deadline =
+        context ? context->deadline() : CallContext::Clock::time_point::max();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      auto found = calls_.find(key);
+      if (found == calls_.end()) {
+        auto call = std::make_shared<typename Ticket::Call>();
+        calls_.emplace(key, call);
+        return Ticket(this, key, std::move(call), true, error);
+      }
+
+      std::shared_ptr<typename Ticket::Call> call = found->second;
+      call->waiters++;
+      auto done = [&] { return call->done; };
+      bool published = true;
+      if (deadline != CallContext::Clock::time_point::max()) {
+        published = call->published.wait_until(lock, deadline, done);
+      } else {
+        call->published.wait(lock, done);
+      }
+      call->waiters--;
+
+      if (published && call->abandoned) {
+        continue;
+      }
+      Ticket ticket(this, key, nullptr, false, error);
+      if (published) {
+        ticket.value_ = call->value;
+        ticket.waited_error_ = call->error;
+      } else {
+        ticket.waited_error_ = context->cancel_reason();
+      }
+      return ticket;
+    }
+  }
+
+ private:
+  bool enabled_;
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, std::shared_ptr<typename Ticket::Call>> calls_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_SINGLE_FLIGHT_H
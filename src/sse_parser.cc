@@ -0,0 +1,103 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sse_parser.h"
+
+#include <cstring>
+#include <utility>
+
+namespace vsql_ai {
+
+SseParser::SseParser(EventHandler handler) : handler_(std::move(handler)) {}
+
+bool SseParser::feed(const char* data, size_t length) {
+  const char* end = data + length;
+  while (!stopped_ && data < end) {
+    auto* newline =
+        static_cast<const char*>(memchr(data, '\n', end - data));
+    if (!newline) {
+      line_.append(data, end);
+      break;
+    }
+
+    // Most lines arrive whole; only copy the ones split across reads
+    std::string_view line;
+    if (line_.empty()) {
+      line = std::string_view(data, newline - data);
+    } else {
+      line_.append(data, newline);
+      line = line_;
+    }
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+
+    if (!process_line(line)) {
+      stopped_ = true;
+    }
+    line_.clear();
+    data = newline + 1;
+  }
+  return !stopped_;
+}
+
+bool SseParser::process_line(std::string_view line) {
+  // A blank line ends the event
+  if (line.empty()) {
+    return dispatch();
+  }
+
+  // Comment, used by servers as a keep-alive
+  if (line.front() == ':') {
+    return true;
+  }
+
+  std::string_view field = line;
+  std::string_view value;
+  size_t colon = line.find(':');
+  if (colon != std::string_view::npos) {
+    field = line.substr(0, colon);
+    value = line.substr(colon + 1);
+    if (!value.empty() && value.front() == ' ') {
+      value.remove_prefix(1);
+    }
+  }
+
+  if (field == "data") {
+    if (has_data_) {
+      data_.push_back('\n');
+    }
+    data_.append(value);
+    has_data_ = true;
+  } else if (field == "event") {
+    event_.assign(value);
+  }
+  // id: and retry: only matter for reconnecting, which we never do
+  return true;
+}
+
+bool SseParser::dispatch() {
+  bool keep_going = true;
+  if (has_data_) {
+    keep_going = handler_(event_.empty() ? "message" : event_, data_);
+  }
+  event_.clear();
+  data_.clear();
+  has_data_ = false;
+  return keep_going;
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,57 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_SSE_PARSER_H
+#define VSQL_AI_SSE_PARSER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace vsql_ai {
+
+// Incremental parser for text/event-stream (server-sent events) bodies, as
+// returned by the providers' streaming endpoints. Bytes are fed as they
+// arrive off the socket; only the current, incomplete event is buffered.
+class SseParser {
+ public:
+  // Called once per complete event with its type ("message" if the event has
+  // no event: field) and its data lines joined with '\n'. Return false to
+  // stop parsing.
+  using EventHandler =
+      std::function<bool(std::string_view event, std::string_view data)>;
+
+  explicit SseParser(EventHandler handler);
+
+  // Returns false once the handler has asked to stop
+  bool feed(const char* data, size_t length);
+
+ private:
+  bool process_line(std::string_view line);
+  bool dispatch();
+
+  EventHandler handler_;
+  std::string line_;  // incomplete trailing line
+  std::string event_;
+  std::string data_;
+  bool has_data_ = false;
+  bool stopped_ = false;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_SSE_PARSER_H
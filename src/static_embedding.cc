@@ -0,0 +1,488 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "static_embedding.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "nlohmann/json.hpp"
+#include "utf8_util.h"
+
+using json = nlohmann::json;
+
+namespace vsql_ai {
+
+namespace {
+
+// safetensors caps its JSON header at 100 MB
+constexpr uint64_t kMaxHeaderBytes = 100 * 1024 * 1024;
+
+bool read_file(const std::string& path, std::string* contents) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::ostringstream buffer;
+  buffer << in.rdbuf();
+  *contents = buffer.str();
+  return true;
+}
+
+// IEEE 754 binary16 -> binary32
+float half_to_float(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);  // Inf or NaN
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal half: normalize into a float
+    exponent = 127 - 15 + 1;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void append_utf8(std::string* out, uint32_t c) {
+  if (c < 0x80) {
+    out->push_back(static_cast<char>(c));
+  } else if (c < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | (c >> 6)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  } else if (c < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | (c >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | (c >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  }
+}
+
+// The character classes of BERT's BasicTokenizer. Without the Unicode
+// database these cover ASCII, Latin-1 and the common punctuation blocks;
+// other scripts pass through unchanged.
+
+bool is_whitespace(uint32_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == 0xa0 ||
+         c == 0x1680 || (c >= 0x2000 && c <= 0x200a) || c == 0x2028 ||
+         c == 0x2029 || c == 0x202f || c == 0x205f || c == 0x3000;
+}
+
+bool is_control(uint32_t c) {
+  return c == 0 || c == 0xfffd || c < 0x20 || (c >= 0x7f && c <= 0x9f);
+}
+
+bool is_punctuation(uint32_t c) {
+  // BERT counts every non-alphanumeric ASCII symbol as punctuation
+  if ((c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) ||
+      (c >= 123 && c <= 126)) {
+    return true;
+  }
+  return c == 0xa1 || c == 0xa7 || c == 0xab || c == 0xb6 || c == 0xb7 ||
+         c == 0xbb || c == 0xbf || (c >= 0x2010 && c <= 0x2027) ||
+         (c >= 0x2030 && c <= 0x205e) || (c >= 0x3001 && c <= 0x3003) ||
+         (c >= 0x3008 && c <= 0x3011) || (c >= 0x3014 && c <= 0x301f) ||
+         (c >= 0xff01 && c <= 0xff0f) || (c >= 0xff1a && c <= 0xff20);
+}
+
+// Each CJK ideograph is a word of its own
+bool is_cjk(uint32_t c) {
+  return (c >= 0x4e00 && c <= 0x9fff) || (c >= 0x3400 && c <= 0x4dbf) ||
+         (c >= 0x20000 && c <= 0x2a6df) || (c >= 0x2a700 && c <= 0x2ceaf) ||
+         (c >= 0xf900 && c <= 0xfaff) || (c >= 0x2f800 && c <= 0x2fa1f);
+}
+
+bool is_combining_mark(uint32_t c) { return c >= 0x300 && c <= 0x36f; }
+
+// Base letters of U+00C0..U+00FF once accents are stripped and lowercased;
+// 0 keeps the character, which has no decomposition
+constexpr char kLatin1Base[] =
+    "aaaaaa\0ceeeeiiii\0nooooo\0\0uuuuy\0\0"
+    "aaaaaa\0ceeeeiiii\0nooooo\0\0uuuuy\0y";
+
+uint32_t to_lower(uint32_t c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c + 32;
+  }
+  if ((c >= 0xc0 && c <= 0xde && c != 0xd7) ||  // Latin-1
+      (c >= 0x391 && c <= 0x3ab && c != 0x3a2) ||  // Greek
+      (c >= 0x410 && c <= 0x42f)) {  // Cyrillic
+    return c + 32;
+  }
+  if (c >= 0x400 && c <= 0x40f) {
+    return c + 80;
+  }
+  if (c >= 0x100 && c <= 0x17f && c != 0x130 && c != 0x138 && c != 0x149 &&
+      c != 0x17f) {
+    // Latin Extended-A alternates upper and lower case, with the pairs
+    // starting on odd code points in U+0139..U+0148 and U+0179..U+017E
+    if (c == 0x178) {
+      return 0xff;
+    }
+    bool odd_pairs = (c >= 0x139 && c <= 0x148) || c >= 0x179;
+    bool upper = (c % 2 == 1) == odd_pairs;
+    return upper ? c + 1 : c;
+  }
+  return c;
+}
+
+}  // namespace
+
+std::unique_ptr<StaticEmbeddingModel> StaticEmbeddingModel::load(
+    const std::string& directory, std::string* error) {
+  std::unique_ptr<StaticEmbeddingModel> model(new StaticEmbeddingModel());
+  try {
+    if (!model->load_tokenizer(directory + "/tokenizer.json", error) ||
+        !model->load_weights(directory + "/model.safetensors", error)) {
+      return nullptr;
+    }
+  } catch (const json::exception& e) {
+    // A field of the wrong type
+    *error = std::string("Malformed model files: ") + e.what();
+    return nullptr;
+  }
+
+  // Every token id must have a row
+  if (model->tokens_.size() > model->rows_) {
+    *error = "tokenizer.json has more tokens than the embedding matrix rows";
+    return nullptr;
+  }
+
+  std::string config;
+  if (read_file(directory + "/config.json", &config)) {
+    json parsed = json::parse(config, nullptr, false);
+    if (parsed.is_object() && parsed.contains("normalize") &&
+        parsed["normalize"].is_boolean()) {
+      model->normalize_ = parsed["normalize"].get<bool>();
+    }
+  }
+  return model;
+}
+
+StaticEmbeddingModel::~StaticEmbeddingModel() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
+bool StaticEmbeddingModel::load_weights(const std::string& path,
+                                        std::string* error) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "Cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 8) {
+    close(fd);
+    *error = path + " is not a safetensors file";
+    return false;
+  }
+
+  mapping_size_ = static_cast<size_t>(st.st_size);
+  void* base = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    *error = "Cannot map " + path + ": " + strerror(errno);
+    return false;
+  }
+  mapping_ = base;
+  const char* bytes = static_cast<const char*>(base);
+
+  // Little-endian header length, the JSON header, then the tensor data
+  uint64_t header_length = 0;
+  for (int i = 7; i >= 0; i--) {
+    header_length = (header_length << 8) | static_cast<unsigned char>(bytes[i]);
+  }
+  if (header_length > kMaxHeaderBytes || header_length > mapping_size_ - 8) {
+    *error = path + " is not a safetensors file";
+    return false;
+  }
+
+  json header = json::parse(bytes + 8, bytes + 8 + header_length, nullptr,
+                            false);
+  if (!header.is_object() || !header.contains("embeddings") ||
+      !header["embeddings"].is_object()) {
+    *error = path + " has no \"embeddings\" tensor";
+    return false;
+  }
+
+  const json& tensor = header["embeddings"];
+  const json& dtype = tensor.value("dtype", json());
+  const json& shape = tensor.value("shape", json());
+  const json& offsets = tensor.value("data_offsets", json());
+  size_t element_size;
+  if (dtype == "F32") {
+    dtype_ = DType::kFloat32;
+    element_size = 4;
+  } else if (dtype == "F16") {
+    dtype_ = DType::kFloat16;
+    element_size = 2;
+  } else {
+    *error = "Unsupported embeddings dtype in " + path +
+             "; expected F32 or F16";
+    return false;
+  }
+
+  if (!shape.is_array() || shape.size() != 2 ||
+      !shape[0].is_number_unsigned() || !shape[1].is_number_unsigned() ||
+      !offsets.is_array() ||
+      offsets.size() != 2 || !offsets[0].is_number_unsigned() ||
+      !offsets[1].is_number_unsigned()) {
+    *error = "Malformed embeddings tensor in " + path;
+    return false;
+  }
+
+  rows_ = shape[0].get<size_t>();
+  dimensions_ = shape[1].get<size_t>();
+  uint64_t begin = offsets[0].get<uint64_t>();
+  uint64_t end = offsets[1].get<uint64_t>();
+  uint64_t data_start = 8 + header_length;
+  uint64_t expected = static_cast<uint64_t>(rows_) * dimensions_ * element_size;
+  if (rows_ == 0 || dimensions_ == 0 || dimensions_ > 65536 || begin > end ||
+      end - begin != expected || end > mapping_size_ - data_start) {
+    *error = "Malformed embeddings tensor in " + path;
+    return false;
+  }
+
+  weights_ = bytes + data_start + begin;
+  if (reinterpret_cast<uintptr_t>(weights_) % element_size != 0) {
+    *error = "Misaligned embeddings tensor in " + path;
+    return false;
+  }
+
+  // Lookups hit rows all over the matrix; page it in up front rather than
+  // one fault at a time under the first queries
+  madvise(mapping_, mapping_size_, MADV_WILLNEED);
+  return true;
+}
+
+bool StaticEmbeddingModel::load_tokenizer(const std::string& path,
+                                          std::string* error) {
+  std::string contents;
+  if (!read_file(path, &contents)) {
+    *error = "Cannot read " + path;
+    return false;
+  }
+
+  json tokenizer = json::parse(contents, nullptr, false);
+  if (!tokenizer.is_object() || !tokenizer.contains("model") ||
+      !tokenizer["model"].is_object()) {
+    *error = path + " is not a tokenizer.json file";
+    return false;
+  }
+
+  const json& model = tokenizer["model"];
+  if (model.value("type", "") != "WordPiece" || !model.contains("vocab") ||
+      !model["vocab"].is_object()) {
+    *error = "Unsupported tokenizer in " + path +
+             "; only WordPiece vocabularies are supported";
+    return false;
+  }
+
+  std::string prefix = model.value("continuing_subword_prefix", "##");
+  max_chars_per_word_ = model.value("max_input_chars_per_word", 100);
+
+  const json& normalizer = tokenizer.value("normalizer", json());
+  if (normalizer.is_object()) {
+    lowercase_ = normalizer.value("lowercase", true);
+    // BERT strips accents whenever it lowercases, unless told otherwise
+    const json& strip = normalizer.value("strip_accents", json());
+    strip_accents_ = strip.is_boolean() ? strip.get<bool>() : lowercase_;
+  }
+
+  const json& vocab = model["vocab"];
+  tokens_.resize(vocab.size());
+  for (auto it = vocab.begin(); it != vocab.end(); ++it) {
+    if (!it.value().is_number_unsigned() ||
+        it.value().get<size_t>() >= tokens_.size()) {
+      *error = "Malformed vocabulary in " + path;
+      return false;
+    }
+    tokens_[it.value().get<size_t>()] = it.key();
+  }
+
+  // tokens_ is complete, so the views below stay valid
+  words_.reserve(tokens_.size());
+  for (size_t id = 0; id < tokens_.size(); id++) {
+    std::string_view token = tokens_[id];
+    auto map = &words_;
+    if (!prefix.empty() && token.size() > prefix.size() &&
+        token.compare(0, prefix.size(), prefix) == 0) {
+      token.remove_prefix(prefix.size());
+      map = &continuations_;
+    }
+    map->emplace(token, static_cast<uint32_t>(id));
+  }
+  return true;
+}
+
+size_t StaticEmbeddingModel::embed(std::string_view text,
+                                   std::vector<float>* values) const {
+  thread_local std::vector<uint32_t> ids;
+  ids.clear();
+  tokenize(text, &ids);
+
+  values->assign(dimensions_, 0.0f);
+  float* sum = values->data();
+  for (uint32_t id : ids) {
+    if (dtype_ == DType::kFloat32) {
+      auto* row = reinterpret_cast<const float*>(weights_) + id * dimensions_;
+      for (size_t i = 0; i < dimensions_; i++) {
+        sum[i] += row[i];
+      }
+    } else {
+      auto* row =
+          reinterpret_cast<const uint16_t*>(weights_) + id * dimensions_;
+      for (size_t i = 0; i < dimensions_; i++) {
+        sum[i] += half_to_float(row[i]);
+      }
+    }
+  }
+
+  if (ids.empty()) {
+    return 0;
+  }
+
+  float scale = 1.0f / static_cast<float>(ids.size());
+  if (normalize_) {
+    double norm = 0;
+    for (size_t i = 0; i < dimensions_; i++) {
+      norm += static_cast<double>(sum[i]) * sum[i];
+    }
+    scale = norm > 0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 1.0f;
+  }
+  for (size_t i = 0; i < dimensions_; i++) {
+    sum[i] *= scale;
+  }
+  return ids.size();
+}
+
+void StaticEmbeddingModel::tokenize(std::string_view text,
+                                    std::vector<uint32_t>* ids) const {
+  thread_local std::string word;
+  word.clear();
+
+  const char* p = text.data();
+  const char* end = text.data() + text.size();
+  while (p < end && ids->size() < kMaxTokens) {
+    uint32_t c = next_code_point(&p, end);
+
+    if (is_whitespace(c)) {
+      word_pieces(word, ids);
+      word.clear();
+      continue;
+    }
+    if (is_control(c) || (strip_accents_ && is_combining_mark(c))) {
+      continue;
+    }
+    if (is_punctuation(c) || is_cjk(c)) {
+      word_pieces(word, ids);
+      word.clear();
+      append_utf8(&word, c);
+      word_pieces(word, ids);
+      word.clear();
+      continue;
+    }
+
+    if (strip_accents_ && c >= 0xc0 && c <= 0xff && kLatin1Base[c - 0xc0]) {
+      char base = kLatin1Base[c - 0xc0];
+      // Stripping keeps the case unless the tokenizer also lowercases
+      c = (!lowercase_ && c < 0xe0) ? static_cast<uint32_t>(base - 32)
+                                    : static_cast<uint32_t>(base);
+    } else if (lowercase_) {
+      c = to_lower(c);
+    }
+    append_utf8(&word, c);
+  }
+  word_pieces(word, ids);
+
+  if (ids->size() > kMaxTokens) {
+    ids->resize(kMaxTokens);
+  }
+}
+
+void StaticEmbeddingModel::word_pieces(std::string_view word,
+                                       std::vector<uint32_t>* ids) const {
+  if (word.empty()) {
+    return;
+  }
+
+  size_t chars = 0;
+  for (char c : word) {
+    chars += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+  }
+  if (chars > max_chars_per_word_) {
+    return;  // the unknown token, which is not pooled
+  }
+
+  // Greedy longest-match-first; a word with any unmatched remainder is
+  // unknown as a whole
+  size_t first = ids->size();
+  size_t start = 0;
+  while (start < word.size()) {
+    const auto& vocabulary = start == 0 ? words_ : continuations_;
+    size_t end = word.size();
+    bool matched = false;
+    while (end > start) {
+      auto found = vocabulary.find(word.substr(start, end - start));
+      if (found != vocabulary.end()) {
+        ids->push_back(found->second);
+        matched = true;
+        break;
+      }
+      // Step back one whole character
+      do {
+        end--;
+      } while (end > start &&
+               (static_cast<unsigned char>(word[end]) & 0xc0) == 0x80);
+    }
+    if (!matched) {
+      ids->resize(first);
+      return;
+    }
+    start = end;
+  }
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,101 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_STATIC_EMBEDDING_H
+#define VSQL_AI_STATIC_EMBEDDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vsql_ai {
+
+// A static embedding model in the Model2Vec layout: one vector per
+// vocabulary token, mean-pooled over the tokens of a text instead of
+// running a transformer, which makes an embedding a few microseconds of
+// table lookups.
+//
+// A model is a directory holding
+//   model.safetensors  an "embeddings" tensor of F32 or F16, one row per
+//                      token id
+//   tokenizer.json     a Hugging Face WordPiece tokenizer (BERT style)
+//   config.json        optional; "normalize": false keeps the pooled
+//                      vector's length, otherwise it is scaled to unit length
+//
+// The weights are memory-mapped read-only, so the page cache holds one copy
+// however many sessions use the model. Instances are immutable once loaded
+// and safe to use from any number of threads.
+class StaticEmbeddingModel {
+ public:
+  // Returns nullptr and sets *error if the directory does not hold a usable
+  // model
+  static std::unique_ptr<StaticEmbeddingModel> load(
+      const std::string& directory, std::string* error);
+
+  ~StaticEmbeddingModel();
+
+  size_t dimensions() const { return dimensions_; }
+
+  // Embed text into *values and return the number of tokens pooled. Tokens
+  // missing from the vocabulary are skipped, as Model2Vec does; a text with
+  // no known token gets the zero vector.
+  size_t embed(std::string_view text, std::vector<float>* values) const;
+
+  // Largest number of tokens pooled per text; the rest of a longer text is
+  // ignored (Model2Vec's default max_length)
+  static constexpr size_t kMaxTokens = 512;
+
+ private:
+  enum class DType { kFloat32, kFloat16 };
+
+  StaticEmbeddingModel() = default;
+
+  bool load_weights(const std::string& path, std::string* error);
+  bool load_tokenizer(const std::string& path, std::string* error);
+
+  // BERT normalization and pre-tokenization, then greedy longest-match
+  // WordPiece; appends the ids of known tokens to *ids
+  void tokenize(std::string_view text, std::vector<uint32_t>* ids) const;
+  void word_pieces(std::string_view word, std::vector<uint32_t>* ids) const;
+
+  // Mapped safetensors file
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  const char* weights_ = nullptr;
+  DType dtype_ = DType::kFloat32;
+  size_t rows_ = 0;
+  size_t dimensions_ = 0;
+  bool normalize_ = true;
+
+  // Vocabulary. The maps view strings owned by tokens_, which is not
+  // modified once they are built; continuation pieces are keyed without
+  // their prefix.
+  std::vector<std::string> tokens_;
+  std::unordered_map<std::string_view, uint32_t> words_;
+  std::unordered_map<std::string_view, uint32_t> continuations_;
+  size_t max_chars_per_word_ = 100;
+  bool lowercase_ = true;
+  bool strip_accents_ = true;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_STATIC_EMBEDDING_H
@@ -0,0 +1,228 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "text_chunker.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "utf8_util.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Characters a token of the estimate stands for in a run of letters
+constexpr size_t kLettersPerToken = 4;
+
+// Strength of the break after a piece of text; chunks are cut at the
+// strongest one available
+enum Boundary : int {
+  kInsideWord = 0,
+  kSpace = 1,
+  kSentence = 2,  // also a line break
+  kParagraph = 3,
+};
+
+// A word and the whitespace after it
+struct Piece {
+  size_t begin;
+  size_t word_end;
+  size_t end;
+  size_t tokens;
+  Boundary boundary;
+};
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+bool is_ascii_punctuation(uint32_t c) {
+  return (c >= 33 && c <= 47) || (c >= 58 && c <= 64) ||
+         (c >= 91 && c <= 96) || (c >= 123 && c <= 126);
+}
+
+// Scripts written without spaces, and fullwidth forms, where tokenizers
+// spend about a token per character
+bool is_wide(uint32_t c) {
+  return (c >= 0x0e00 && c <= 0x0eff) ||  // Thai, Lao
+         (c >= 0x2e80 && c <= 0xa4cf) ||  // CJK, kana, Yi
+         (c >= 0xac00 && c <= 0xd7af) ||  // Hangul
+         (c >= 0xf900 && c <= 0xfaff) || (c >= 0xff00 && c <= 0xffef) ||
+         (c >= 0x20000 && c <= 0x3ffff);
+}
+
+// Ideographic full stop and fullwidth ! and ?, which end sentences without
+// a following space
+bool is_wide_sentence_end(uint32_t c) {
+  return c == 0x3002 || c == 0xff01 || c == 0xff1f;
+}
+
+bool ends_sentence(std::string_view word) {
+  // Look past closing quotes and brackets
+  size_t i = word.size();
+  while (i > 0 && (word[i - 1] == '"' || word[i - 1] == '\'' ||
+                   word[i - 1] == ')' || word[i - 1] == ']')) {
+    i--;
+  }
+  return i > 0 &&
+         (word[i - 1] == '.' || word[i - 1] == '!' || word[i - 1] == '?');
+}
+
+size_t run_tokens(size_t letters) {
+  return (letters + kLettersPerToken - 1) / kLettersPerToken;
+}
+
+// Split text into pieces of at most max_tokens each
+std::vector<Piece> split_pieces(std::string_view text, size_t max_tokens) {
+  std::vector<Piece> pieces;
+  const char* data = text.data();
+  size_t size = text.size();
+  size_t pos = 0;
+  while (pos < size && is_space(data[pos])) {
+    pos++;
+  }
+
+  while (pos < size) {
+    Piece piece;
+    piece.begin = pos;
+    size_t tokens = 0;   // of the word up to the current run of letters
+    size_t letters = 0;  // in the current run
+    bool cut = false;
+    bool wide_stop = false;
+
+    while (pos < size && !is_space(data[pos])) {
+      const char* p = data + pos;
+      uint32_t c = next_code_point(&p, data + size);
+      bool letter = !is_ascii_punctuation(c) && !is_wide(c);
+
+      // Cut a word that would not fit a chunk by itself
+      size_t with_c = letter ? tokens + run_tokens(letters + 1)
+                             : tokens + run_tokens(letters) + 1;
+      if (with_c > max_tokens && pos > piece.begin) {
+        cut = true;
+        break;
+      }
+
+      if (letter) {
+        letters++;
+      } else {
+        tokens += run_tokens(letters) + 1;
+        letters = 0;
+      }
+      pos = static_cast<size_t>(p - data);
+      if (is_wide_sentence_end(c)) {
+        wide_stop = true;
+        break;
+      }
+    }
+
+    piece.word_end = pos;
+    piece.tokens = tokens + run_tokens(letters);
+    if (cut) {
+      piece.boundary = kInsideWord;
+    } else {
+      size_t newlines = 0;
+      while (pos < size && is_space(data[pos])) {
+        newlines += data[pos] == '\n';
+        pos++;
+      }
+      std::string_view word(data + piece.begin, piece.word_end - piece.begin);
+      if (newlines >= 2 || pos == size) {
+        piece.boundary = kParagraph;
+      } else if (newlines == 1 || wide_stop || ends_sentence(word)) {
+        piece.boundary = kSentence;
+      } else {
+        piece.boundary = kSpace;
+      }
+    }
+    piece.end = pos;
+    pieces.push_back(piece);
+  }
+  return pieces;
+}
+
+}  // namespace
+
+size_t estimate_tokens(std::string_view text) {
+  size_t tokens = 0;
+  for (const Piece& piece :
+       split_pieces(text, std::numeric_limits<size_t>::max())) {
+    tokens += piece.tokens;
+  }
+  return tokens;
+}
+
+std::vector<TextChunk> chunk_text(std::string_view text, size_t max_tokens,
+                                  size_t overlap) {
+  max_tokens = std::max<size_t>(1, max_tokens);
+  overlap = std::min(overlap, max_tokens - 1);
+  std::vector<Piece> pieces = split_pieces(text, max_tokens);
+
+  std::vector<TextChunk> chunks;
+  auto emit = [&](size_t first, size_t last, size_t tokens) {
+    size_t begin = pieces[first].begin;
+    chunks.push_back(
+        {text.substr(begin, pieces[last - 1].word_end - begin), tokens});
+  };
+
+  size_t start = 0;
+  while (start < pieces.size()) {
+    // Take as many pieces as fit
+    size_t end = start;
+    size_t tokens = 0;
+    while (end < pieces.size() && tokens + pieces[end].tokens <= max_tokens) {
+      tokens += pieces[end].tokens;
+      end++;
+    }
+    if (end == pieces.size()) {
+      emit(start, end, tokens);
+      break;
+    }
+
+    // Cut after the strongest boundary past the first quarter, the latest of
+    // equally strong ones. Without one, as before a long word that was cut,
+    // keep everything that fits.
+    size_t cut = end;
+    size_t cut_tokens = tokens;
+    int best = -1;
+    size_t taken = 0;
+    for (size_t i = start; i < end; i++) {
+      taken += pieces[i].tokens;
+      if (4 * taken >= max_tokens && pieces[i].boundary >= best) {
+        best = pieces[i].boundary;
+        cut = i + 1;
+        cut_tokens = taken;
+      }
+    }
+    emit(start, cut, cut_tokens);
+
+    // Start the next chunk far enough back to repeat up to overlap tokens,
+    // but always after this chunk's start
+    size_t next = cut;
+    size_t repeated = 0;
+    while (next - 1 > start && repeated + pieces[next - 1].tokens <= overlap) {
+      repeated += pieces[next - 1].tokens;
+      next--;
+    }
+    start = next;
+  }
+  return chunks;
+}
+
+}  // namespace vsql_ai
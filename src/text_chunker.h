@@ -0,0 +1,53 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_TEXT_CHUNKER_H
+#define VSQL_AI_TEXT_CHUNKER_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace vsql_ai {
+
+// Splitting documents into pieces that fit an embedding model's input.
+//
+// Token counts are estimates, as the providers' tokenizers are not
+// available: a token per 4 letters or digits of a word, per punctuation
+// mark and per CJK, kana or Hangul character. That runs a little high for
+// English text, so chunks stay under the model's limit.
+
+struct TextChunk {
+  std::string_view text;  // a slice of the input, without surrounding space
+  size_t tokens;          // estimated
+};
+
+// Estimated number of tokens in text
+size_t estimate_tokens(std::string_view text);
+
+// Split text into chunks of at most max_tokens, cutting at the strongest
+// boundary past the first quarter of each chunk: a paragraph break, then a
+// line break or the end of a sentence, then a space. A word longer than
+// max_tokens is cut inside. Each chunk after the first starts with up to
+// overlap tokens of the end of the previous one, whole words only. Text
+// that is empty or all whitespace has no chunks.
+std::vector<TextChunk> chunk_text(std::string_view text, size_t max_tokens,
+                                  size_t overlap);
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_TEXT_CHUNKER_H
@@ -0,0 +1,63 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_UTF8_UTIL_H
+#define VSQL_AI_UTF8_UTIL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vsql_ai {
+
+// Decode the code point at *p, advancing past it. Malformed sequences
+// decode to U+FFFD one byte at a time.
+inline uint32_t next_code_point(const char** p, const char* end) {
+  auto* s = reinterpret_cast<const unsigned char*>(*p);
+  size_t available = static_cast<size_t>(end - *p);
+  uint32_t c = s[0];
+  size_t length = 1;
+
+  if (c >= 0xc2 && c <= 0xdf && available >= 2 && (s[1] & 0xc0) == 0x80) {
+    c = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+    length = 2;
+  } else if (c >= 0xe0 && c <= 0xef && available >= 3 &&
+             (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80) {
+    c = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+    length = 3;
+    if (c < 0x800 || (c >= 0xd800 && c <= 0xdfff)) {
+      c = 0xfffd;
+    }
+  } else if (c >= 0xf0 && c <= 0xf4 && available >= 4 &&
+             (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80 &&
+             (s[3] & 0xc0) == 0x80) {
+    c = ((c & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) |
+        (s[3] & 0x3f);
+    length = 4;
+    if (c < 0x10000 || c > 0x10ffff) {
+      c = 0xfffd;
+    }
+  } else if (c >= 0x80) {
+    c = 0xfffd;
+  }
+
+  *p += length;
+  return c;
+}
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_UTF8_UTIL_H
@@ -0,0 +1,288 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vector_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "float_chars.h"
+
+namespace vsql_ai {
+
+namespace {
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+const char* skip_space(const char* p, const char* end) {
+  while (p < end && is_space(*p)) {
+    p++;
+  }
+  return p;
+}
+
+char* put_u16_le(char* out, uint16_t value) {
+  out[0] = static_cast<char>(value & 0xff);
+  out[1] = static_cast<char>(value >> 8);
+  return out + 2;
+}
+
+char* put_f32_le(char* out, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int shift = 0; shift < 32; shift += 8) {
+    *out++ = static_cast<char>((bits >> shift) & 0xff);
+  }
+  return out;
+}
+
+// IEEE 754 binary32 -> binary16, round to nearest even
+uint16_t float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent == 0xff) {
+    // Inf stays Inf, NaN stays a (quiet) NaN
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+
+  int half_exponent = static_cast<int>(exponent) - 127 + 15;
+  if (half_exponent >= 0x1f) {
+    return sign | 0x7c00;  // overflow to Inf
+  }
+
+  if (half_exponent <= 0) {
+    // Subnormal half (or zero)
+    if (half_exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    int shift = 14 - half_exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+      half_mantissa++;
+    }
+    return sign | static_cast<uint16_t>(half_mantissa);
+  }
+
+  uint16_t half = sign | static_cast<uint16_t>(half_exponent << 10) |
+                  static_cast<uint16_t>(mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1fff;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    half++;  // may carry into the exponent, which is still correct
+  }
+  return half;
+}
+
+}  // namespace
+
+bool parse_json_vector(std::string_view text, std::vector<float>* values) {
+  const char* p = skip_space(text.data(), text.data() + text.size());
+  const char* end = text.data() + text.size();
+  values->clear();
+
+  if (p == end || *p != '[') {
+    return false;
+  }
+  p = skip_space(p + 1, end);
+
+  if (p < end && *p == ']') {
+    return skip_space(p + 1, end) == end;
+  }
+
+  while (p < end) {
+    float value;
+    const char* parsed = parse_float(p, end, &value);
+    if (parsed == nullptr) {
+      return false;
+    }
+    values->push_back(value);
+
+    p = skip_space(parsed, end);
+    if (p == end) {
+      return false;
+    }
+    if (*p == ']') {
+      return skip_space(p + 1, end) == end;
+    }
+    if (*p != ',') {
+      return false;
+    }
+    p = skip_space(p + 1, end);
+  }
+  return false;
+}
+
+std::string format_json_vector(const float* values, size_t count) {
+  std::string text(max_json_vector_size(count), '\0');
+  text.resize(format_json_vector(values, count, &text[0], text.size()));
+  return text;
+}
+
+size_t max_json_vector_size(size_t count) {
+  // Round-trip floats are at most 15 characters, plus a separator
+  return 2 + count * 16;
+}
+
+size_t format_json_vector(const float* values, size_t count, char* out,
+                          size_t capacity) {
+  char* p = out;
+  char* end = out + capacity;
+  if (p == end) {
+    return 0;
+  }
+  *p++ = '[';
+
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) {
+      if (p == end) {
+        return 0;
+      }
+      *p++ = ',';
+    }
+    if (!std::isfinite(values[i])) {
+      // JSON has no NaN/Infinity
+      if (p == end) {
+        return 0;
+      }
+      *p++ = '0';
+      continue;
+    }
+    p = format_float(p, end, values[i]);
+    if (p == nullptr) {
+      return 0;
+    }
+  }
+
+  if (p == end) {
+    return 0;
+  }
+  *p++ = ']';
+  return static_cast<size_t>(p - out);
+}
+
+bool parse_binary_format(std::string_view name, BinaryFormat* format) {
+  if (name == "float32") {
+    *format = BinaryFormat::kFloat32;
+  } else if (name == "float16") {
+    *format = BinaryFormat::kFloat16;
+  } else if (name == "int8") {
+    *format = BinaryFormat::kInt8;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+size_t binary_vector_size(size_t count, BinaryFormat format) {
+  switch (format) {
+    case BinaryFormat::kFloat32:
+      return count * 4;
+    case BinaryFormat::kFloat16:
+      return count * 2;
+    case BinaryFormat::kInt8:
+      return 4 + count;
+  }
+  return 0;
+}
+
+std::string encode_binary_vector(const float* values, size_t count,
+                                 BinaryFormat format) {
+  std::string bytes(binary_vector_size(count, format), '\0');
+  encode_binary_vector(values, count, format, &bytes[0]);
+  return bytes;
+}
+
+void encode_binary_vector(const float* values, size_t count,
+                          BinaryFormat format, char* out) {
+  switch (format) {
+    case BinaryFormat::kFloat32:
+      for (size_t i = 0; i < count; i++) {
+        out = put_f32_le(out, values[i]);
+      }
+      break;
+
+    case BinaryFormat::kFloat16:
+      for (size_t i = 0; i < count; i++) {
+        out = put_u16_le(out, float_to_half(values[i]));
+      }
+      break;
+
+    case BinaryFormat::kInt8: {
+      // Symmetric per-vector quantization: the largest magnitude maps to 127
+      float max_abs = 0.0f;
+      for (size_t i = 0; i < count; i++) {
+        if (std::isfinite(values[i])) {
+          max_abs = std::max(max_abs, std::fabs(values[i]));
+        }
+      }
+      float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+
+      out = put_f32_le(out, scale);
+      for (size_t i = 0; i < count; i++) {
+        float q = std::isfinite(values[i]) ? std::round(values[i] / scale) : 0;
+        q = std::min(127.0f, std::max(-127.0f, q));
+        *out++ = static_cast<char>(static_cast<int8_t>(q));
+      }
+      break;
+    }
+  }
+}
+
+bool decode_float32_vector(std::string_view bytes, std::vector<float>* values) {
+  values->clear();
+  if (bytes.size() % 4 != 0) {
+    return false;
+  }
+
+  size_t count = bytes.size() / 4;
+  values->resize(count);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(values->data(), bytes.data(), bytes.size());
+#else
+  auto* p = reinterpret_cast<const unsigned char*>(bytes.data());
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bits = static_cast<uint32_t>(p[4 * i]) |
+                    static_cast<uint32_t>(p[4 * i + 1]) << 8 |
+                    static_cast<uint32_t>(p[4 * i + 2]) << 16 |
+                    static_cast<uint32_t>(p[4 * i + 3]) << 24;
+    memcpy(&(*values)[i], &bits, sizeof(bits));
+  }
+#endif
+  return true;
+}
+
+bool parse_vector(std::string_view value, std::vector<float>* values) {
+  const char* p = skip_space(value.data(), value.data() + value.size());
+  if (p < value.data() + value.size() && *p == '[' &&
+      parse_json_vector(value, values)) {
+    return true;
+  }
+  // A float32 payload whose first byte happens to be '[' falls through here
+  return decode_float32_vector(value, values);
+}
+
+}  // namespace vsql_ai
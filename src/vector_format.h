@@ -0,0 +1,74 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_VECTOR_FORMAT_H
+#define VSQL_AI_VECTOR_FORMAT_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsql_ai {
+
+// Conversions between embedding vectors and their SQL representations
+
+// Parse a JSON array of numbers such as "[0.1, -2e-3]". Returns false if the
+// text is not a flat array of numbers.
+bool parse_json_vector(std::string_view text, std::vector<float>* values);
+
+// Format as a JSON array using the shortest text that round-trips each float
+std::string format_json_vector(const float* values, size_t count);
+
+// Upper bound on the length of format_json_vector()'s output
+size_t max_json_vector_size(size_t count);
+
+// Format into a caller-owned buffer, such as a function's result buffer.
+// Returns the length written, or 0 if the array does not fit in capacity.
+size_t format_json_vector(const float* values, size_t count, char* out,
+                          size_t capacity);
+
+// Packed little-endian binary encodings for storing vectors in BLOB columns
+enum class BinaryFormat {
+  kFloat32,  // 4 bytes per dimension, same layout as MySQL's VECTOR type
+  kFloat16,  // 2 bytes per dimension, IEEE 754 half precision
+  kInt8,     // float32 scale, then 1 byte per dimension: value = q * scale
+};
+
+// Accepts "float32", "float16" or "int8"
+bool parse_binary_format(std::string_view name, BinaryFormat* format);
+
+std::string encode_binary_vector(const float* values, size_t count,
+                                 BinaryFormat format);
+
+// Exact length of the encoding of count dimensions
+size_t binary_vector_size(size_t count, BinaryFormat format);
+
+// Encode into a caller-owned buffer of at least binary_vector_size() bytes
+void encode_binary_vector(const float* values, size_t count,
+                          BinaryFormat format, char* out);
+
+// Decode packed float32. Returns false if the length is not a multiple of 4.
+bool decode_float32_vector(std::string_view bytes, std::vector<float>* values);
+
+// Accept either representation: a JSON array, or packed float32 as stored by
+// create_embed_binary(..., 'float32') and MySQL's VECTOR type. Text starting
+// with '[' is tried as JSON first.
+bool parse_vector(std::string_view value, std::vector<float>* values);
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_VECTOR_FORMAT_H
@@ -0,0 +1,848 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "vector_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <thread>
+
+#include "config.h"
+#include "vector_ops.h"
+#include "worker_pool.h"
+
+namespace vsql_ai {
+
+namespace {
+
+constexpr char kFileMagic[8] = {'V', 'S', 'Q', 'L', 'H', 'N', 'S', '1'};
+
+// Fixed header of a saved index. The sections that follow, each padded to
+// 8 bytes: ids (int64 per node), levels (a byte per node), the links of
+// the nodes above level 0 in node order (level * (1 + m) per such node) and
+// the level 0 records.
+struct FileHeader {
+  char magic[8];
+  uint32_t metric;
+  uint32_t dimensions;
+  uint32_t m;
+  uint32_t ef_construction;
+  uint32_t ef_search;
+  int32_t max_level;
+  uint64_t count;
+  int64_t entry_point;
+  uint64_t upper_links;
+  uint64_t reserved;
+};
+static_assert(sizeof(FileHeader) == 64, "file header must stay packed");
+
+// Vectors a worker task takes from the queue at a time
+constexpr size_t kInsertChunk = 64;
+
+// Nodes allocated at once while an index grows, at the least
+constexpr size_t kMinCapacity = 1024;
+
+// Levels are capped so that a node's level fits the byte it is saved in
+constexpr int kMaxLevel = 32;
+
+size_t padded(size_t bytes) { return (bytes + 7) & ~size_t{7}; }
+
+// Per-thread visited marks for graph searches; a search bumps the epoch
+// instead of clearing the marks
+struct VisitedSet {
+  std::vector<uint32_t> marks;
+  uint32_t epoch = 0;
+
+  void reset(size_t capacity) {
+    if (marks.size() < capacity) {
+      marks.resize(capacity, 0);
+    }
+    if (++epoch == 0) {
+      std::fill(marks.begin(), marks.end(), 0);
+      epoch = 1;
+    }
+  }
+
+  // Returns true the first time node is seen since the last reset
+  bool visit(uint32_t node) {
+    if (marks[node] == epoch) {
+      return false;
+    }
+    marks[node] = epoch;
+    return true;
+  }
+};
+
+int random_level(double multiplier) {
+  thread_local std::mt19937_64 generator(std::random_device{}());
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double level = -std::log(1.0 - uniform(generator)) * multiplier;
+  return std::min(kMaxLevel, static_cast<int>(level));
+}
+
+bool normalize(float* values, size_t count) {
+  double norm = 0;
+  for (size_t i = 0; i < count; i++) {
+    norm += static_cast<double>(values[i]) * values[i];
+  }
+  if (norm == 0 || !std::isfinite(norm)) {
+    return false;
+  }
+  float scale = static_cast<float>(1.0 / std::sqrt(norm));
+  for (size_t i = 0; i < count; i++) {
+    values[i] *= scale;
+  }
+  return true;
+}
+
+}  // namespace
+
+// =============================================================================
+// VectorIndex
+// =============================================================================
+
+VectorIndex::VectorIndex(const Options& options)
+    : metric_(options.metric),
+      dimensions_(options.dimensions),
+      m_(std::max<uint32_t>(2, options.m)),
+      ef_construction_(std::max<uint32_t>(1, options.ef_construction)),
+      ef_search_(std::max<uint32_t>(1, options.ef_search)),
+      level_multiplier_(1.0 / std::log(static_cast<double>(m_))) {
+  long threads = config_int("VECTOR_INDEX_BUILD_THREADS",
+                            std::thread::hardware_concurrency());
+  max_tasks_ = static_cast<size_t>(std::max(1L, threads));
+}
+
+VectorIndex::~VectorIndex() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
+size_t VectorIndex::node_bytes() const {
+  return (1 + 2 * m_) * sizeof(Links) + dimensions_ * sizeof(float);
+}
+
+VectorIndex::Links* VectorIndex::level0(Node node) const {
+  return reinterpret_cast<Links*>(nodes_ + node * node_bytes());
+}
+
+const float* VectorIndex::vector(Node node) const {
+  return reinterpret_cast<const float*>(level0(node) + 1 + 2 * m_);
+}
+
+VectorIndex::Links* VectorIndex::links(Node node, int level) const {
+  if (level == 0) {
+    return level0(node);
+  }
+  return upper_links_[node].get() + (level - 1) * (1 + m_);
+}
+
+float VectorIndex::distance(const float* a, const float* b) const {
+  const VectorKernels& kernels = vector_kernels();
+  switch (metric_) {
+    case Metric::kCosine:
+      // Vectors are normalized when they are added
+      return 1.0f - kernels.dot(a, b, dimensions_);
+    case Metric::kL2:
+      return kernels.l2_squared(a, b, dimensions_);
+    case Metric::kDot:
+      return -kernels.dot(a, b, dimensions_);
+  }
+  return 0.0f;
+}
+
+void VectorIndex::grow(size_t capacity) {
+  size_t bytes = capacity * node_bytes();
+  if (mapping_) {
+    // The first change to a loaded index copies its records out of the
+    // mapping; after that they grow in place
+    owned_.resize(bytes);
+    memcpy(owned_.data(), nodes_, size_ * node_bytes());
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  } else {
+    owned_.resize(bytes);
+  }
+  nodes_ = owned_.data();
+  capacity_ = capacity;
+  ids_.resize(capacity);
+  levels_.resize(capacity);
+  upper_links_.resize(capacity);
+}
+
+bool VectorIndex::add(int64_t id, const float* values, size_t count,
+                      std::string* error) {
+  if (count == 0) {
+    *error = "Cannot index an empty vector";
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  if (dimensions_ == 0) {
+    std::unique_lock<std::shared_mutex> resize(resize_mutex_);
+    dimensions_ = static_cast<uint32_t>(count);
+  }
+  if (count != dimensions_) {
+    *error = "Vector has " + std::to_string(count) +
+             " dimensions; the index has " + std::to_string(dimensions_);
+    return false;
+  }
+  if (nodes_by_id_.count(id) > 0) {
+    *error = "Id " + std::to_string(id) + " is already in the index";
+    return false;
+  }
+
+  if (size_ == capacity_) {
+    std::unique_lock<std::shared_mutex> resize(resize_mutex_);
+    grow(std::max(kMinCapacity, capacity_ * 2));
+  }
+
+  // The record is not reachable from the graph until it is inserted, so it
+  // is filled in without the link locks. Growth only happens under
+  // queue_mutex_, which is held.
+  Node node = static_cast<Node>(size_);
+  float* stored = const_cast<float*>(vector(node));
+  memcpy(stored, values, count * sizeof(float));
+  if (metric_ == Metric::kCosine && !normalize(stored, count)) {
+    *error = "Cannot index a zero vector with the cosine metric";
+    return false;
+  }
+
+  int level = random_level(level_multiplier_);
+  level0(node)[0] = 0;
+  ids_[node] = id;
+  levels_[node] = static_cast<uint8_t>(level);
+  if (level > 0) {
+    size_t upper = static_cast<size_t>(level) * (1 + m_);
+    upper_links_[node].reset(new Links[upper]());
+  }
+
+  nodes_by_id_.emplace(id, node);
+  size_++;
+  queue_.emplace_back(node, level);
+
+  // Start another inserter once a chunk is waiting
+  if (queue_.size() >= kInsertChunk && running_tasks_ < max_tasks_) {
+    running_tasks_++;
+    auto self = shared_from_this();
+    WorkerPool::instance().submit([self] { self->insert_queued(); });
+  }
+  return true;
+}
+
+void VectorIndex::flush() {
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  wait_for_inserts(&lock);
+}
+
+void VectorIndex::wait_for_inserts(std::unique_lock<std::mutex>* lock) {
+  while (!queue_.empty() || running_tasks_ > 0) {
+    // A tail shorter than a chunk has no task yet
+    if (!queue_.empty() && running_tasks_ == 0) {
+      running_tasks_++;
+      auto self = shared_from_this();
+      WorkerPool::instance().submit([self] { self->insert_queued(); });
+    }
+    queue_changed_.wait(*lock);
+  }
+}
+
+void VectorIndex::insert_queued() {
+  std::vector<std::pair<Node, int>> chunk;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      inserted_ += chunk.size();
+      chunk.clear();
+      if (queue_.empty()) {
+        running_tasks_--;
+        queue_changed_.notify_all();
+        return;
+      }
+      size_t take = std::min(kInsertChunk, queue_.size());
+      chunk.assign(queue_.end() - take, queue_.end());
+      queue_.resize(queue_.size() - take);
+    }
+
+    for (const auto& [node, level] : chunk) {
+      std::shared_lock<std::shared_mutex> resize(resize_mutex_);
+      insert(node, level);
+    }
+  }
+}
+
+VectorIndex::Node VectorIndex::greedy_descend(const float* query, Node entry,
+                                              int from_level,
+                                              int to_level) const {
+  Node current = entry;
+  float current_distance = distance(query, vector(current));
+  thread_local std::vector<Links> neighbors;
+
+  for (int level = from_level; level > to_level; level--) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      {
+        std::lock_guard<std::mutex> lock(lock_for(current));
+        const Links* list = links(current, level);
+        size_t count = std::min<size_t>(list[0], max_links(level));
+        neighbors.assign(list + 1, list + 1 + count);
+      }
+      for (Links neighbor : neighbors) {
+        if (neighbor >= capacity_ || levels_[neighbor] < level) {
+          continue;  // only in a corrupt file
+        }
+        float d = distance(query, vector(neighbor));
+        if (d < current_distance) {
+          current = neighbor;
+          current_distance = d;
+          changed = true;
+        }
+      }
+    }
+  }
+  return current;
+}
+
+std::vector<std::pair<float, VectorIndex::Node>> VectorIndex::search_level(
+    const float* query, Node entry, size_t ef, int level) const {
+  using Candidate = std::pair<float, Node>;
+  thread_local VisitedSet visited;
+  thread_local std::vector<Links> neighbors;
+  visited.reset(capacity_);
+
+  // Closest unexpanded candidate on top of one heap, the farthest of the
+  // best ef found on top of the other
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>>
+      candidates;
+  std::priority_queue<Candidate> best;
+
+  float d = distance(query, vector(entry));
+  candidates.emplace(d, entry);
+  best.emplace(d, entry);
+  visited.visit(entry);
+
+  while (!candidates.empty()) {
+    Candidate current = candidates.top();
+    if (current.first > best.top().first && best.size() >= ef) {
+      break;
+    }
+    candidates.pop();
+
+    {
+      std::lock_guard<std::mutex> lock(lock_for(current.second));
+      const Links* list = links(current.second, level);
+      size_t count = std::min<size_t>(list[0], max_links(level));
+      neighbors.assign(list + 1, list + 1 + count);
+    }
+
+    for (Links neighbor : neighbors) {
+      if (neighbor >= capacity_ || levels_[neighbor] < level ||
+          !visited.visit(neighbor)) {
+        continue;
+      }
+      d = distance(query, vector(neighbor));
+      if (best.size() < ef || d < best.top().first) {
+        candidates.emplace(d, neighbor);
+        best.emplace(d, neighbor);
+        if (best.size() > ef) {
+          best.pop();
+        }
+      }
+    }
+  }
+
+  std::vector<Candidate> result(best.size());
+  for (size_t i = result.size(); i > 0; i--) {
+    result[i - 1] = best.top();
+    best.pop();
+  }
+  return result;
+}
+
+void VectorIndex::select_neighbors(
+    std::vector<std::pair<float, Node>>* candidates, size_t max) const {
+  if (candidates->size() <= max) {
+    return;
+  }
+
+  std::vector<std::pair<float, Node>> selected;
+  selected.reserve(max);
+  for (const auto& candidate : *candidates) {
+    if (selected.size() >= max) {
+      break;
+    }
+    bool diverse = true;
+    for (const auto& chosen : selected) {
+      if (distance(vector(candidate.second), vector(chosen.second)) <
+          candidate.first) {
+        diverse = false;
+        break;
+      }
+    }
+    if (diverse) {
+      selected.push_back(candidate);
+    }
+  }
+  *candidates = std::move(selected);
+}
+
+void VectorIndex::connect(Node node,
+                          const std::vector<std::pair<float, Node>>& neighbors,
+                          int level) {
+  size_t max = max_links(level);
+  {
+    std::lock_guard<std::mutex> lock(lock_for(node));
+    Links* list = links(node, level);
+    list[0] = static_cast<Links>(std::min(neighbors.size(), max));
+    for (size_t i = 0; i < list[0]; i++) {
+      list[1 + i] = neighbors[i].second;
+    }
+  }
+
+  // Link back from each neighbor; a full list keeps the most diverse of its
+  // links plus the new one. Only one link lock is held at a time.
+  std::vector<std::pair<float, Node>> pruned;
+  for (const auto& [unused, neighbor] : neighbors) {
+    if (neighbor == node) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(lock_for(neighbor));
+    Links* list = links(neighbor, level);
+    size_t count = std::min<size_t>(list[0], max);
+    if (count < max) {
+      list[1 + count] = node;
+      list[0] = static_cast<Links>(count + 1);
+      continue;
+    }
+
+    const float* base = vector(neighbor);
+    pruned.clear();
+    pruned.emplace_back(distance(base, vector(node)), node);
+    for (size_t i = 0; i < count; i++) {
+      pruned.emplace_back(distance(base, vector(list[1 + i])), list[1 + i]);
+    }
+    std::sort(pruned.begin(), pruned.end());
+    select_neighbors(&pruned, max);
+    list[0] = static_cast<Links>(pruned.size());
+    for (size_t i = 0; i < pruned.size(); i++) {
+      list[1 + i] = pruned[i].second;
+    }
+  }
+}
+
+void VectorIndex::insert(Node node, int level) {
+  const float* query = vector(node);
+
+  // A node that raises the top level becomes the entry point, and holds the
+  // entry lock until it is linked so no search starts from it half-built
+  std::unique_lock<std::mutex> top(entry_mutex_);
+  int max_level = max_level_.load();
+  if (level <= max_level) {
+    top.unlock();
+  }
+
+  int64_t entry = entry_point_.load();
+  if (entry < 0) {
+    entry_point_ = node;
+    max_level_ = level;
+    return;
+  }
+
+  Node current = greedy_descend(query, static_cast<Node>(entry), max_level,
+                                level);
+  for (int l = std::min(level, max_level); l >= 0; l--) {
+    auto candidates = search_level(query, current, ef_construction_, l);
+    current = candidates.front().second;
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [node](const auto& candidate) {
+                                      return candidate.second == node;
+                                    }),
+                     candidates.end());
+    select_neighbors(&candidates, m_);
+    connect(node, candidates, l);
+  }
+
+  if (level > max_level) {
+    entry_point_ = node;
+    max_level_ = level;
+  }
+}
+
+bool VectorIndex::search(const float* query, size_t count, size_t k,
+                         std::vector<Neighbor>* neighbors,
+                         std::string* error) {
+  neighbors->clear();
+  flush();
+
+  std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+  if (dimensions_ == 0) {
+    return true;  // nothing added yet
+  }
+  if (count != dimensions_) {
+    *error = "Query has " + std::to_string(count) +
+             " dimensions; the index has " + std::to_string(dimensions_);
+    return false;
+  }
+
+  thread_local std::vector<float> normalized;
+  if (metric_ == Metric::kCosine) {
+    normalized.assign(query, query + count);
+    if (!normalize(normalized.data(), count)) {
+      *error = "Cannot search with a zero vector with the cosine metric";
+      return false;
+    }
+    query = normalized.data();
+  }
+
+  int64_t entry = entry_point_.load();
+  if (entry < 0) {
+    return true;
+  }
+  Node start =
+      greedy_descend(query, static_cast<Node>(entry), max_level_.load(), 0);
+  auto found = search_level(query, start, std::max<size_t>(ef_search_, k), 0);
+
+  size_t results = std::min(k, found.size());
+  neighbors->reserve(results);
+  for (size_t i = 0; i < results; i++) {
+    float d = found[i].first;
+    if (metric_ == Metric::kL2) {
+      d = std::sqrt(d);
+    }
+    neighbors->push_back({ids_[found[i].second], d});
+  }
+  return true;
+}
+
+VectorIndex::Stats VectorIndex::stats() {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  std::shared_lock<std::shared_mutex> resize(resize_mutex_);
+  Stats stats;
+  stats.options.metric = metric_;
+  stats.options.dimensions = dimensions_;
+  stats.options.m = m_;
+  stats.options.ef_construction = ef_construction_;
+  stats.options.ef_search = ef_search_;
+  stats.vectors = size_;
+  stats.pending = size_ - inserted_;
+  stats.max_level = max_level_.load();
+  stats.bytes = capacity_ * (node_bytes() + sizeof(int64_t) + 1);
+  for (size_t node = 0; node < size_; node++) {
+    stats.bytes += levels_[node] * (1 + m_) * sizeof(Links);
+  }
+  return stats;
+}
+
+bool VectorIndex::save(const std::string& path, std::string* error) {
+  // Once the queue drains its lock is kept, so nothing is added or inserted
+  // while the file is written; searches go on
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  wait_for_inserts(&lock);
+  std::shared_lock<std::shared_mutex> resize(resize_mutex_);
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+  header.metric = static_cast<uint32_t>(metric_);
+  header.dimensions = dimensions_;
+  header.m = m_;
+  header.ef_construction = ef_construction_;
+  header.ef_search = ef_search_;
+  header.max_level = max_level_.load();
+  header.count = size_;
+  header.entry_point = entry_point_.load();
+  for (size_t node = 0; node < size_; node++) {
+    header.upper_links += levels_[node] * (1 + m_);
+  }
+
+  std::string temporary = path + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if (!file) {
+    *error = "Cannot create " + temporary + ": " + strerror(errno);
+    return false;
+  }
+
+  static const char kPadding[8] = {};
+  auto write = [&](const void* data, size_t bytes) {
+    return (bytes == 0 || fwrite(data, 1, bytes, file) == bytes) &&
+           fwrite(kPadding, 1, padded(bytes) - bytes, file) ==
+               padded(bytes) - bytes;
+  };
+
+  bool written = write(&header, sizeof(header)) &&
+                 write(ids_.data(), size_ * sizeof(int64_t)) &&
+                 write(levels_.data(), size_);
+  size_t upper_bytes = 0;
+  for (size_t node = 0; written && node < size_; node++) {
+    size_t bytes = levels_[node] * (1 + m_) * sizeof(Links);
+    if (bytes > 0) {
+      written = fwrite(upper_links_[node].get(), 1, bytes, file) == bytes;
+      upper_bytes += bytes;
+    }
+  }
+  written = written &&
+            fwrite(kPadding, 1, padded(upper_bytes) - upper_bytes, file) ==
+                padded(upper_bytes) - upper_bytes &&
+            write(nodes_, size_ * node_bytes()) && fflush(file) == 0 &&
+            fsync(fileno(file)) == 0;
+  if (fclose(file) != 0) {
+    written = false;
+  }
+
+  if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+    *error = "Cannot write " + path + ": " + strerror(errno);
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<VectorIndex> VectorIndex::load(const std::string& path,
+                                               std::string* error) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "Cannot open " + path + ": " + strerror(errno);
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    *error = path + " is not a vector index";
+    return nullptr;
+  }
+
+  // Private and writable: pages are read from the file on first access,
+  // and an insert copies the records out before changing them
+  size_t size = static_cast<size_t>(st.st_size);
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    *error = "Cannot map " + path + ": " + strerror(errno);
+    return nullptr;
+  }
+
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  auto fail = [&](const std::string& message) {
+    munmap(base, size);
+    *error = message;
+    return nullptr;
+  };
+
+  if (memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 ||
+      header.metric > static_cast<uint32_t>(Metric::kDot) ||
+      header.m < 2 || header.m > 1024 || header.dimensions > 65536 ||
+      header.count > UINT32_MAX || header.max_level > kMaxLevel ||
+      header.entry_point >= static_cast<int64_t>(header.count) ||
+      (header.count > 0) != (header.entry_point >= 0)) {
+    return fail(path + " is not a vector index");
+  }
+
+  Options options;
+  options.metric = static_cast<Metric>(header.metric);
+  options.dimensions = header.dimensions;
+  options.m = header.m;
+  options.ef_construction = header.ef_construction;
+  options.ef_search = header.ef_search;
+  auto index = std::make_shared<VectorIndex>(options);
+
+  size_t count = header.count;
+  size_t ids_offset = sizeof(FileHeader);
+  size_t levels_offset = ids_offset + padded(count * sizeof(int64_t));
+  size_t upper_offset = levels_offset + padded(count);
+  size_t nodes_offset =
+      upper_offset + padded(header.upper_links * sizeof(Links));
+  if (header.upper_links > size ||
+      nodes_offset + count * index->node_bytes() > size) {
+    return fail(path + " is truncated");
+  }
+
+  const char* bytes = static_cast<const char*>(base);
+  index->ids_.resize(count);
+  memcpy(index->ids_.data(), bytes + ids_offset, count * sizeof(int64_t));
+  index->levels_.assign(bytes + levels_offset, bytes + levels_offset + count);
+  index->upper_links_.resize(count);
+
+  const auto* upper = reinterpret_cast<const Links*>(bytes + upper_offset);
+  size_t upper_used = 0;
+  for (size_t node = 0; node < count; node++) {
+    size_t links = index->levels_[node] * (1 + header.m);
+    if (index->levels_[node] > kMaxLevel ||
+        upper_used + links > header.upper_links) {
+      return fail(path + " is corrupt");
+    }
+    if (links > 0) {
+      index->upper_links_[node].reset(new Links[links]);
+      memcpy(index->upper_links_[node].get(), upper + upper_used,
+             links * sizeof(Links));
+      upper_used += links;
+    }
+  }
+
+  if (header.entry_point >= 0 &&
+      index->levels_[header.entry_point] != header.max_level) {
+    return fail(path + " is corrupt");
+  }
+
+  index->nodes_by_id_.reserve(count);
+  for (size_t node = 0; node < count; node++) {
+    if (!index->nodes_by_id_.emplace(index->ids_[node], node).second) {
+      return fail(path + " is corrupt");
+    }
+  }
+
+  index->mapping_ = base;
+  index->mapping_size_ = size;
+  index->nodes_ = static_cast<char*>(base) + nodes_offset;
+  index->capacity_ = count;
+  index->size_ = count;
+  index->inserted_ = count;
+  index->entry_point_ = header.entry_point;
+  index->max_level_ = header.max_level;
+  return index;
+}
+
+// =============================================================================
+// VectorIndexes
+// =============================================================================
+
+VectorIndexes& VectorIndexes::instance() {
+  static VectorIndexes indexes;
+  return indexes;
+}
+
+VectorIndexes::VectorIndexes()
+    : directory_(config_string("VECTOR_INDEX_DIR", "")) {
+  // Constructed first so that it outlives the indexes' insert tasks
+  WorkerPool::instance();
+}
+
+bool VectorIndexes::valid_name(std::string_view name) {
+  if (name.empty() || name.size() > 64) {
+    return false;
+  }
+  for (char c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' &&
+        c != '-') {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string VectorIndexes::path(std::string_view name) const {
+  std::string path = directory_;
+  path.append("/").append(name).append(".hnsw");
+  return path;
+}
+
+bool VectorIndexes::create(std::string_view name,
+                           const VectorIndex::Options& options,
+                           std::string* error) {
+  if (!valid_name(name)) {
+    *error = "Invalid vector index name: " + std::string(name);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  struct stat st;
+  if (indexes_.count(name) > 0 ||
+      (!directory_.empty() && stat(path(name).c_str(), &st) == 0)) {
+    *error = "Vector index " + std::string(name) + " already exists";
+    return false;
+  }
+  indexes_.emplace(std::string(name), std::make_shared<VectorIndex>(options));
+  return true;
+}
+
+std::shared_ptr<VectorIndex> VectorIndexes::find(std::string_view name,
+                                                 std::string* error) {
+  if (!valid_name(name)) {
+    *error = "Invalid vector index name: " + std::string(name);
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = indexes_.find(name);
+  if (found != indexes_.end()) {
+    return found->second;
+  }
+
+  struct stat st;
+  if (directory_.empty() || stat(path(name).c_str(), &st) != 0) {
+    *error = "Unknown vector index: " + std::string(name);
+    return nullptr;
+  }
+  auto index = VectorIndex::load(path(name), error);
+  if (index) {
+    indexes_.emplace(std::string(name), index);
+  }
+  return index;
+}
+
+bool VectorIndexes::save(std::string_view name, size_t* vectors,
+                         std::string* error) {
+  if (directory_.empty()) {
+    *error = "Vector indexes are kept in memory only; set "
+             "VSQL_AI_VECTOR_INDEX_DIR to save them";
+    return false;
+  }
+  auto index = find(name, error);
+  if (!index || !index->save(path(name), error)) {
+    return false;
+  }
+  *vectors = index->stats().vectors;
+  return true;
+}
+
+bool VectorIndexes::drop(std::string_view name, std::string* error) {
+  if (!valid_name(name)) {
+    *error = "Invalid vector index name: " + std::string(name);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = indexes_.find(name);
+  bool dropped = found != indexes_.end();
+  if (dropped) {
+    indexes_.erase(found);
+  }
+  if (!directory_.empty() && unlink(path(name).c_str()) == 0) {
+    dropped = true;
+  }
+  if (!dropped) {
+    *error = "Unknown vector index: " + std::string(name);
+  }
+  return dropped;
+}
+
+}  // namespace vsql_ai
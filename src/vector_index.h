@@ -0,0 +1,227 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VSQL_AI_VECTOR_INDEX_H
+#define VSQL_AI_VECTOR_INDEX_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vsql_ai {
+
+// Approximate nearest-neighbor index over float vectors: a hierarchical
+// navigable small world graph (HNSW, Malkov & Yashunin).
+//
+// Level 0, which every vector is on, lives in one contiguous block of
+// fixed-size nodes, each holding its neighbor list and then its vector, so
+// a search step reads a single cache-friendly record. The few nodes on
+// higher levels keep those links separately.
+//
+// Vectors are queued by add() and inserted by worker pool tasks, several at
+// once, so an index is built with many cores from a plain table scan;
+// search() and save() first wait for the queue to drain. Saved indexes are
+// one file in the same layout, memory-mapped copy-on-write on load, so
+// opening even a large index reads nothing up front.
+class VectorIndex : public std::enable_shared_from_this<VectorIndex> {
+ public:
+  enum class Metric { kCosine, kL2, kDot };
+
+  struct Options {
+    Metric metric = Metric::kCosine;
+    uint32_t dimensions = 0;  // 0 takes the first vector's
+    uint32_t m = 16;          // links per node above level 0; 2 * m on it
+    uint32_t ef_construction = 200;
+    uint32_t ef_search = 64;
+  };
+
+  struct Neighbor {
+    int64_t id;
+    float distance;
+  };
+
+  struct Stats {
+    Options options;
+    size_t vectors = 0;
+    size_t pending = 0;  // queued but not yet inserted
+    int max_level = -1;
+    size_t bytes = 0;
+  };
+
+  explicit VectorIndex(const Options& options);
+  ~VectorIndex();
+
+  // Open a file written by save(). Returns nullptr and sets *error if it is
+  // not a valid index.
+  static std::shared_ptr<VectorIndex> load(const std::string& path,
+                                           std::string* error);
+
+  // Queue a vector for insertion under id. Fails if the dimensions do not
+  // match or id is already in the index.
+  bool add(int64_t id, const float* values, size_t count, std::string* error);
+
+  // The k nearest vectors to the query, closest first. Distances are
+  // 1 - cosine similarity, Euclidean distance or the negated dot product.
+  bool search(const float* query, size_t count, size_t k,
+              std::vector<Neighbor>* neighbors, std::string* error);
+
+  // Write the index to path, atomically replacing any previous file
+  bool save(const std::string& path, std::string* error);
+
+  // Wait until every queued vector is inserted
+  void flush();
+
+  Stats stats();
+
+ private:
+  using Node = uint32_t;
+
+  // A neighbor list: its size followed by the node ids
+  using Links = uint32_t;
+
+  static constexpr size_t kLockStripes = 1024;
+
+  // Level 0 record layout: [count][2m links][dimensions floats]
+  size_t node_bytes() const;
+  Links* level0(Node node) const;
+  const float* vector(Node node) const;
+  Links* links(Node node, int level) const;
+  size_t max_links(int level) const { return level == 0 ? 2 * m_ : m_; }
+
+  float distance(const float* a, const float* b) const;
+
+  // Make room for at least capacity nodes. Caller holds resize_mutex_
+  // exclusively.
+  void grow(size_t capacity);
+
+  // Start a task for any queued vectors and wait until all are inserted.
+  // *lock holds queue_mutex_.
+  void wait_for_inserts(std::unique_lock<std::mutex>* lock);
+
+  // Insert queued vectors a chunk at a time until the queue is empty; runs
+  // on a worker thread
+  void insert_queued();
+  void insert(Node node, int level);
+
+  // Best candidates for query on level, at most ef, closest first
+  std::vector<std::pair<float, Node>> search_level(const float* query,
+                                                   Node entry, size_t ef,
+                                                   int level) const;
+  Node greedy_descend(const float* query, Node entry, int from_level,
+                      int to_level) const;
+
+  // Choose up to max neighbors from candidates (closest first) that are not
+  // closer to an already chosen neighbor than to the base vector, which
+  // keeps links pointing in varied directions
+  void select_neighbors(std::vector<std::pair<float, Node>>* candidates,
+                        size_t max) const;
+
+  // Link node to neighbors on level and back, pruning full lists
+  void connect(Node node, const std::vector<std::pair<float, Node>>& neighbors,
+               int level);
+
+  std::mutex& lock_for(Node node) const {
+    return link_locks_[node % kLockStripes];
+  }
+
+  Metric metric_;
+  uint32_t dimensions_;
+  uint32_t m_;
+  uint32_t ef_construction_;
+  uint32_t ef_search_;
+  double level_multiplier_;
+
+  // Taken shared by inserts and searches, exclusively to grow the storage or
+  // to set the dimensions on the first vector
+  mutable std::shared_mutex resize_mutex_;
+
+  // Level 0 records are either in owned_ or in a copy-on-write mapping of
+  // the file the index was loaded from
+  std::vector<char> owned_;
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  char* nodes_ = nullptr;
+  size_t capacity_ = 0;
+
+  std::vector<int64_t> ids_;
+  std::vector<uint8_t> levels_;
+  std::vector<std::unique_ptr<Links[]>> upper_links_;  // levels 1 and up
+
+  // Guards the entry point and top level
+  std::mutex entry_mutex_;
+  std::atomic<int64_t> entry_point_{-1};
+  std::atomic<int> max_level_{-1};
+
+  // Guards a node's neighbor lists
+  mutable std::array<std::mutex, kLockStripes> link_locks_;
+
+  // Node assignment and the insertion queue
+  std::mutex queue_mutex_;
+  std::condition_variable queue_changed_;
+  std::unordered_map<int64_t, Node> nodes_by_id_;
+  std::vector<std::pair<Node, int>> queue_;  // node and its level
+  size_t size_ = 0;                          // nodes assigned
+  size_t inserted_ = 0;
+  size_t running_tasks_ = 0;
+  size_t max_tasks_;
+};
+
+// Process-wide named vector indexes. With VSQL_AI_VECTOR_INDEX_DIR set,
+// indexes are saved there as <name>.hnsw and opened on first use after a
+// restart.
+class VectorIndexes {
+ public:
+  static VectorIndexes& instance();
+
+  // Names are 1 to 64 letters, digits, '_' or '-'
+  static bool valid_name(std::string_view name);
+
+  bool create(std::string_view name, const VectorIndex::Options& options,
+              std::string* error);
+
+  // The index called name, opened from its file if it is not in memory
+  std::shared_ptr<VectorIndex> find(std::string_view name, std::string* error);
+
+  bool save(std::string_view name, size_t* vectors, std::string* error);
+
+  // Forget the index and delete its file
+  bool drop(std::string_view name, std::string* error);
+
+ private:
+  VectorIndexes();
+
+  std::string path(std::string_view name) const;
+
+  std::string directory_;
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<VectorIndex>, std::less<>> indexes_;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_VECTOR_INDEX_H
@@ -0,0 +1,331 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vector_ops.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VSQL_AI_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define VSQL_AI_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+namespace vsql_ai {
+
+namespace {
+
+// =============================================================================
+// Scalar kernels
+// =============================================================================
+
+// Four independent accumulators let the compiler overlap the adds
+
+float dot_scalar(const float* a, const float* b, size_t n) {
+  float acc[4] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (size_t j = 0; j < 4; j++) {
+      acc[j] += a[i + j] * b[i + j];
+    }
+  }
+  float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float l2_squared_scalar(const float* a, const float* b, size_t n) {
+  float acc[4] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (size_t j = 0; j < 4; j++) {
+      float d = a[i + j] - b[i + j];
+      acc[j] += d * d;
+    }
+  }
+  float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+void dot_norms_scalar(const float* a, const float* b, size_t n, float* dot,
+                      float* norm_a, float* norm_b) {
+  float ab = 0, aa = 0, bb = 0;
+  for (size_t i = 0; i < n; i++) {
+    ab += a[i] * b[i];
+    aa += a[i] * a[i];
+    bb += b[i] * b[i];
+  }
+  *dot = ab;
+  *norm_a = aa;
+  *norm_b = bb;
+}
+
+#if defined(VSQL_AI_X86_KERNELS)
+
+// =============================================================================
+// AVX2 + FMA kernels
+// =============================================================================
+
+__attribute__((target("avx2,fma"))) float hsum_avx2(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const float* a,
+                                                   const float* b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                           _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  float sum = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2,fma"))) float l2_squared_avx2(const float* a,
+                                                          const float* b,
+                                                          size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    __m256 d1 =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(d, d, acc0);
+  }
+  float sum = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+__attribute__((target("avx2,fma"))) void dot_norms_avx2(const float* a,
+                                                        const float* b,
+                                                        size_t n, float* dot,
+                                                        float* norm_a,
+                                                        float* norm_b) {
+  __m256 ab = _mm256_setzero_ps();
+  __m256 aa = _mm256_setzero_ps();
+  __m256 bb = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 va = _mm256_loadu_ps(a + i);
+    __m256 vb = _mm256_loadu_ps(b + i);
+    ab = _mm256_fmadd_ps(va, vb, ab);
+    aa = _mm256_fmadd_ps(va, va, aa);
+    bb = _mm256_fmadd_ps(vb, vb, bb);
+  }
+  float sum_ab = hsum_avx2(ab), sum_aa = hsum_avx2(aa), sum_bb = hsum_avx2(bb);
+  for (; i < n; i++) {
+    sum_ab += a[i] * b[i];
+    sum_aa += a[i] * a[i];
+    sum_bb += b[i] * b[i];
+  }
+  *dot = sum_ab;
+  *norm_a = sum_aa;
+  *norm_b = sum_bb;
+}
+
+// =============================================================================
+// AVX-512 kernels
+// =============================================================================
+
+// Masked loads handle the tail without a scalar loop
+
+__attribute__((target("avx512f"))) float dot_avx512(const float* a,
+                                                    const float* b, size_t n) {
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16),
+                           _mm512_loadu_ps(b + i + 16), acc1);
+  }
+  for (; i < n; i += 16) {
+    __mmask16 mask = n - i >= 16 ? 0xffff
+                                 : static_cast<__mmask16>((1u << (n - i)) - 1);
+    acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                           _mm512_maskz_loadu_ps(mask, b + i), acc0);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) float l2_squared_avx512(const float* a,
+                                                           const float* b,
+                                                           size_t n) {
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    __m512 d1 =
+        _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i < n; i += 16) {
+    __mmask16 mask = n - i >= 16 ? 0xffff
+                                 : static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                             _mm512_maskz_loadu_ps(mask, b + i));
+    acc0 = _mm512_fmadd_ps(d, d, acc0);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) void dot_norms_avx512(const float* a,
+                                                         const float* b,
+                                                         size_t n, float* dot,
+                                                         float* norm_a,
+                                                         float* norm_b) {
+  __m512 ab = _mm512_setzero_ps();
+  __m512 aa = _mm512_setzero_ps();
+  __m512 bb = _mm512_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    __mmask16 mask = n - i >= 16 ? 0xffff
+                                 : static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512 va = _mm512_maskz_loadu_ps(mask, a + i);
+    __m512 vb = _mm512_maskz_loadu_ps(mask, b + i);
+    ab = _mm512_fmadd_ps(va, vb, ab);
+    aa = _mm512_fmadd_ps(va, va, aa);
+    bb = _mm512_fmadd_ps(vb, vb, bb);
+  }
+  *dot = _mm512_reduce_add_ps(ab);
+  *norm_a = _mm512_reduce_add_ps(aa);
+  *norm_b = _mm512_reduce_add_ps(bb);
+}
+
+#endif  // VSQL_AI_X86_KERNELS
+
+#if defined(VSQL_AI_NEON_KERNELS)
+
+// =============================================================================
+// NEON kernels (always available on AArch64)
+// =============================================================================
+
+float dot_neon(const float* a, const float* b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float l2_squared_neon(const float* a, const float* b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc0 = vfmaq_f32(acc0, d0, d0);
+    acc1 = vfmaq_f32(acc1, d1, d1);
+  }
+  float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+void dot_norms_neon(const float* a, const float* b, size_t n, float* dot,
+                    float* norm_a, float* norm_b) {
+  float32x4_t ab = vdupq_n_f32(0);
+  float32x4_t aa = vdupq_n_f32(0);
+  float32x4_t bb = vdupq_n_f32(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t va = vld1q_f32(a + i);
+    float32x4_t vb = vld1q_f32(b + i);
+    ab = vfmaq_f32(ab, va, vb);
+    aa = vfmaq_f32(aa, va, va);
+    bb = vfmaq_f32(bb, vb, vb);
+  }
+  float sum_ab = vaddvq_f32(ab), sum_aa = vaddvq_f32(aa),
+        sum_bb = vaddvq_f32(bb);
+  for (; i < n; i++) {
+    sum_ab += a[i] * b[i];
+    sum_aa += a[i] * a[i];
+    sum_bb += b[i] * b[i];
+  }
+  *dot = sum_ab;
+  *norm_a = sum_aa;
+  *norm_b = sum_bb;
+}
+
+#endif  // VSQL_AI_NEON_KERNELS
+
+VectorKernels select_kernels() {
+#if defined(VSQL_AI_X86_KERNELS)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return {"avx512", dot_avx512, l2_squared_avx512, dot_norms_avx512};
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {"avx2", dot_avx2, l2_squared_avx2, dot_norms_avx2};
+  }
+#endif
+#if defined(VSQL_AI_NEON_KERNELS)
+  return {"neon", dot_neon, l2_squared_neon, dot_norms_neon};
+#endif
+  return {"scalar", dot_scalar, l2_squared_scalar, dot_norms_scalar};
+}
+
+// Resolved while the library is loaded, so the per-row path is one indirect
+// call with no feature checks
+const VectorKernels kernels = select_kernels();
+
+}  // namespace
+
+const VectorKernels& vector_kernels() { return kernels; }
+
+}  // namespace vsql_ai
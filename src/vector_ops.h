@@ -0,0 +1,42 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_VECTOR_OPS_H
+#define VSQL_AI_VECTOR_OPS_H
+
+#include <cstddef>
+
+namespace vsql_ai {
+
+// Distance kernels over float32 vectors. The implementation is picked once,
+// when the extension is loaded, from the best instruction set the CPU
+// supports: AVX-512, AVX2+FMA or NEON, with a portable scalar fallback.
+struct VectorKernels {
+  const char* name;  // e.g. "avx2"
+
+  float (*dot)(const float* a, const float* b, size_t n);
+  float (*l2_squared)(const float* a, const float* b, size_t n);
+
+  // Dot product and both squared norms in one pass, for cosine similarity
+  void (*dot_norms)(const float* a, const float* b, size_t n, float* dot,
+                    float* norm_a, float* norm_b);
+};
+
+const VectorKernels& vector_kernels();
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_VECTOR_OPS_H
@@ -0,0 +1,131 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "call_context.h"
+#include "config.h"
+
+namespace vsql_ai {
+
+namespace {
+
+// Workers mostly sit blocked on network I/O, so this can comfortably exceed
+// the core count; it bounds the threads the extension adds to the server.
+constexpr long kDefaultMaxWorkerThreads = 32;
+
+}  // namespace
+
+WorkerPool& WorkerPool::instance() {
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::WorkerPool()
+    : max_threads_(static_cast<size_t>(std::max(
+          1L, config_int("MAX_WORKER_THREADS", kDefaultMaxWorkerThreads)))) {}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::parallel_for(size_t count, size_t max_concurrency,
+                              const std::function<void(size_t)>& fn) {
+  if (count == 0) {
+    return;
+  }
+
+  // Shared by the caller and its helper tasks. Each participant claims the
+  // next unstarted index until none are left.
+  struct State {
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t running_helpers = 0;
+  };
+  auto state = std::make_shared<State>();
+
+  // Helpers work for the caller's SQL call, which outlives them since this
+  // waits for every helper
+  CallContext* call = CallContext::current();
+  auto run = [state, count, &fn, call]() {
+    CallContext::Scope scope(call);
+    for (size_t i = state->next++; i < count; i = state->next++) {
+      fn(i);
+    }
+  };
+
+  size_t helpers = std::min(count, std::max<size_t>(max_concurrency, 1)) - 1;
+  state->running_helpers = helpers;
+  for (size_t h = 0; h < helpers; h++) {
+    submit([state, run]() {
+      run();
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (--state->running_helpers == 0) {
+        state->done.notify_one();
+      }
+    });
+  }
+
+  run();
+
+  // Helpers still queued behind other work finish immediately once they
+  // start, since every index has been claimed.
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state]() { return state->running_helpers == 0; });
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.push_back(std::move(task));
+  if (idle_threads_ < tasks_.size() && threads_.size() < max_threads_) {
+    threads_.emplace_back(&WorkerPool::worker_loop, this);
+  } else {
+    work_available_.notify_one();
+  }
+}
+
+void WorkerPool::worker_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    idle_threads_++;
+    work_available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+    idle_threads_--;
+
+    if (tasks_.empty()) {
+      return;  // stopping
+    }
+
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+}  // namespace vsql_ai
@@ -0,0 +1,66 @@
+/* Copyright (c) 2025 VillageSQL Contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VSQL_AI_WORKER_POOL_H
+#define VSQL_AI_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vsql_ai {
+
+// Process-wide bounded pool of worker threads used to keep several provider
+// requests in flight for a single SQL call. Threads are started lazily, up to
+// the configured maximum, and shared by all sessions.
+class WorkerPool {
+ public:
+  static WorkerPool& instance();
+
+  // Run fn(0) .. fn(count - 1) with at most max_concurrency calls running at
+  // once and return when all of them have finished. The calling thread runs
+  // tasks too, so this makes progress even when every worker is busy. Tasks
+  // run under the caller's CallContext.
+  void parallel_for(size_t count, size_t max_concurrency,
+                    const std::function<void(size_t)>& fn);
+
+  // Queue a task, starting another worker thread if all are busy and the
+  // thread limit allows it. The task may outlive the caller, so it runs
+  // outside any CallContext.
+  void submit(std::function<void()> task);
+
+ private:
+  WorkerPool();
+  ~WorkerPool();
+
+  void worker_loop();
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+  size_t idle_threads_ = 0;
+  size_t max_threads_;
+  bool stopping_ = false;
+};
+
+}  // namespace vsql_ai
+
+#endif  // VSQL_AI_WORKER_POOL_H